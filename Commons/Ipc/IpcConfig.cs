@@ -25,14 +25,24 @@ namespace Cqse.Teamscale.Profiler.Commons.Ipc
         /// </summary>
         public int StartPortNumber { get; } = 7146;
 
+        /// <summary>
+        /// The ZeroMQ socket on which test events are published with sequence numbers to all profilers that subscribe to them
+        /// instead of registering. Default is localhost TCP port 7144 (7145 - 1), as the ports above are handed out to registered profilers.
+        /// </summary>
+        public string EventSocket { get; } = "tcp://127.0.0.1:7144";
+
         public IpcConfig()
         {
             // defaults
         }
 
-        public IpcConfig(string publishSocket, string requestSocket)
+        public IpcConfig(string publishSocket, string requestSocket, string? eventSocket = null)
         {
             PublishSocket = publishSocket;
+            if (eventSocket != null)
+            {
+                EventSocket = eventSocket;
+            }
             RequestSocket = requestSocket.Substring(0, requestSocket.LastIndexOf(':')) ;
             StartPortNumber = Int32.Parse(requestSocket.Split(':').Last());
         }
@@ -1,5 +1,6 @@
 ﻿using NLog;
 using System;
+using System.Collections.Concurrent;
 using System.Text.RegularExpressions;
 
 namespace Cqse.Teamscale.Profiler.Commons.Ipc
@@ -15,8 +16,18 @@ namespace Cqse.Teamscale.Profiler.Commons.Ipc
         /// </summary>
         public string TestName { get; private set; } = String.Empty;
 
+        /// <summary>
+        /// The names of the tests currently running in test contexts, by test context.
+        /// </summary>
+        private readonly ConcurrentDictionary<uint, string> contextTestNames = new ConcurrentDictionary<uint, string>();
+
         public IpcConfig Config { get; }
 
+        /// <summary>
+        /// Raised on the IPC thread when a profiler sent the coverage of an ended test, which requires COR_PROFILER_TIA_STREAM_COVERAGE.
+        /// </summary>
+        public event Action<TestCoverage>? TestCoverageReceived;
+
         public ProfilerIpc(IpcConfig config)
         {
             Config = config;
@@ -26,7 +37,13 @@ namespace Cqse.Teamscale.Profiler.Commons.Ipc
         protected virtual ZmqIpcServer CreateIpcServer(IpcConfig config)
         {
             logger.Info("Starting IPC server (PUB={pub}, REQ={req})", config.PublishSocket, config.RequestSocket);
-            return new ZmqIpcServer(config, this.HandleRequest);
+            return new ZmqIpcServer(config, this.HandleRequest, this.HandleTestCoverage);
+        }
+
+        protected virtual void HandleTestCoverage(TestCoverage testCoverage)
+        {
+            logger.Info("Received coverage of test {testName}", testCoverage.TestName);
+            TestCoverageReceived?.Invoke(testCoverage);
         }
 
         protected virtual string HandleRequest(string message)
@@ -46,12 +63,21 @@ namespace Cqse.Teamscale.Profiler.Commons.Ipc
             }
         }
 
-        public void StartTest(string testName)
+        /// <summary>
+        /// Starts the given test. If a test context other than 0 is given, the test only records the coverage of the threads
+        /// bound to that context with <see cref="ProfilerTestContext"/> and may run concurrently with tests in other contexts.
+        /// </summary>
+        public void StartTest(string testName, uint contextId = 0)
         {
             if (string.IsNullOrEmpty(testName))
             {
                 throw new ArgumentException("Test name must not be empty or null");
             }
+            if (contextId != 0)
+            {
+                StartContextTest(testName, contextId);
+                return;
+            }
             if (this.TestName != string.Empty)
             {
                 logger.Info("Starting a new test while a test {testName} is still active. Ending active Test with result Skipped since actual result is unknown.", this.TestName);
@@ -60,11 +86,29 @@ namespace Cqse.Teamscale.Profiler.Commons.Ipc
             String cleanedTestName = testName.Replace("\n", " ").Replace("\r", " ");
             logger.Info("Broadcasting start of test {testName}", cleanedTestName);
             this.TestName = cleanedTestName;
-            ipcServer.SendTestEvent($"start:{cleanedTestName}");
+            ipcServer.SendTestEvent(TestEvent.Start(cleanedTestName));
         }
 
-        public void EndTest(TestExecutionResult result, long durationMs = 0)
+        private void StartContextTest(string testName, uint contextId)
         {
+            if (contextTestNames.ContainsKey(contextId))
+            {
+                logger.Info("Starting a new test in test context {contextId} while a test is still active there. Ending active Test with result Skipped since actual result is unknown.", contextId);
+                this.EndTest(TestExecutionResult.Skipped, 0, contextId);
+            }
+            String cleanedTestName = testName.Replace("\n", " ").Replace("\r", " ");
+            logger.Info("Broadcasting start of test {testName} in test context {contextId}", cleanedTestName, contextId);
+            contextTestNames[contextId] = cleanedTestName;
+            ipcServer.SendTestEvent(TestEvent.Start(cleanedTestName, contextId));
+        }
+
+        public void EndTest(TestExecutionResult result, long durationMs = 0, uint contextId = 0)
+        {
+            if (contextId != 0)
+            {
+                EndContextTest(result, durationMs, contextId);
+                return;
+            }
             if (TestName == string.Empty)
             {
                 logger.Info("Testname is empty. Result {result} cannot be associated with a testname and is not broadcasted with duration {duration}.", TestName, result, durationMs);
@@ -72,7 +116,18 @@ namespace Cqse.Teamscale.Profiler.Commons.Ipc
             }
             logger.Info("Broadcasting end of test {testName} with result {result}", TestName, result);
             this.TestName = string.Empty;
-            ipcServer.SendTestEvent($"end:{Enum.GetName(typeof(TestExecutionResult), result).ToUpper()}:{durationMs}");
+            ipcServer.SendTestEvent(TestEvent.End(result, durationMs));
+        }
+
+        private void EndContextTest(TestExecutionResult result, long durationMs, uint contextId)
+        {
+            if (!contextTestNames.TryRemove(contextId, out string testName))
+            {
+                logger.Info("No test is running in test context {contextId}. Result {result} is not broadcasted.", contextId, result);
+                return;
+            }
+            logger.Info("Broadcasting end of test {testName} in test context {contextId} with result {result}", testName, contextId, result);
+            ipcServer.SendTestEvent(TestEvent.End(result, durationMs, contextId));
         }
 
         public void Dispose()
@@ -0,0 +1,70 @@
+﻿using System;
+using System.IO;
+using System.Runtime.InteropServices;
+using System.Threading;
+
+namespace Cqse.Teamscale.Profiler.Commons.Ipc
+{
+    /// <summary>
+    /// Binds the current thread and async flow to a test context of the profiler, so the enter hook records the coverage
+    /// of that flow for the test started in that context, see <see cref="ProfilerIpc.StartTest(string, uint)"/>.
+    /// Must be used within the profiled process. Does nothing if that process is not profiled.
+    /// </summary>
+    public static class ProfilerTestContext
+    {
+        private static readonly string[] PROFILER_PATH_VARIABLES =
+        {
+            "COR_PROFILER_PATH", "COR_PROFILER_PATH_64", "COR_PROFILER_PATH_32",
+            "CORECLR_PROFILER_PATH", "CORECLR_PROFILER_PATH_64", "CORECLR_PROFILER_PATH_32",
+        };
+
+        [UnmanagedFunctionPointer(CallingConvention.StdCall)]
+        private delegate void SetTestContextFunction(uint contextId);
+
+        private static readonly Lazy<SetTestContextFunction?> setTestContext = new Lazy<SetTestContextFunction?>(LoadSetTestContext);
+
+        // The profiler's binding is per thread, so it must follow the async flow whenever it changes threads
+        private static readonly AsyncLocal<uint> currentContext = new AsyncLocal<uint>(args => setTestContext.Value?.Invoke(args.CurrentValue));
+
+        /// <summary>
+        /// The test context of the current async flow, 0 for the process-wide test.
+        /// </summary>
+        public static uint Current
+        {
+            get => currentContext.Value;
+            set => currentContext.Value = value;
+        }
+
+        private static SetTestContextFunction? LoadSetTestContext()
+        {
+            foreach (string variable in PROFILER_PATH_VARIABLES)
+            {
+                string? profilerPath = Environment.GetEnvironmentVariable(variable);
+                if (string.IsNullOrEmpty(profilerPath))
+                {
+                    continue;
+                }
+
+                IntPtr profilerModule = GetModuleHandle(Path.GetFileName(profilerPath));
+                if (profilerModule == IntPtr.Zero)
+                {
+                    // The other bitness
+                    continue;
+                }
+
+                IntPtr function = GetProcAddress(profilerModule, "SetTestContext");
+                if (function != IntPtr.Zero)
+                {
+                    return Marshal.GetDelegateForFunctionPointer<SetTestContextFunction>(function);
+                }
+            }
+            return null;
+        }
+
+        [DllImport("kernel32.dll", CharSet = CharSet.Unicode)]
+        private static extern IntPtr GetModuleHandle(string moduleName);
+
+        [DllImport("kernel32.dll", CharSet = CharSet.Ansi, ExactSpelling = true)]
+        private static extern IntPtr GetProcAddress(IntPtr module, string procedureName);
+    }
+}
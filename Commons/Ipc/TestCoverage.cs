@@ -0,0 +1,96 @@
+﻿using System.Collections.Generic;
+using System.IO;
+using System.Text;
+
+namespace Cqse.Teamscale.Profiler.Commons.Ipc
+{
+    /// <summary>
+    /// The methods that a profiled process called during a test, sent by the profiler right after the test ended
+    /// if COR_PROFILER_TIA_STREAM_COVERAGE is enabled. Must match TestCoverage.h of the profiler.
+    /// </summary>
+    public class TestCoverage
+    {
+        private const byte FORMAT_VERSION = 1;
+
+        public string TestName { get; }
+
+        /// <summary>
+        /// Maps the names of the assemblies to the metadata tokens of their called methods.
+        /// </summary>
+        public IReadOnlyDictionary<string, List<uint>> MethodTokensByAssembly { get; }
+
+        private TestCoverage(string testName, IReadOnlyDictionary<string, List<uint>> methodTokensByAssembly)
+        {
+            TestName = testName;
+            MethodTokensByAssembly = methodTokensByAssembly;
+        }
+
+        /// <summary>
+        /// Decodes the given binary frame. Throws an <see cref="InvalidDataException"/> if it is malformed.
+        /// </summary>
+        public static TestCoverage Decode(byte[] frame)
+        {
+            using BinaryReader reader = new BinaryReader(new MemoryStream(frame));
+            try
+            {
+                byte version = reader.ReadByte();
+                if (version != FORMAT_VERSION)
+                {
+                    throw new InvalidDataException($"Unsupported test coverage format version {version}");
+                }
+
+                string testName = ReadString(reader);
+                Dictionary<string, List<uint>> methodTokensByAssembly = new Dictionary<string, List<uint>>();
+                uint assemblyCount = reader.ReadUInt32();
+                for (uint i = 0; i < assemblyCount; i++)
+                {
+                    string assemblyName = ReadString(reader);
+                    if (!methodTokensByAssembly.TryGetValue(assemblyName, out List<uint>? tokens))
+                    {
+                        tokens = new List<uint>();
+                        methodTokensByAssembly.Add(assemblyName, tokens);
+                    }
+
+                    uint methodCount = reader.ReadUInt32();
+                    uint token = 0;
+                    for (uint j = 0; j < methodCount; j++)
+                    {
+                        // tokens are stored as the difference to the previous one
+                        token += ReadVarint(reader);
+                        tokens.Add(token);
+                    }
+                }
+                return new TestCoverage(testName, methodTokensByAssembly);
+            }
+            catch (EndOfStreamException e)
+            {
+                throw new InvalidDataException("Truncated test coverage", e);
+            }
+        }
+
+        private static string ReadString(BinaryReader reader)
+        {
+            uint length = reader.ReadUInt32();
+            if (length > reader.BaseStream.Length - reader.BaseStream.Position)
+            {
+                throw new EndOfStreamException();
+            }
+            return Encoding.UTF8.GetString(reader.ReadBytes((int)length));
+        }
+
+        private static uint ReadVarint(BinaryReader reader)
+        {
+            uint value = 0;
+            for (int shift = 0; shift < 35; shift += 7)
+            {
+                byte next = reader.ReadByte();
+                value |= (uint)(next & 0x7F) << shift;
+                if ((next & 0x80) == 0)
+                {
+                    return value;
+                }
+            }
+            throw new InvalidDataException("Method token is too long");
+        }
+    }
+}
@@ -0,0 +1,115 @@
+﻿using System;
+using System.IO;
+using System.Text;
+
+namespace Cqse.Teamscale.Profiler.Commons.Ipc
+{
+    /// <summary>
+    /// A test event that is published to the subscribed profilers as a binary frame. Must match TestEvent.h of the profiler.
+    /// </summary>
+    public class TestEvent
+    {
+        private const byte FORMAT_VERSION = 1;
+
+        public enum EventType : byte
+        {
+            /// <summary>
+            /// Not an actual event, only carries the sequence number, e.g. in the reply to a resync request if nothing happened yet.
+            /// </summary>
+            None = 0,
+            Start = 1,
+            End = 2
+        }
+
+        public EventType Type { get; }
+
+        /// <summary>
+        /// Increases by one with every published event, so profilers can detect lost events. Assigned when the event is published.
+        /// </summary>
+        public long SequenceNumber { get; internal set; }
+
+        /// <summary>
+        /// When the event was created, in milliseconds since the Unix epoch.
+        /// </summary>
+        public long Timestamp { get; }
+
+        /// <summary>
+        /// The name of the started test. Empty for other events.
+        /// </summary>
+        public string TestName { get; }
+
+        /// <summary>
+        /// The result of the ended test, e.g. PASSED. Empty for other events.
+        /// </summary>
+        public string Result { get; }
+
+        public long DurationMs { get; }
+
+        /// <summary>
+        /// The test context the test runs in or 0 for the process-wide test. See <see cref="ProfilerTestContext"/>.
+        /// </summary>
+        public uint ContextId { get; }
+
+        private TestEvent(EventType type, string testName, string result, long durationMs, uint contextId)
+        {
+            Type = type;
+            Timestamp = DateTimeOffset.UtcNow.ToUnixTimeMilliseconds();
+            TestName = testName;
+            Result = result;
+            DurationMs = durationMs;
+            ContextId = contextId;
+        }
+
+        public static TestEvent None() => new TestEvent(EventType.None, string.Empty, string.Empty, 0, 0);
+
+        public static TestEvent Start(string testName, uint contextId = 0) =>
+            new TestEvent(EventType.Start, testName, string.Empty, 0, contextId);
+
+        public static TestEvent End(TestExecutionResult result, long durationMs, uint contextId = 0) =>
+            new TestEvent(EventType.End, string.Empty, Enum.GetName(typeof(TestExecutionResult), result).ToUpper(), durationMs, contextId);
+
+        /// <summary>
+        /// Encodes this event as a binary frame: version, type, sequence number, timestamp, duration, test context and
+        /// the length-prefixed UTF-8 test name and result, with all numbers little-endian.
+        /// </summary>
+        public byte[] Encode()
+        {
+            using MemoryStream stream = new MemoryStream();
+            // BinaryWriter always writes little-endian
+            using (BinaryWriter writer = new BinaryWriter(stream))
+            {
+                writer.Write(FORMAT_VERSION);
+                writer.Write((byte)Type);
+                writer.Write(SequenceNumber);
+                writer.Write(Timestamp);
+                writer.Write(DurationMs);
+                writer.Write(ContextId);
+                WriteString(writer, TestName);
+                WriteString(writer, Result);
+            }
+            return stream.ToArray();
+        }
+
+        private static void WriteString(BinaryWriter writer, string value)
+        {
+            byte[] bytes = Encoding.UTF8.GetBytes(value);
+            writer.Write((uint)bytes.Length);
+            writer.Write(bytes);
+        }
+
+        /// <summary>
+        /// The message sent to profilers that registered their own socket, e.g. "start:MyTest" or "end:PASSED:42",
+        /// or "start@3:MyTest" for a test in a test context.
+        /// </summary>
+        public string ToLegacyMessage()
+        {
+            string context = ContextId == 0 ? string.Empty : $"@{ContextId}";
+            return Type switch
+            {
+                EventType.Start => $"start{context}:{TestName}",
+                EventType.End => $"end{context}:{Result}:{DurationMs}",
+                _ => string.Empty,
+            };
+        }
+    }
+}
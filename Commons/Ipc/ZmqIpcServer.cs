@@ -3,6 +3,7 @@ using NetMQ.Sockets;
 using NLog;
 using System;
 using System.Collections.Generic;
+using System.IO;
 using System.Text;
 
 namespace Cqse.Teamscale.Profiler.Commons.Ipc
@@ -13,8 +14,29 @@ namespace Cqse.Teamscale.Profiler.Commons.Ipc
     public class ZmqIpcServer : IDisposable
     {
         private const string REGISTER_CLIENT = "register";
+
+        /// <summary>
+        /// Request of subscribed profilers that missed events, answered with the frame of the last test event.
+        /// </summary>
+        private const string RESYNC = "resync";
+
+        /// <summary>
+        /// Request of profilers that send the coverage of an ended test, followed by a binary frame with the coverage.
+        /// </summary>
+        private const string TEST_COVERAGE = "coverage";
+
         private NetMQPoller? poller;
         private ResponseSocket? responseSocket;
+        private PublisherSocket? publisherSocket;
+
+        /// <summary>
+        /// Guards the publisher socket, the sequence number and the last test event, which must be consistent for resync requests.
+        /// </summary>
+        private readonly object testEventLock = new object();
+
+        private long sequenceNumber = 0;
+
+        private TestEvent lastTestEvent = TestEvent.None();
 
         private Dictionary<int, ProfilerClient> pidToClient = new Dictionary<int, ProfilerClient>();
 
@@ -22,17 +44,42 @@ namespace Cqse.Teamscale.Profiler.Commons.Ipc
 
         public delegate string RequestHandler(string message);
 
+        public delegate void TestCoverageHandler(TestCoverage testCoverage);
+
         private readonly IpcConfig config;
         private readonly RequestHandler requestHandler;
+        private readonly TestCoverageHandler? testCoverageHandler;
 
         private int portOffset = 0;
 
-        public ZmqIpcServer(IpcConfig config, RequestHandler requestHandler)
+        public ZmqIpcServer(IpcConfig config, RequestHandler requestHandler, TestCoverageHandler? testCoverageHandler = null)
         {
             this.config = config;
             this.requestHandler = requestHandler;
+            this.testCoverageHandler = testCoverageHandler;
 
             StartRequestHandler();
+            StartPublisher();
+        }
+
+        /// <summary>
+        /// Starts publishing test events to the subscribed profilers
+        /// </summary>
+        protected void StartPublisher()
+        {
+            var socket = new PublisherSocket();
+            try
+            {
+                socket.Bind(this.config.EventSocket);
+            }
+            catch (NetMQException e)
+            {
+                // Registered profilers still receive all test events, so this is not fatal
+                logger.Warn(e, $"Could not publish test events on {this.config.EventSocket}");
+                socket.Dispose();
+                return;
+            }
+            this.publisherSocket = socket;
         }
 
         /// <summary>
@@ -44,12 +91,25 @@ namespace Cqse.Teamscale.Profiler.Commons.Ipc
             this.responseSocket.Bind(this.config.PublishSocket);
             this.responseSocket.ReceiveReady += (s, e) =>
             {
-                string message = responseSocket.ReceiveFrameString();
+                string message = responseSocket.ReceiveFrameString(out bool hasMore);
+                if (message == TEST_COVERAGE && hasMore)
+                {
+                    HandleTestCoverage(responseSocket.ReceiveFrameBytes());
+                    return;
+                }
                 if (message.StartsWith(REGISTER_CLIENT))
                 {
                     RegisterClient(message);
                     return;
                 }
+                if (message == RESYNC)
+                {
+                    lock (testEventLock)
+                    {
+                        responseSocket.SendFrame(lastTestEvent.Encode());
+                    }
+                    return;
+                }
                 string response = this.requestHandler(message);
                 responseSocket.SendFrame(response);
             };
@@ -58,6 +118,24 @@ namespace Cqse.Teamscale.Profiler.Commons.Ipc
             poller.RunAsync("Profiler IPC", true);
         }
 
+        private void HandleTestCoverage(byte[] frame)
+        {
+            TestCoverage testCoverage;
+            try
+            {
+                testCoverage = TestCoverage.Decode(frame);
+            }
+            catch (InvalidDataException e)
+            {
+                logger.Error(e, "Received invalid test coverage");
+                responseSocket.SendFrame(string.Empty);
+                return;
+            }
+            // acknowledged first, so the profiler can go on with the next test events while we handle the coverage
+            responseSocket.SendFrame("ack");
+            testCoverageHandler?.Invoke(testCoverage);
+        }
+
         private void RegisterClient(string message)
         {
             int pid = Int32.Parse(message.Split(':')[1]);
@@ -83,13 +161,23 @@ namespace Cqse.Teamscale.Profiler.Commons.Ipc
 
         /// <summary>
         /// Sends the given test event to all connected profiler instances.
+        /// Subscribed profilers receive it at once without replying, registered ones one after the other.
         /// </summary>
-        public void SendTestEvent(string testEvent)
+        public void SendTestEvent(TestEvent testEvent)
         {
+            lock (testEventLock)
+            {
+                sequenceNumber++;
+                testEvent.SequenceNumber = sequenceNumber;
+                lastTestEvent = testEvent;
+                publisherSocket?.SendFrame(testEvent.Encode());
+            }
+
+            string legacyMessage = testEvent.ToLegacyMessage();
             HashSet<int> clientsToRemove = new HashSet<int>();
             System.Threading.Tasks.Parallel.ForEach(pidToClient, entry =>
             {
-                entry.Value.Socket.SendFrame(Encoding.UTF8.GetBytes(testEvent));
+                entry.Value.Socket.SendFrame(Encoding.UTF8.GetBytes(legacyMessage));
                 if (entry.Value.Socket.TryReceiveFrameString(TimeSpan.FromSeconds(3.0), out string? response))
                 {
                     logger.Info($"Got Response from {entry.Value.ClientAddress}: {response}");
@@ -119,6 +207,10 @@ namespace Cqse.Teamscale.Profiler.Commons.Ipc
         {
             this.poller?.Dispose();
             this.responseSocket?.Dispose();
+            lock (testEventLock)
+            {
+                this.publisherSocket?.Dispose();
+            }
             foreach (var client in pidToClient)
             {
                 client.Value.Socket.Dispose();
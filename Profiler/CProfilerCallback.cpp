@@ -4,13 +4,17 @@
 #include "utils/StringUtils.h"
 #include "utils/WindowsUtils.h"
 #include "utils/Debug.h"
+#include "utils/TestCoverage.h"
+#include "instrumentation/BasicBlockInstrumenter.h"
 #include <fstream>
 #include <algorithm>
 #include <winuser.h>
 #include <iostream>
+#include <chrono>
+#include <codecvt>
+#include <thread>
 #include <utils/MethodEnter.h>
 
-#pragma comment(lib, "version.lib")
 #pragma intrinsic(strcmp,labs,strcpy,_rotl,memcmp,strlen,_rotr,memcpy,_lrotl,_strset,memset,_lrotr,abs,strcat)
 
 namespace Profiler {
@@ -21,11 +25,7 @@ namespace Profiler {
 	 */
 	class ShutdownGuard {
 	public:
-		ShutdownGuard() {
-			// we never delete this critical section. This is not needed as it's cleaned up on process
-			// death like any other memory
-			InitializeCriticalSection(&section);
-		}
+		ShutdownGuard() = default;
 
 		~ShutdownGuard() = default;
 
@@ -39,7 +39,7 @@ namespace Profiler {
 		 * should be set only when calling from a CLR callback.
 		 */
 		void shutdownInstance(bool clrIsAvailable) {
-			EnterCriticalSection(&section);
+			section->enter();
 			if (instance != nullptr) {
 				try {
 					instance->ShutdownOnce(clrIsAvailable);
@@ -49,11 +49,13 @@ namespace Profiler {
 				}
 				instance = nullptr;
 			}
-			LeaveCriticalSection(&section);
+			section->leave();
 		}
 
 	private:
-		CRITICAL_SECTION section;
+		// we never delete this lock. This is not needed as it's cleaned up on process
+		// death like any other memory
+		Lock* section = new Lock();
 		CProfilerCallback* instance = nullptr;
 	};
 
@@ -69,8 +71,6 @@ namespace Profiler {
 
 	CProfilerCallback::CProfilerCallback() {
 		try {
-			InitializeCriticalSection(&methodSetSynchronization);
-			InitializeCriticalSection(&callbackSynchronization);
 			getShutdownGuard().setInstance(this);
 		}
 		catch (...) {
@@ -83,8 +83,6 @@ namespace Profiler {
 			// make sure we flush to disk and disable access to this instance for other threads
 			// even if the .NET framework doesn't call Shutdown() itself
 			getShutdownGuard().shutdownInstance(false);
-			DeleteCriticalSection(&callbackSynchronization);
-			DeleteCriticalSection(&methodSetSynchronization);
 		}
 		catch (...) {
 			handleException("Destructor");
@@ -102,11 +100,78 @@ namespace Profiler {
 	}
 
 	HRESULT CProfilerCallback::InitializeImplementation(IUnknown* pICorProfilerInfoUnkown) {
+		// Only what the CLR needs before the first managed instruction runs here, the rest is done by initializeInBackground
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
 		initializeConfig();
 		if (!config.isProfilingEnabled()) {
+			// A disabled profiler still costs every callback the CLR makes into it, so it leaves the process entirely.
+			// There is no log to report a failure to, in which case it simply stays attached and idle.
+			HRESULT hr = pICorProfilerInfoUnkown->QueryInterface(IID_ICorProfilerInfo3, reinterpret_cast<LPVOID*>(&profilerInfo));
+			if (SUCCEEDED(hr) && profilerInfo.p != nullptr) {
+				backgroundWorker.post([this]() { requestDetach(); });
+			}
 			return S_OK;
 		}
+		if (!config.getProblems().empty()) {
+			initializeLogs();
+			// Does not return
+			reportConfigProblems();
+		}
+		bool isRecordingCallbacks = !config.getCallbackRecordingPath().empty() && callbackRecorder.open(config.getCallbackRecordingPath());
+		initializeRecordingMode();
+		std::chrono::steady_clock::time_point configLoaded = std::chrono::steady_clock::now();
+
+		HRESULT hr = pICorProfilerInfoUnkown->QueryInterface(IID_ICorProfilerInfo3, reinterpret_cast<LPVOID*>(&profilerInfo));
+		if (FAILED(hr) || profilerInfo.p == nullptr) {
+			return E_INVALIDARG;
+		}
+
+		adjustEventMask();
+		if (config.isTiaEnabled()) {
+			setLock(&methodSetSynchronization);
+			setCalledMethodsSet(&calledMethodIds);
+			if (config.shouldCountCalls()) {
+				setCalledMethodsCounter(&calledMethodCounter);
+			}
+			if (config.getCallSamplingInterval() > 1) {
+				setSamplingInterval(config.getCallSamplingInterval());
+			}
 
+			if (isRecordingCallbacks) {
+				setCallbackRecorder(&callbackRecorder);
+				profilerInfo->SetEnterLeaveFunctionHooks3((FunctionEnter3*)&FnEnterRecordingCallback, nullptr, nullptr);
+			}
+			else {
+				profilerInfo->SetEnterLeaveFunctionHooks3((FunctionEnter3*)&FnEnterCallback, nullptr, nullptr);
+			}
+			if (mode.hasFunctionFilters || mode.hasTrivialMethodPolicy) {
+				profilerInfo->SetFunctionIDMapper2(&functionMapper, this);
+			}
+		}
+
+		if (config.getDetachAfterIdleMinutes() > 0 && canDetach()) {
+			idleTimer = std::make_unique<IdleTimer>(std::chrono::minutes(config.getDetachAfterIdleMinutes()), [this]() { detachWhenIdle(); });
+		}
+
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+		long long configMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>(configLoaded - begin).count();
+		long long inlineMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count();
+		backgroundWorker.post([this, configMicroseconds, inlineMicroseconds]() {
+			initializeInBackground(configMicroseconds, inlineMicroseconds);
+		});
+		return S_OK;
+	}
+
+	void CProfilerCallback::initializeRecordingMode() {
+		mode.recordsJittedMethods = config.isTgaEnabled();
+		mode.instrumentsBlocks = config.isBlockCoverageEnabled();
+		mode.skipsCoreLibrary = config.isTiaEnabled();
+		mode.hasFunctionFilters = hasFunctionFilters();
+		mode.hasTrivialMethodPolicy = hasTrivialMethodPolicy();
+		mode.eagerness = config.getEagerness();
+	}
+
+	void CProfilerCallback::initializeLogs() {
 		// Place the attach log next to the config
 		std::string configPath = StringUtils::removeLastPartOfPath(config.getConfigPath());
 		attachLog.createLogFile(configPath);
@@ -114,19 +179,25 @@ namespace Profiler {
 
 		traceLog.createLogFile(config.getTargetDir());
 		traceLog.info("looking for configuration options in: " + config.getConfigPath());
-		// must happen before the problems are logged as those terminate the process
 		for (const std::string& warning : config.getWarnings()) {
 			traceLog.warn(warning);
 		}
+	}
+
+	void CProfilerCallback::reportConfigProblems() {
 		for (const std::string& problem : config.getProblems()) {
 			traceLog.error(problem);
 			std::cerr << problem;
 		}
-		if (!config.getProblems().empty()) {
-			WindowsUtils::reportError("Error when loading configuration file", "Couldn't load Profiler.yml configuration for the Teamscale .NET Profiler! See related errors in the standard error stream or in the log file.");
-			// If configuration was incorrect, make it visible to the user by closing the application
-			exit(-1);
-		}
+		WindowsUtils::reportError("Error when loading configuration file", "Couldn't load Profiler.yml configuration for the Teamscale .NET Profiler! See related errors in the standard error stream or in the log file.");
+		// If configuration was incorrect, make it visible to the user by closing the application
+		exit(-1);
+	}
+
+	void CProfilerCallback::initializeInBackground(long long configMicroseconds, long long inlineMicroseconds) {
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		initializeLogs();
+		std::chrono::steady_clock::time_point logsCreated = std::chrono::steady_clock::now();
 
 		if (config.shouldUseLightMode()) {
 			traceLog.info("Mode: light");
@@ -137,27 +208,54 @@ namespace Profiler {
 
 		traceLog.info("Eagerness: " + std::to_string(config.getEagerness()));
 
+		if (config.isBlockCoverageEnabled()) {
+			traceLog.info("Block coverage enabled");
+		}
+
+		if (!config.getCallbackRecordingPath().empty()) {
+			traceLog.info("Recording profiler callbacks to " + config.getCallbackRecordingPath());
+		}
+
+		if (idleTimer != nullptr) {
+			traceLog.info("Detaching after " + std::to_string(config.getDetachAfterIdleMinutes()) + " minutes without new methods");
+		}
+		else if (config.getDetachAfterIdleMinutes() > 0) {
+			traceLog.warn("Detaching after idle minutes is only supported for TGA in light mode without block coverage. Staying attached instead");
+		}
+
 		if (config.shouldStartUploadDaemon()) {
 			traceLog.info("Starting upload daemon");
 			createDaemon().launch(traceLog);
 		}
+		std::chrono::steady_clock::time_point daemonLaunched = std::chrono::steady_clock::now();
 
 		if (config.isTiaEnabled()) {
 			traceLog.info("TIA enabled. REQ Socket: " + config.getTiaRequestSocket());
-			std::function<void(std::string)> testStartCallback = [this](std::string testName) {
-				this->onTestStart(testName);
+			if (!config.getTiaSubscribeSocket().empty()) {
+				traceLog.info("Subscribing to test events published on " + config.getTiaSubscribeSocket());
+			}
+			std::function<void(std::string, unsigned int)> testStartCallback = [this](std::string testName, unsigned int contextId) {
+				this->onTestStart(testName, contextId);
 				};
-			std::function<void(std::string, std::string)> testEndCallback = [this](std::string result, std::string duration) {
-				this->onTestEnd(result, duration);
+			std::function<std::string(std::string, std::string, unsigned int)> testEndCallback = [this](std::string result, std::string duration, unsigned int contextId) {
+				return this->onTestEnd(result, duration, contextId);
 				};
 			std::function<void(std::string)> errorCallback = [this](std::string message) {
 				this->traceLog.error(message);
 				};
 			this->ipc = std::make_unique<Ipc>(&this->config, testStartCallback, testEndCallback, errorCallback);
 
-			setCriticalSection(&methodSetSynchronization);
-			setCalledMethodsSet(&calledMethodIds);
+			if (config.shouldCountCalls()) {
+				traceLog.info("Counting calls");
+			}
+			if (config.getCallSamplingInterval() > 1) {
+				traceLog.info("Sampling one in " + std::to_string(config.getCallSamplingInterval()) + " calls");
+			}
+			if (config.shouldStreamTestCoverage()) {
+				traceLog.info("Sending test coverage to the test runner");
+			}
 		}
+		std::chrono::steady_clock::time_point ipcCreated = std::chrono::steady_clock::now();
 
 		std::array<char, BUFFER_SIZE> appPool;
 		if (GetEnvironmentVariable("APP_POOL_ID", appPool.data(), static_cast<DWORD>(appPool.size()))) {
@@ -171,19 +269,15 @@ namespace Profiler {
 		if (config.shouldDumpEnvironment()) {
 			dumpEnvironment();
 		}
-
-		HRESULT hr = pICorProfilerInfoUnkown->QueryInterface(IID_ICorProfilerInfo3, reinterpret_cast<LPVOID*>(&profilerInfo));
-		if (FAILED(hr) || profilerInfo.p == nullptr) {
-			return E_INVALIDARG;
-		}
-
-		adjustEventMask();
-		if (config.isTiaEnabled()) {
-			profilerInfo->SetEnterLeaveFunctionHooks3((FunctionEnter3*)&FnEnterCallback, nullptr, nullptr);
-		}
 		traceLog.logProcess(WindowsUtils::getPathOfThisProcess());
-
-		return S_OK;
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+		traceLog.info("Startup [us]: config " + std::to_string(configMicroseconds)
+			+ ", inline total " + std::to_string(inlineMicroseconds)
+			+ ", background logs " + std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(logsCreated - begin).count())
+			+ ", daemon " + std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(daemonLaunched - logsCreated).count())
+			+ ", ipc " + std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(ipcCreated - daemonLaunched).count())
+			+ ", background total " + std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count()));
 	}
 
 	void CProfilerCallback::dumpEnvironment() {
@@ -216,16 +310,25 @@ namespace Profiler {
 	}
 
 	void CProfilerCallback::ShutdownOnce(bool clrIsAvailable) {
+		// Must not detach anymore once shutting down
+		idleTimer.reset();
+		// Finishes the initialization and writes the assemblies that are still waiting for their file versions.
+		// Disabled profilers request their detach on it, so it must be stopped before the CLR unloads the profiler
+		backgroundWorker.stop();
 		if (!config.isProfilingEnabled()) {
 			return;
 		}
-		EnterCriticalSection(&callbackSynchronization);
-		EnterCriticalSection(&methodSetSynchronization);
+
+		writerSynchronization.enter();
 		writeFunctionInfosToLog();
-		LeaveCriticalSection(&methodSetSynchronization);
-		LeaveCriticalSection(&callbackSynchronization);
+		for (unsigned int contextId = 1; contextId <= MAX_TEST_CONTEXT_ID; contextId++) {
+			endTestInContext(contextId, "SKIPPED", "0");
+		}
+		writerSynchronization.leave();
 		attachLog.logDetach();
+		callbackRecorder.close();
 
+		std::string traceFilePath = traceLog.getFilePath();
 		traceLog.shutdown();
 		attachLog.shutdown();
 		if (ipc != nullptr) {
@@ -233,7 +336,7 @@ namespace Profiler {
 		}
 
 		if (config.shouldStartUploadDaemon()) {
-			createDaemon().notifyShutdown();
+			createDaemon().notifyShutdown(traceFilePath);
 		}
 		if (clrIsAvailable) {
 			profilerInfo->ForceGC();
@@ -250,6 +353,51 @@ namespace Profiler {
 		return S_OK;
 	}
 
+	HRESULT CProfilerCallback::ProfilerDetachSucceeded() {
+		try {
+			// The CLR is not available anymore at this point, so no GC must be forced
+			getShutdownGuard().shutdownInstance(false);
+		}
+		catch (...) {
+			handleException("ProfilerDetachSucceeded");
+		}
+		return S_OK;
+	}
+
+	bool CProfilerCallback::canDetach() {
+		return config.shouldUseLightMode() && !config.isTiaEnabled() && !config.isBlockCoverageEnabled();
+	}
+
+	HRESULT CProfilerCallback::requestDetach() {
+		// The CLR only completes the detach once no more callbacks are running, so they are stopped first
+		HRESULT hr = profilerInfo->SetEventMask(COR_PRF_MONITOR_NONE);
+		if (FAILED(hr)) {
+			return hr;
+		}
+		for (int attempt = 0; attempt < 10; attempt++) {
+			hr = profilerInfo->RequestProfilerDetach(5000);
+			if (hr != CORPROF_E_UNSUPPORTED_CALL_SEQUENCE) {
+				break;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		}
+		return hr;
+	}
+
+	void CProfilerCallback::detachWhenIdle() {
+		traceLog.info("No new methods for " + std::to_string(config.getDetachAfterIdleMinutes()) + " minutes. Detaching");
+		// Methods recorded until the callbacks are stopped are written by ProfilerDetachSucceeded
+		writerSynchronization.enter();
+		writeFunctionInfosToLog();
+		writerSynchronization.leave();
+
+		HRESULT hr = requestDetach();
+		if (FAILED(hr)) {
+			traceLog.error("Failed to detach with HRESULT " + std::to_string(hr) + ". Staying attached instead");
+			adjustEventMask();
+		}
+	}
+
 	void CProfilerCallback::adjustEventMask() {
 		DWORD dwEventMaskLow;
 		DWORD dwEventMaskHigh;
@@ -269,11 +417,18 @@ namespace Profiler {
 			dwEventMaskLow |= COR_PRF_DISABLE_INLINING;
 		}
 
+		if (config.isBlockCoverageEnabled()) {
+			// Probes are inserted when a method is jitted, so we must force pre-jitted code to be jitted as well
+			dwEventMaskLow |= COR_PRF_MONITOR_JIT_COMPILATION;
+			dwEventMaskLow |= COR_PRF_DISABLE_ALL_NGEN_IMAGES;
+		}
+
 		profilerInfo->SetEventMask2(dwEventMaskLow, dwEventMaskHigh);
 	}
 
 	HRESULT CProfilerCallback::AssemblyLoadFinished(AssemblyID assemblyId, HRESULT) {
 		try {
+			callbackRecorder.record(RecordedCallback::Type::ASSEMBLY_LOAD_FINISHED, assemblyId);
 			return AssemblyLoadFinishedImplementation(assemblyId);
 		}
 		catch (...) {
@@ -286,16 +441,16 @@ namespace Profiler {
 		if (!config.isProfilingEnabled()) {
 			return S_OK;
 		}
-		EnterCriticalSection(&callbackSynchronization);
-
-		int assemblyNumber = registerAssembly(assemblyId);
+		// Numbers are assigned in load order, so the core library always gets number 1
+		int assemblyNumber = assemblies.registerAssembly(assemblyId);
 
 		std::array<WCHAR, BUFFER_SIZE> assemblyName;
 		std::array<WCHAR, BUFFER_SIZE> assemblyPath;
 		ASSEMBLYMETADATA metadata;
-		getAssemblyInfo(assemblyId, assemblyName.data(), assemblyPath.data(), &metadata);
+		ModuleID moduleId = 0;
+		getAssemblyInfo(assemblyId, assemblyName.data(), assemblyPath.data(), &metadata, moduleId);
 
-		LeaveCriticalSection(&callbackSynchronization);
+		assemblies.registerModule(assemblyNumber, moduleId, assemblyName.data(), config.getAssemblyPatterns().matches(assemblyName.data()));
 
 		std::wostringstream out;
 
@@ -307,7 +462,13 @@ namespace Profiler {
 			<< metadata.usRevisionNumber;
 
 		if (config.shouldLogAssemblyFileVersion()) {
-			writeFileVersionInfo(assemblyName.data(), out);
+			// Reading the version resources takes a while, so the line is completed in the background
+			std::wstring assemblyLine = out.str();
+			std::wstring path = assemblyPath.data();
+			backgroundWorker.post([this, assemblyLine, path]() {
+				logAssemblyWithFileVersion(assemblyLine, path);
+			});
+			return S_OK;
 		}
 
 		if (config.shouldLogAssemblyPaths()) {
@@ -319,16 +480,9 @@ namespace Profiler {
 		return S_OK;
 	}
 
-	int CProfilerCallback::registerAssembly(AssemblyID assemblyId) {
-		int assemblyNumber = assemblyCounter++;
-		assemblyMap[assemblyId] = assemblyNumber;
-		return assemblyNumber;
-	}
-
-	void CProfilerCallback::getAssemblyInfo(AssemblyID assemblyId, WCHAR* assemblyName, WCHAR* assemblyPath, ASSEMBLYMETADATA* metadata) {
+	void CProfilerCallback::getAssemblyInfo(AssemblyID assemblyId, WCHAR* assemblyName, WCHAR* assemblyPath, ASSEMBLYMETADATA* metadata, ModuleID& moduleId) {
 		ULONG assemblyNameSize = 0;
 		AppDomainID appDomainId = 0;
-		ModuleID moduleId = 0;
 		profilerInfo->GetAssemblyInfo(assemblyId, BUFFER_SIZE,
 			&assemblyNameSize, assemblyName, &appDomainId, &moduleId);
 
@@ -368,8 +522,19 @@ namespace Profiler {
 			nullptr, 0, nullptr, metadata, nullptr);
 	}
 
+	HRESULT CProfilerCallback::JITCompilationStarted(FunctionID functionId, BOOL) {
+		try {
+			return JITCompilationStartedImplementation(functionId);
+		}
+		catch (...) {
+			handleException("JITCompilationStarted");
+			return S_OK;
+		}
+	}
+
 	HRESULT CProfilerCallback::JITCompilationFinished(FunctionID functionId, HRESULT, BOOL) {
 		try {
+			callbackRecorder.record(RecordedCallback::Type::JIT_COMPILATION_FINISHED, functionId);
 			return JITCompilationFinishedImplementation(functionId);
 		}
 		catch (...) {
@@ -385,22 +550,72 @@ namespace Profiler {
 		}
 	}
 
+	HRESULT CProfilerCallback::JITCompilationStartedImplementation(FunctionID functionId) {
+		if (mode.instrumentsBlocks && isInterestingFunction(functionId)) {
+			instrumentBasicBlocks(functionId);
+		}
+		return S_OK;
+	}
+
+	void CProfilerCallback::instrumentBasicBlocks(FunctionID functionId) {
+		FunctionInfo info = {};
+		ModuleID moduleId = 0;
+		HRESULT hr = getFunctionInfo(functionId, info, moduleId);
+
+		// We never instrument the core library (assembly 1) as the runtime itself depends on its exact IL.
+		// Generic methods are jitted once per instantiation but share a single IL body that we only replace once.
+		if (FAILED(hr) || info.assemblyNumber <= 1 || blockCoverage.isRegistered(info.assemblyNumber, info.functionToken)) {
+			return;
+		}
+
+		LPCBYTE methodBody = nullptr;
+		ULONG methodBodySize = 0;
+		hr = profilerInfo->GetILFunctionBody(moduleId, info.functionToken, &methodBody, &methodBodySize);
+		if (FAILED(hr) || methodBody == nullptr) {
+			return;
+		}
+
+		BasicBlockInstrumenter instrumenter;
+		if (!instrumenter.parse(methodBody, methodBodySize)) {
+			return;
+		}
+
+		BYTE* hitFlags = blockCoverage.registerMethod(info.assemblyNumber, info.functionToken, instrumenter.getBlockOffsets());
+		if (hitFlags == nullptr) {
+			// Another thread instrumented the same method concurrently
+			return;
+		}
+		std::vector<BYTE> instrumentedBody = instrumenter.instrument(hitFlags);
+
+		CComPtr<IMethodMalloc> methodMalloc;
+		hr = profilerInfo->GetILFunctionBodyAllocator(moduleId, &methodMalloc);
+		if (FAILED(hr) || methodMalloc == nullptr) {
+			return;
+		}
+		void* newMethodBody = methodMalloc->Alloc(static_cast<ULONG>(instrumentedBody.size()));
+		if (newMethodBody == nullptr) {
+			return;
+		}
+		memcpy(newMethodBody, instrumentedBody.data(), instrumentedBody.size());
+		profilerInfo->SetILFunctionBody(moduleId, info.functionToken, static_cast<LPCBYTE>(newMethodBody));
+	}
+
 	HRESULT CProfilerCallback::JITCompilationFinishedImplementation(FunctionID functionId) {
-		if (config.isProfilingEnabled() && config.isTgaEnabled()) {
-			EnterCriticalSection(&callbackSynchronization);
-			EnterCriticalSection(&methodSetSynchronization);
+		if (mode.recordsJittedMethods && isInterestingFunction(functionId)) {
 			recordFunctionInfo(jittedMethods, functionId);
+			if (idleTimer != nullptr) {
+				idleTimer->reportActivity();
+			}
 			if (shouldWriteEagerly()) {
-				writeFunctionInfosToLog();
+				tryWriteFunctionInfosToLog();
 			}
-			LeaveCriticalSection(&methodSetSynchronization);
-			LeaveCriticalSection(&callbackSynchronization);
 		}
 		return S_OK;
 	}
 
 	HRESULT CProfilerCallback::JITInlining(FunctionID, FunctionID calleeId, BOOL* pfShouldInline) {
 		try {
+			callbackRecorder.record(RecordedCallback::Type::JIT_INLINING, calleeId);
 			return JITInliningImplementation(calleeId, pfShouldInline);
 		}
 		catch (...) {
@@ -410,19 +625,18 @@ namespace Profiler {
 	}
 
 	HRESULT CProfilerCallback::JITInliningImplementation(FunctionID calleeId, BOOL* pfShouldInline) {
-		if (config.isProfilingEnabled() && config.isTgaEnabled()) {
-			// Save information about inlined method (if not already seen)
-
-			if (!inlinedMethodIds.contains(calleeId)) {
-				EnterCriticalSection(&callbackSynchronization);
-				EnterCriticalSection(&methodSetSynchronization);
-				inlinedMethodIds.insert(calleeId);
+		if (mode.recordsJittedMethods) {
+			// Save information about inlined method (if not already seen).
+			// The lookup is lock-free and insert() succeeds for exactly one thread, so only that thread
+			// records the method. Uninteresting methods are inserted as well so that we filter them only once.
+			if (!inlinedMethodIds.contains(calleeId) && inlinedMethodIds.insert(calleeId) && isInterestingFunction(calleeId)) {
 				recordFunctionInfo(inlinedMethods, calleeId);
+				if (idleTimer != nullptr) {
+					idleTimer->reportActivity();
+				}
 				if (shouldWriteEagerly()) {
-					writeFunctionInfosToLog();
+					tryWriteFunctionInfosToLog();
 				}
-				LeaveCriticalSection(&methodSetSynchronization);
-				LeaveCriticalSection(&callbackSynchronization);
 			}
 		}
 
@@ -432,135 +646,408 @@ namespace Profiler {
 		return S_OK;
 	}
 
-	void CProfilerCallback::recordFunctionInfo(std::vector<FunctionInfo>& recordedFunctionInfos, FunctionID calleeId) {
-		// Must be called from synchronized context
+	UINT_PTR CProfilerCallback::functionMapper(FunctionID functionId, void* clientData, BOOL* pbHookFunction) {
+		CProfilerCallback* instance = static_cast<CProfilerCallback*>(clientData);
+		*pbHookFunction = TRUE;
+		try {
+			*pbHookFunction = instance->shouldHookFunction(functionId);
+		}
+		catch (...) {
+			instance->handleException("functionMapper");
+		}
+		return functionId;
+	}
+
+	bool CProfilerCallback::hasFunctionFilters() {
+		return !config.getAssemblyPatterns().isEmpty() || !config.getNamespacePatterns().isEmpty();
+	}
+
+	bool CProfilerCallback::shouldHookFunction(FunctionID functionId) {
+		return isInterestingFunction(functionId) && !isTrivialFunction(functionId);
+	}
+
+	bool CProfilerCallback::hasTrivialMethodPolicy() {
+		return config.getMinimumIlSize() > 0 || !config.getExcludedAttributes().empty();
+	}
+
+	bool CProfilerCallback::isTrivialFunction(FunctionID functionId) {
+		if (!mode.hasTrivialMethodPolicy) {
+			return false;
+		}
+
+		ClassID classId = 0;
+		ModuleID moduleId = 0;
+		mdToken functionToken = 0;
+		if (FAILED(profilerInfo->GetFunctionInfo(functionId, &classId, &moduleId, &functionToken))) {
+			return false;
+		}
+
+		bool isTrivial = false;
+		if (config.getMinimumIlSize() > 0) {
+			LPCBYTE methodBody = nullptr;
+			ULONG methodBodySize = 0;
+			HRESULT hr = profilerInfo->GetILFunctionBody(moduleId, functionToken, &methodBody, &methodBodySize);
+			// Methods without IL, e.g. extern methods, are not trivial per se
+			if (SUCCEEDED(hr) && methodBody != nullptr) {
+				ULONG codeSize = BasicBlockInstrumenter::getCodeSize(methodBody, methodBodySize);
+				isTrivial = codeSize > 0 && codeSize < config.getMinimumIlSize();
+			}
+		}
+		if (!isTrivial && !config.getExcludedAttributes().empty()) {
+			isTrivial = hasExcludedAttribute(moduleId, functionToken);
+		}
+
+		if (isTrivial && config.shouldLogExcludedMethods()) {
+			recordFunctionInfo(excludedMethods, functionId);
+		}
+		return isTrivial;
+	}
+
+	bool CProfilerCallback::hasExcludedAttribute(ModuleID moduleId, mdToken functionToken) {
+		CComPtr<IMetaDataImport> metaDataImport;
+		HRESULT hr = profilerInfo->GetModuleMetaData(moduleId, ofRead, IID_IMetaDataImport, reinterpret_cast<IUnknown**>(&metaDataImport));
+		if (FAILED(hr) || metaDataImport == nullptr) {
+			return false;
+		}
+
+		// Compiler-generated closures and state machines carry the attribute on their type, not on their methods
+		std::vector<mdToken> annotatableTokens = { functionToken };
+		mdTypeDef typeDef = mdTypeDefNil;
+		if (SUCCEEDED(metaDataImport->GetMethodProps(functionToken, &typeDef, nullptr, 0, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr))) {
+			annotatableTokens.push_back(typeDef);
+			mdTypeDef enclosingTypeDef = mdTypeDefNil;
+			while (metaDataImport->GetNestedClassProps(typeDef, &enclosingTypeDef) == S_OK) {
+				typeDef = enclosingTypeDef;
+				annotatableTokens.push_back(typeDef);
+			}
+		}
+
+		const void* attributeData = nullptr;
+		ULONG attributeDataSize = 0;
+		for (mdToken token : annotatableTokens) {
+			for (const std::wstring& attribute : config.getExcludedAttributes()) {
+				if (metaDataImport->GetCustomAttributeByName(token, attribute.c_str(), &attributeData, &attributeDataSize) == S_OK) {
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	bool CProfilerCallback::isInterestingFunction(FunctionID functionId) {
+		if (!mode.hasFunctionFilters) {
+			return true;
+		}
+
+		ClassID classId = 0;
+		ModuleID moduleId = 0;
+		mdToken functionToken = 0;
+		if (FAILED(profilerInfo->GetFunctionInfo(functionId, &classId, &moduleId, &functionToken))) {
+			// Better record too much than losing coverage
+			return true;
+		}
+
+		if (!assemblies.isInterestingModule(moduleId)) {
+			return false;
+		}
+
+		if (config.getNamespacePatterns().isEmpty()) {
+			return true;
+		}
+		return config.getNamespacePatterns().matches(getNamespace(moduleId, functionToken));
+	}
+
+	std::wstring CProfilerCallback::getNamespace(ModuleID moduleId, mdToken functionToken) {
+		CComPtr<IMetaDataImport> metaDataImport;
+		HRESULT hr = profilerInfo->GetModuleMetaData(moduleId, ofRead, IID_IMetaDataImport, reinterpret_cast<IUnknown**>(&metaDataImport));
+		if (FAILED(hr) || metaDataImport == nullptr) {
+			return L"";
+		}
+
+		mdTypeDef typeDef = mdTypeDefNil;
+		hr = metaDataImport->GetMethodProps(functionToken, &typeDef, nullptr, 0, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr);
+		if (FAILED(hr)) {
+			return L"";
+		}
 
+		// Nested types have no namespace of their own
+		mdTypeDef enclosingTypeDef = mdTypeDefNil;
+		while (metaDataImport->GetNestedClassProps(typeDef, &enclosingTypeDef) == S_OK) {
+			typeDef = enclosingTypeDef;
+		}
+
+		std::array<WCHAR, BUFFER_SIZE> typeName;
+		ULONG typeNameLength = 0;
+		hr = metaDataImport->GetTypeDefProps(typeDef, typeName.data(), BUFFER_SIZE, &typeNameLength, nullptr, nullptr);
+		if (FAILED(hr)) {
+			return L"";
+		}
+
+		std::wstring fullName(typeName.data());
+		size_t lastDot = fullName.find_last_of(L'.');
+		if (lastDot == std::wstring::npos) {
+			return L"";
+		}
+		return fullName.substr(0, lastDot);
+	}
+
+	LONG CProfilerCallback::recordFunctionInfo(ShardedBuffer<FunctionInfo>& buffer, FunctionID calleeId) {
 		FunctionInfo info;
 		getFunctionInfo(calleeId, info);
 
-		if (config.isTiaEnabled() && info.assemblyNumber == 1) {
-			return;
+		if (mode.skipsCoreLibrary && info.assemblyNumber == 1) {
+			return buffer.size();
 		}
 
-		recordedFunctionInfos.push_back(info);
+		return buffer.push(info);
 	}
 
 	inline bool CProfilerCallback::shouldWriteEagerly() {
-		// Must be called from synchronized context
-		size_t overallCount = inlinedMethods.size() + jittedMethods.size();
-		overallCount += calledMethods.size();
-		return config.getEagerness() > 0 && static_cast<int>(overallCount) >= config.getEagerness();
+		LONG overallCount = inlinedMethods.size() + jittedMethods.size();
+		return mode.eagerness > 0 && static_cast<size_t>(overallCount) >= mode.eagerness;
+	}
+
+	void CProfilerCallback::tryWriteFunctionInfosToLog() {
+		if (writerSynchronization.tryEnter()) {
+			writeFunctionInfosToLog();
+			writerSynchronization.leave();
+		}
 	}
 
 	void CProfilerCallback::writeFunctionInfosToLog() {
-		// Must be called from synchronized context
+		// Must be called by the owner of writerSynchronization
 		if (config.isTgaEnabled()) {
-			traceLog.writeInlinedFunctionInfosToLog(inlinedMethods);
-			inlinedMethods.clear();
+			std::vector<FunctionInfo> recordedMethods;
+			inlinedMethods.drainTo(recordedMethods);
+			traceLog.writeInlinedFunctionInfosToLog(recordedMethods);
 
-			traceLog.writeJittedFunctionInfosToLog(jittedMethods);
-			jittedMethods.clear();
+			recordedMethods.clear();
+			jittedMethods.drainTo(recordedMethods);
+			traceLog.writeJittedFunctionInfosToLog(recordedMethods);
 		}
 
-		if (config.isTiaEnabled()) {
-			for (unsigned int i = 0; i < calledMethodIds.size(); i++) {
-				FunctionID value = calledMethodIds.at(i);
-				if (value != 0) {
-					recordFunctionInfo(calledMethods, value);
+		if (config.isTiaEnabled() && config.shouldCountCalls()) {
+			std::vector<FunctionCallCount> calledMethodCounts;
+			collectCalledMethodCounts(calledMethodCounter, calledMethodCounts);
+			traceLog.writeCalledFunctionCountsToLog(calledMethodCounts);
+			if (isStreamingTestCoverage()) {
+				for (const FunctionCallCount& callCount : calledMethodCounts) {
+					currentTestCoverage.push_back(callCount.function);
 				}
 			}
-
-			calledMethodIds.clear();
+		}
+		else if (config.isTiaEnabled()) {
+			std::vector<FunctionInfo> calledMethods;
+			collectCalledMethods(calledMethodIds, calledMethods);
 			traceLog.writeCalledFunctionInfosToLog(calledMethods);
-			calledMethods.clear();
+			if (isStreamingTestCoverage()) {
+				currentTestCoverage.insert(currentTestCoverage.end(), calledMethods.begin(), calledMethods.end());
+			}
+		}
+
+		std::vector<FunctionInfo> recordedExcludedMethods;
+		excludedMethods.drainTo(recordedExcludedMethods);
+		if (!recordedExcludedMethods.empty()) {
+			traceLog.writeExcludedFunctionInfosToLog(recordedExcludedMethods);
+		}
+
+		if (config.isBlockCoverageEnabled()) {
+			std::vector<BlockInfo> coveredBlocks;
+			blockCoverage.collectCoveredBlocks(coveredBlocks);
+			traceLog.writeBlockInfosToLog(coveredBlocks);
+		}
+	}
+
+	void CProfilerCallback::collectCalledMethods(FunctionIdSet& calledIds, std::vector<FunctionInfo>& calledMethods) {
+		// The enter hook is only blocked while the called functions are copied, they are resolved afterwards
+		std::vector<FunctionID> calledFunctionIds;
+		drainCalledMethods(calledIds, calledFunctionIds);
+
+		for (FunctionID functionId : calledFunctionIds) {
+			FunctionInfo info;
+			getFunctionInfo(functionId, info);
+			if (info.assemblyNumber != 1) {
+				calledMethods.push_back(info);
+			}
+		}
+	}
+
+	void CProfilerCallback::collectCalledMethodCounts(FunctionIdCounter& counter, std::vector<FunctionCallCount>& calledMethodCounts) {
+		// The enter hook is only blocked while the called functions are copied, they are resolved afterwards
+		std::vector<std::pair<FunctionID, ULONG>> calledMethodIdCounts;
+		methodSetSynchronization.enter();
+		for (unsigned int i = 0; i < counter.size(); i++) {
+			FunctionID value = counter.at(i);
+			if (value != 0) {
+				calledMethodIdCounts.emplace_back(value, counter.countAt(i));
+			}
+		}
+		counter.clear();
+		methodSetSynchronization.leave();
+
+		for (const std::pair<FunctionID, ULONG>& idCount : calledMethodIdCounts) {
+			FunctionInfo info;
+			getFunctionInfo(idCount.first, info);
+			if (info.assemblyNumber != 1) {
+				calledMethodCounts.push_back({ info, idCount.second });
+			}
 		}
 	}
 
+	bool CProfilerCallback::isStreamingTestCoverage() {
+		return config.shouldStreamTestCoverage() && !currentTestName.empty();
+	}
+
 	HRESULT CProfilerCallback::getFunctionInfo(const FunctionID functionId, FunctionInfo& info) {
 		ModuleID moduleId = 0;
+		return getFunctionInfo(functionId, info, moduleId);
+	}
+
+	HRESULT CProfilerCallback::getFunctionInfo(const FunctionID functionId, FunctionInfo& info, ModuleID& moduleId) {
 		HRESULT hr = profilerInfo->GetFunctionInfo2(functionId, 0,
 			nullptr, &moduleId, &info.functionToken, 0, nullptr, nullptr);
 
 		if (SUCCEEDED(hr) && moduleId != 0) {
-			AssemblyID assemblyId;
-			hr = profilerInfo->GetModuleInfo(moduleId, nullptr, 0L,
-				nullptr, nullptr, &assemblyId);
-			if (SUCCEEDED(hr)) {
-				info.assemblyNumber = assemblyMap[assemblyId];
+			// Almost all functions are declared in a manifest module, for which we know the assembly without asking the CLR
+			info.assemblyNumber = assemblies.getAssemblyNumberOfModule(moduleId);
+			if (info.assemblyNumber == 0) {
+				AssemblyID assemblyId;
+				hr = profilerInfo->GetModuleInfo(moduleId, nullptr, 0L,
+					nullptr, nullptr, &assemblyId);
+				if (SUCCEEDED(hr)) {
+					info.assemblyNumber = assemblies.getAssemblyNumber(assemblyId);
+				}
 			}
 		}
 
 		return hr;
 	}
 
-	void CProfilerCallback::writeFileVersionInfo(const LPCWSTR assemblyPath, std::wostringstream& out) {
-		DWORD infoSize = GetFileVersionInfoSizeW(assemblyPath, nullptr);
-		if (!infoSize) {
-			return;
-		}
-
-		std::unique_ptr<BYTE[]> versionInfo{ new BYTE[infoSize] };
-		if (!GetFileVersionInfoW(assemblyPath, 0L, infoSize, versionInfo.get())) {
-			return;
+	void CProfilerCallback::logAssemblyWithFileVersion(const std::wstring& assemblyLine, const std::wstring& assemblyPath) {
+		if (fileVersionCache == nullptr) {
+			fileVersionCache = std::make_unique<FileVersionCache>(FileVersionCache::getDefaultCacheFile());
 		}
 
-		VS_FIXEDFILEINFO* fileInfo = nullptr;
-		UINT fileInfoLength = 0;
-		if (!VerQueryValueW(versionInfo.get(), L"\\", (void**)&fileInfo, &fileInfoLength)) {
-			return;
-		}
-		if (fileInfo == nullptr) {
-			return;
+		std::wostringstream out;
+		out << assemblyLine << fileVersionCache->getVersionInfo(assemblyPath);
+		if (config.shouldLogAssemblyPaths()) {
+			out << " Path:" << assemblyPath;
 		}
-
-		std::array<int, 4> version;
-		version[0] = HIWORD(fileInfo->dwFileVersionMS);
-		version[1] = LOWORD(fileInfo->dwFileVersionMS);
-		version[2] = HIWORD(fileInfo->dwFileVersionLS);
-		version[3] = LOWORD(fileInfo->dwFileVersionLS);
-
-		out << " FileVersion:"
-			<< version[0] << "."
-			<< version[1] << "."
-			<< version[2] << "."
-			<< version[3];
-
-		version[0] = HIWORD(fileInfo->dwProductVersionMS);
-		version[1] = LOWORD(fileInfo->dwProductVersionMS);
-		version[2] = HIWORD(fileInfo->dwProductVersionLS);
-		version[3] = LOWORD(fileInfo->dwProductVersionLS);
-
-		out << " ProductVersion:"
-			<< version[0] << "."
-			<< version[1] << "."
-			<< version[2] << "."
-			<< version[3];
+		traceLog.logAssembly(out.str());
 	}
 
-	void CProfilerCallback::onTestStart(const std::string& testName)
+	void CProfilerCallback::onTestStart(const std::string& testName, unsigned int contextId)
 	{
+		callbackRecorder.record(RecordedCallback::Type::TEST_START, contextId, testName);
 		if (config.isProfilingEnabled() && config.isTiaEnabled()) {
-			EnterCriticalSection(&methodSetSynchronization);
+			writerSynchronization.enter();
+			if (contextId != 0) {
+				startTestInContext(contextId, testName);
+				writerSynchronization.leave();
+				return;
+			}
 			writeFunctionInfosToLog();
+			currentTestName = testName;
+			currentTestCoverage.clear();
 
 			traceLog.startTestCase(testName);
 			if (!testName.empty()) {
 				setTestCaseRecording(true);
 			}
-			LeaveCriticalSection(&methodSetSynchronization);
+			writerSynchronization.leave();
 		}
 	}
 
-	void CProfilerCallback::onTestEnd(const std::string& result, const std::string& duration)
+	std::string CProfilerCallback::onTestEnd(const std::string& result, const std::string& duration, unsigned int contextId)
 	{
+		callbackRecorder.record(RecordedCallback::Type::TEST_END, contextId, result + ":" + duration);
+		std::string coverage;
 		if (config.isProfilingEnabled() && config.isTiaEnabled()) {
-			EnterCriticalSection(&methodSetSynchronization);
+			writerSynchronization.enter();
+			if (contextId != 0) {
+				coverage = endTestInContext(contextId, result, duration);
+				writerSynchronization.leave();
+				return coverage;
+			}
 			setTestCaseRecording(false);
 			writeFunctionInfosToLog();
 			traceLog.endTestCase(result, duration);
 
-			LeaveCriticalSection(&methodSetSynchronization);
+			if (isStreamingTestCoverage()) {
+				coverage = encodeTestCoverage(currentTestName, std::move(currentTestCoverage));
+			}
+			currentTestName.clear();
+			currentTestCoverage.clear();
+			writerSynchronization.leave();
+		}
+		return coverage;
+	}
+
+	void CProfilerCallback::startTestInContext(unsigned int contextId, const std::string& testName)
+	{
+		if (contextId > MAX_TEST_CONTEXT_ID) {
+			traceLog.error("Ignoring test " + testName + " in test context " + std::to_string(contextId)
+				+ ", the highest supported test context is " + std::to_string(MAX_TEST_CONTEXT_ID));
+			return;
+		}
+
+		std::unique_ptr<TestContext>& context = testContexts[contextId];
+		if (context == nullptr) {
+			context = std::make_unique<TestContext>();
+			if (config.shouldCountCalls()) {
+				context->calledMethodCounter = std::make_unique<FunctionIdCounter>();
+			}
+			else {
+				context->calledMethodIds = std::make_unique<FunctionIdSet>();
+			}
+		}
+		else if (context->isRunning) {
+			// The end of the previous testcase was lost
+			endTestInContext(contextId, "SKIPPED", "0");
+		}
+
+		context->testName = testName;
+		context->startTime = traceLog.getTestCaseTime();
+		context->isRunning = true;
+		setTestContextRecording(contextId, context->calledMethodIds.get(), context->calledMethodCounter.get());
+	}
+
+	std::string CProfilerCallback::endTestInContext(unsigned int contextId, const std::string& result, const std::string& duration)
+	{
+		if (contextId > MAX_TEST_CONTEXT_ID || testContexts[contextId] == nullptr || !testContexts[contextId]->isRunning) {
+			return "";
 		}
+		TestContext& context = *testContexts[contextId];
+		setTestContextRecording(contextId, nullptr, nullptr);
+		context.isRunning = false;
+
+		std::vector<FunctionInfo> calledMethods;
+		std::vector<FunctionCallCount> calledMethodCounts;
+		if (context.calledMethodCounter != nullptr) {
+			collectCalledMethodCounts(*context.calledMethodCounter, calledMethodCounts);
+		}
+		else {
+			collectCalledMethods(*context.calledMethodIds, calledMethods);
+		}
+		traceLog.writeContextTestCase(context.startTime, context.testName, calledMethods, calledMethodCounts, result, duration);
+
+		if (!config.shouldStreamTestCoverage()) {
+			return "";
+		}
+		for (const FunctionCallCount& callCount : calledMethodCounts) {
+			calledMethods.push_back(callCount.function);
+		}
+		return encodeTestCoverage(context.testName, std::move(calledMethods));
+	}
+
+	std::string CProfilerCallback::encodeTestCoverage(const std::string& testName, std::vector<FunctionInfo> coverage)
+	{
+		// Assemblies are never removed from the registry, so all recorded assembly numbers can still be resolved
+		std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
+		return TestCoverage::encode(testName, std::move(coverage), [this, &converter](int assemblyNumber) {
+			const AssemblyRegistry::Assembly* assembly = assemblies.getAssembly(assemblyNumber);
+			return assembly == nullptr ? std::string() : converter.to_bytes(assembly->name);
+			});
 	}
 
 }
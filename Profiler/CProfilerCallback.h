@@ -8,10 +8,18 @@
 #include <atlbase.h>
 #include <string>
 #include <vector>
-#include <map>
 #include <utils/FunctionIdSet/FunctionIdSet.h>
+#include <utils/FunctionIdSet/FunctionIdCounter.h>
+#include <utils/FunctionIdSet/ConcurrentFunctionIdSet.h>
+#include "utils/ShardedBuffer.h"
+#include "utils/AssemblyRegistry.h"
+#include "utils/BackgroundWorker.h"
+#include "utils/FileVersionCache.h"
 #include "UploadDaemon.h"
 #include "utils/Ipc.h"
+#include "utils/IdleTimer.h"
+#include "utils/MethodEnter.h"
+#include "instrumentation/BlockCoverage.h"
 /**
  * Coverage profiler class. Implements JIT event hooks to record method
  * coverage.
@@ -36,6 +44,9 @@ namespace Profiler {
 		/** Write coverage information to log file at shutdown. */
 		STDMETHOD(Shutdown)();
 
+		/** Instrument the basic blocks of the method if block coverage is enabled. */
+		STDMETHOD(JITCompilationStarted)(FunctionID functionID, BOOL fIsSafeToBlock);
+
 		/** Store information about jitted method. */
 		STDMETHOD(JITCompilationFinished)(FunctionID functionID, HRESULT hrStatus, BOOL fIsSafeToBlock);
 
@@ -45,6 +56,9 @@ namespace Profiler {
 		/** Record inlining of method, but generally allow it. */
 		STDMETHOD(JITInlining)(FunctionID callerID, FunctionID calleeID, BOOL* pfShouldInline);
 
+		/** Write coverage information to log file once the CLR detached the profiler, see requestDetach. */
+		STDMETHOD(ProfilerDetachSucceeded)();
+
 		/**
 		 * Implements the actual shutdown procedure. Must only be called once.
 		 * If clrIsAvailable is true, also tries to force a GC.
@@ -54,44 +68,92 @@ namespace Profiler {
 		void CProfilerCallback::ShutdownOnce(bool clrIsAvailable);
 
 	private:
-		/** Synchronizes profiling callbacks. */
-		CRITICAL_SECTION callbackSynchronization;
+		/** Synchronizes the enter hook with collecting the called methods. */
+		Lock methodSetSynchronization;
 
-		CRITICAL_SECTION methodSetSynchronization;
+		/**
+		 * Owned by the single thread that currently collects the recorded functions and writes them to the log.
+		 * Recording a function never waits for it.
+		 */
+		Lock writerSynchronization;
 
 		/** Default size for arrays. */
 		static const int BUFFER_SIZE = 2048;
 
-		/** Counts the number of assemblies loaded. */
-		int assemblyCounter = 1;
-
 		bool isTestCaseRecording = false;
 		CProfilerCallback* callbackInstance = nullptr;
 
 		Config config = Config(WindowsUtils::getConfigValueFromEnvironment);
 
 		/**
-		 * Maps from assembly IDs to assemblyNumbers (determined by assemblyCounter).
-		 * It is used to identify the declaring assembly for functions.
+		 * What the JIT and inlining callbacks record, resolved once from the config at initialization, so that they
+		 * test a single flag instead of combining several config options on every call. Nothing is recorded before.
 		 */
-		std::map<AssemblyID, int> assemblyMap;
+		struct RecordingMode {
+			/** Whether jitted and inlined methods are recorded for the overall coverage (TGA). */
+			bool recordsJittedMethods = false;
+
+			/** Whether methods are instrumented for block coverage when they are jitted. */
+			bool instrumentsBlocks = false;
+
+			/** Whether methods of the core library are not recorded, as in TIA mode. */
+			bool skipsCoreLibrary = false;
+
+			/** Whether methods must match the assembly or namespace patterns to be recorded. */
+			bool hasFunctionFilters = false;
+
+			/** Whether trivial methods are excluded from hooking. */
+			bool hasTrivialMethodPolicy = false;
+
+			/** After how many recorded methods they are written to the trace file. 0 if they are only written at the end. */
+			size_t eagerness = 0;
+		};
+
+		RecordingMode mode;
+
+		/** Resolves the recording mode from the loaded config. */
+		void initializeRecordingMode();
+
+		/**
+		 * Numbers the loaded assemblies and is used to identify the declaring assembly for functions.
+		 * Also remembers which assemblies do not match the configured assembly patterns, so that
+		 * functions can be rejected by their module alone.
+		 */
+		AssemblyRegistry assemblies;
 
 		/**
 		 * Info object that keeps track of jitted methods.
 		 */
-		std::vector<FunctionInfo> jittedMethods;
+		ShardedBuffer<FunctionInfo> jittedMethods;
 
 		/**
 		 * Keeps track of inlined methods.
 		 * We use the set to efficiently determine if we already noticed an inlined method.
+		 * JITInlining is called concurrently from all JIT threads, so this set needs no external synchronization.
 		 */
-		FunctionIdSet inlinedMethodIds;
+		ConcurrentFunctionIdSet inlinedMethodIds;
 
 		/**
 		 * Keeps track of inlined methods.
-		 * We use the vector to uniquely store the information about inlined methods.
+		 * We use the buffer to uniquely store the information about inlined methods.
 		 */
-		std::vector<FunctionInfo> inlinedMethods;
+		ShardedBuffer<FunctionInfo> inlinedMethods;
+
+		/**
+		 * Runs the part of the initialization that the CLR does not have to wait for and reads the file versions of
+		 * loaded assemblies, so that neither startup nor assembly loads wait for the file system.
+		 * Trace log entries written before the background initialization has created the log are buffered by the log.
+		 */
+		BackgroundWorker backgroundWorker;
+
+		/** Created by the first task of the backgroundWorker that needs it and only used by it. */
+		std::unique_ptr<FileVersionCache> fileVersionCache;
+
+		/** Hit flags of all methods instrumented for block coverage. */
+		BlockCoverage blockCoverage;
+
+		/** Records the raw callbacks if configured, see Config::getCallbackRecordingPath. */
+		CallbackRecorder callbackRecorder;
 
 		/** Smart pointer to the .NET framework profiler info. */
 		CComQIPtr<ICorProfilerInfo8> profilerInfo;
@@ -105,11 +167,79 @@ namespace Profiler {
 		/** Inter-process connection for TIA communication. null if not in TIA mode. */
 		std::unique_ptr<Ipc> ipc{};
 
-		/** Callback that is being called when a testcase starts. */
-		void onTestStart(const std::string& testName);
+		/** Detaches the profiler once no new methods were recorded for the configured time. null if not configured or not possible. */
+		std::unique_ptr<IdleTimer> idleTimer{};
+
+		/**
+		 * Whether the profiler can detach from the running process. Not possible once it set immutable event flags, i.e.
+		 * disabled NGEN images or inlining, or hooked method enters or replaced method bodies.
+		 */
+		bool canDetach();
+
+		/**
+		 * Stops all callbacks and asks the CLR to detach the profiler, which then calls ProfilerDetachSucceeded.
+		 * Retries while the CLR does not allow a detach yet, e.g. right after the initialization.
+		 */
+		HRESULT requestDetach();
+
+		/** Writes the recorded methods and detaches. Called by the idleTimer. */
+		void detachWhenIdle();
+
+		/**
+		 * Callback that is being called when a testcase starts. Test context 0 is the process-wide testcase,
+		 * others are recorded concurrently for the threads bound to them, see SetTestContext.
+		 */
+		void onTestStart(const std::string& testName, unsigned int contextId = 0);
+
+		/**
+		 * Callback that is being called when a testcase ends. Returns the encoded coverage of the testcase if it should be
+		 * sent to the test runner, else the empty string.
+		 */
+		std::string onTestEnd(const std::string& result = "", const std::string& duration = "", unsigned int contextId = 0);
+
+		/** A testcase that is recorded concurrently with others for the threads bound to its test context. */
+		struct TestContext {
+			std::string testName;
+
+			/** When the testcase started, formatted for the trace file. */
+			std::string startTime;
+
+			bool isRunning = false;
 
-		/** Callback that is being called when a testcase ends. */
-		void onTestEnd(const std::string& result = "", const std::string& duration = "");
+			/** Only one of them exists, depending on whether calls are counted. */
+			std::unique_ptr<FunctionIdSet> calledMethodIds;
+			std::unique_ptr<FunctionIdCounter> calledMethodCounter;
+		};
+
+		/**
+		 * Indexed by test context ID. Created for the first testcase in a context and kept afterwards, as bound threads may
+		 * still be recording into them. Guarded by writerSynchronization.
+		 */
+		std::unique_ptr<TestContext> testContexts[MAX_TEST_CONTEXT_ID + 1];
+
+		/** Starts recording a testcase in the given test context. Must be called by the owner of writerSynchronization. */
+		void startTestInContext(unsigned int contextId, const std::string& testName);
+
+		/**
+		 * Stops recording the testcase in the given test context, writes it to the trace file and returns its encoded coverage
+		 * if it should be sent to the test runner. Must be called by the owner of writerSynchronization.
+		 */
+		std::string endTestInContext(unsigned int contextId, const std::string& result, const std::string& duration);
+
+		/** Encodes the given coverage of the given testcase for the test runner. */
+		std::string encodeTestCoverage(const std::string& testName, std::vector<FunctionInfo> coverage);
+
+		/** The name of the running testcase. Guarded by writerSynchronization. */
+		std::string currentTestName;
+
+		/**
+		 * The methods called during the running testcase, which may contain duplicates. Only filled if the coverage is
+		 * sent to the test runner. Guarded by writerSynchronization.
+		 */
+		std::vector<FunctionInfo> currentTestCoverage;
+
+		/** Whether the called methods must be added to currentTestCoverage. Must be called by the owner of writerSynchronization. */
+		bool isStreamingTestCoverage();
 
 		/**
 		 * Keeps track of called methods.
@@ -118,10 +248,13 @@ namespace Profiler {
 		FunctionIdSet calledMethodIds;
 
 		/**
-		 * Keeps track of called methods.
-		 * We use the vector to uniquely store the information about called methods.
+		 * Keeps track of how often methods were called.
+		 * Used instead of calledMethodIds if call counting is enabled.
 		 */
-		std::vector<FunctionInfo> calledMethods;
+		FunctionIdCounter calledMethodCounter;
+
+		/** Methods that are not hooked because they are trivial, only filled if they should be logged. */
+		ShardedBuffer<FunctionInfo> excludedMethods;
 
 		/**
 		* Returns the event mask which tells the CLR which callbacks the profiler wants to subscribe
@@ -132,18 +265,38 @@ namespace Profiler {
 		DWORD getEventMask();
 
 		/**
-		* Defines whether the given function should trigger a callback everytime it is executed.
-		*
-		* We do not register a single function callback in order to not affect
-		* performance. In effect, we disable this feature here. It has been tested via
-		* a performance benchmark, that this implementation does not impact call
-		* performance.
+		* Defines whether the given function should trigger the enter hook everytime it is executed.
 		*
-		* For coverage profiling, we do not need this callback. However, the event is
-		* enabled in the event mask in order to force JIT-events for each first call to
-		* a function, independent of whether a pre-jitted version exists.)
+		* Only registered in TIA mode if assembly or namespace patterns are configured. It then disables
+		* the hook for all functions that are not interesting, so they do not cost anything when called.
+		* The client data is the profiler callback instance. Returns the function ID as client ID, so the
+		* enter hook receives the same ID as without a mapper.
+		*/
+		static UINT_PTR _stdcall functionMapper(FunctionID functionId, void* clientData, BOOL* pbHookFunction);
+
+		/**
+		* Whether the given function matches the configured assembly and namespace patterns.
+		* Functions of assemblies that do not match are rejected without any metadata resolution.
 		*/
-		static UINT_PTR _stdcall functionMapper(FunctionID functionId, BOOL* pbHookFunction) throw(...);
+		bool isInterestingFunction(FunctionID functionId);
+
+		/** Whether any assembly or namespace patterns are configured. */
+		bool hasFunctionFilters();
+
+		/** Whether the enter hook should be called for the given function, i.e. it is interesting and not trivial. */
+		bool shouldHookFunction(FunctionID functionId);
+
+		/** Whether a minimum IL size or excluded attributes are configured. */
+		bool hasTrivialMethodPolicy();
+
+		/** Whether the given function is smaller than the minimum IL size or annotated with an excluded attribute. */
+		bool isTrivialFunction(FunctionID functionId);
+
+		/** Whether the given method or one of its declaring types is annotated with one of the excluded attributes. */
+		bool hasExcludedAttribute(ModuleID moduleId, mdToken functionToken);
+
+		/** Returns the namespace of the type that declares the given method, or of its outermost type for nested types. */
+		std::wstring getNamespace(ModuleID moduleId, mdToken functionToken);
 		void adjustEventMask();
 
 		/** Dumps all environment variables to the log file. */
@@ -151,30 +304,58 @@ namespace Profiler {
 
 		void initializeConfig();
 
+		/** Creates the attach and trace logs and logs the config warnings. */
+		void initializeLogs();
+
+		/** Logs the config problems, notifies the user and terminates the process. */
+		void reportConfigProblems();
+
+		/**
+		 * Does everything that Initialize does not need to do before the first managed code runs, e.g. creating the logs and
+		 * launching the upload daemon. Finally logs how long the different steps of the startup took. Runs on the backgroundWorker.
+		 */
+		void initializeInBackground(long long configMicroseconds, long long inlineMicroseconds);
+
 		/** Returns a proxy for the upload daemon process */
 		static UploadDaemon createDaemon();
 
 		/** Create method info object for a function id. */
 		HRESULT getFunctionInfo(FunctionID functionID, FunctionInfo& info);
 
-		/**  Store assembly counter for id. */
-		int registerAssembly(AssemblyID assemblyId);
+		/** Create method info object for a function id and also return the module that declares the function. */
+		HRESULT getFunctionInfo(FunctionID functionID, FunctionInfo& info, ModuleID& moduleId);
 
-		/** Stores the assmebly name, path and metadata in the passed variables.*/
-		void getAssemblyInfo(AssemblyID assemblyId, WCHAR* assemblyName, WCHAR* assemblyPath, ASSEMBLYMETADATA* moduleId);
+		/** Replaces the IL body of the given function with one that records which basic blocks are executed. */
+		void instrumentBasicBlocks(FunctionID functionId);
 
-		/** Triggers eagerly writing of function infos to log. */
-		void recordFunctionInfo(std::vector<FunctionInfo>& list, FunctionID calleeId);
+		/** Stores the assmebly name, path, metadata and the ID of its manifest module in the passed variables.*/
+		void getAssemblyInfo(AssemblyID assemblyId, WCHAR* assemblyName, WCHAR* assemblyPath, ASSEMBLYMETADATA* moduleId, ModuleID& manifestModuleId);
+
+		/** Resolves the function and appends it to the given buffer. Returns the number of functions in the buffer afterwards. */
+		LONG recordFunctionInfo(ShardedBuffer<FunctionInfo>& buffer, FunctionID calleeId);
 
 		/** Returns whether eager mode is enabled and amount of recorded method calls reached eagerness threshold. */
 		bool shouldWriteEagerly();
 
-		/** Write all information about the recorded functions to the log and clears the log. */
+		/**
+		 * Writes the recorded functions to the log unless another thread is already doing so. In that case,
+		 * the other thread or a later call picks up the functions, so the calling callback never waits.
+		 */
+		void tryWriteFunctionInfosToLog();
+
+		/** Write all information about the recorded functions to the log and clears the log. Must be called by the owner of writerSynchronization. */
 		void writeFunctionInfosToLog();
 
-		/** Writes the fileVersionInfo into the provided buffer. */
-		void writeFileVersionInfo(LPCWSTR assemblyPath, std::wostringstream&);
+		/** Clears the given set and appends the resolved functions that were in it, except those of the core library. */
+		void collectCalledMethods(FunctionIdSet& calledIds, std::vector<FunctionInfo>& calledMethods);
+
+		/** Clears the given counter and appends the resolved functions that were in it with their counts, except those of the core library. */
+		void collectCalledMethodCounts(FunctionIdCounter& counter, std::vector<FunctionCallCount>& calledMethodCounts);
+
+		/** Appends the file versions and, if configured, the path to the given assembly line and writes it to the log. Runs on the backgroundWorker. */
+		void logAssemblyWithFileVersion(const std::wstring& assemblyLine, const std::wstring& assemblyPath);
 
+		HRESULT JITCompilationStartedImplementation(FunctionID functionID);
 		HRESULT JITCompilationFinishedImplementation(FunctionID functionID);
 		HRESULT AssemblyLoadFinishedImplementation(AssemblyID assemblyID);
 		HRESULT JITInliningImplementation(FunctionID calleeID, BOOL* pfShouldInline);
@@ -15,4 +15,31 @@ namespace Profiler {
 		/** Metadata token of the function. */
 		mdToken functionToken;
 	};
+
+	/**
+	 * Struct that stores how often a function was called.
+	 */
+	struct FunctionCallCount {
+
+		/** The called function. */
+		FunctionInfo function;
+
+		/** Number of calls, saturates at FunctionIdCounter::SATURATION. */
+		ULONG count;
+	};
+
+	/**
+	 * Struct that stores information to uniquely identify a basic block of a function.
+	 */
+	struct BlockInfo {
+
+		/** Index into the assemblyMap of the assembly that contains the function. */
+		int assemblyNumber;
+
+		/** Metadata token of the function. */
+		mdToken functionToken;
+
+		/** Offset of the first IL instruction of the block in the original method body. */
+		ULONG ilOffset;
+	};
 }
@@ -4,6 +4,16 @@
 #include "utils/WindowsUtils.h"
 
 namespace Profiler {
+	namespace {
+		/** The pipe on which the running daemon receives commands. Must match UploadDaemon.cs. */
+		const char* CONTROL_PIPE_NAME = "\\\\.\\pipe\\UploadDaemon/ControlPipe";
+
+		/** Makes the daemon upload. Followed by a tab and the path of the finished trace file, if any. */
+		const std::string COMMAND_RUN = "run";
+
+		/** How long to wait for the daemon to accept another connection if it is currently accepting one. */
+		const DWORD BUSY_PIPE_TIMEOUT_MILLISECONDS = 100;
+	}
 
 	UploadDaemon::UploadDaemon(std::string profilerPath)
 	{
@@ -17,6 +27,11 @@ namespace Profiler {
 
 	void UploadDaemon::launch(TraceLog& traceLog)
 	{
+		if (isRunning()) {
+			traceLog.info("Upload daemon is already running");
+			return;
+		}
+
 		bool successful = execute();
 		if (!successful)
 		{
@@ -24,13 +39,43 @@ namespace Profiler {
 		}
 	}
 
-	void UploadDaemon::notifyShutdown()
+	void UploadDaemon::notifyShutdown(const std::string& traceFilePath)
 	{
+		if (sendToRunningDaemon(COMMAND_RUN + "\t" + traceFilePath)) {
+			return;
+		}
+
 		// Cannot log unsuccessful execution, because log is already closed at this
 		// point (otherwise it could not be uploaded).
 		execute();
 	}
 
+	bool UploadDaemon::isRunning()
+	{
+		if (WaitNamedPipeA(CONTROL_PIPE_NAME, 1)) {
+			return true;
+		}
+		// the pipe exists, but the daemon is currently busy with another connection
+		return GetLastError() == ERROR_SEM_TIMEOUT;
+	}
+
+	bool UploadDaemon::sendToRunningDaemon(const std::string& command)
+	{
+		HANDLE pipe = CreateFileA(CONTROL_PIPE_NAME, GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+		if (pipe == INVALID_HANDLE_VALUE && GetLastError() == ERROR_PIPE_BUSY && WaitNamedPipeA(CONTROL_PIPE_NAME, BUSY_PIPE_TIMEOUT_MILLISECONDS)) {
+			pipe = CreateFileA(CONTROL_PIPE_NAME, GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+		}
+		if (pipe == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+
+		std::string line = command + "\n";
+		DWORD bytesWritten = 0;
+		BOOL successful = WriteFile(pipe, line.data(), static_cast<DWORD>(line.size()), &bytesWritten, nullptr);
+		CloseHandle(pipe);
+		return successful && bytesWritten == line.size();
+	}
+
 	bool UploadDaemon::execute()
 	{
 		if (!WindowsUtils::isFile(this->pathToExe)) {
@@ -54,10 +99,11 @@ namespace Profiler {
 		shExecInfo.nShow = SW_NORMAL;
 		shExecInfo.hInstApp = nullptr;
 
-		return ShellExecuteEx(&shExecInfo);
+		BOOL successful = ShellExecuteEx(&shExecInfo);
 
 		// We reset the environment of this process. This does not affect the launched child process
 		SetEnvironmentVariable("COR_ENABLE_PROFILING", "1");
+		return successful;
 	}
 }
 
@@ -4,7 +4,8 @@
 
 namespace Profiler {
 	/**
-	 * Launches the upload daemon executable that runs in the background.
+	 * Launches the upload daemon executable that runs in the background and notifies it about finished trace files.
+	 * A daemon that is already running is notified via its control pipe instead of launching another process.
 	 */
 	class UploadDaemon {
 	public:
@@ -15,11 +16,14 @@ namespace Profiler {
 		/** Destructor. */
 		virtual ~UploadDaemon() noexcept;
 
-		/** Starts the upload daemon in a new background process. */
+		/** Starts the upload daemon in a new background process unless it is already running. */
 		void launch(TraceLog& traceLog);
 
-		/** Notifies the upload daemon that a profiler is shut down. */
-		void notifyShutdown();
+		/**
+		 * Notifies the upload daemon that a profiler is shut down and its trace file is complete.
+		 * Only launches a new daemon process if no daemon is listening on the control pipe.
+		 */
+		void notifyShutdown(const std::string& traceFilePath);
 
 	private:
 		/** Path to the executable of the upload daemon. */
@@ -27,6 +31,14 @@ namespace Profiler {
 
 		/** Invoke the upload daemon process */
 		bool execute();
+
+		/** Whether a daemon is listening on the control pipe. */
+		bool isRunning();
+
+		/**
+		 * Sends the given command to the running daemon. Does not wait for the daemon to process it,
+		 * as the command fits into the pipe buffer. Returns false if no daemon is listening.
+		 */
+		bool sendToRunningDaemon(const std::string& command);
 	};
 }
-
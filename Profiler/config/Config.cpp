@@ -1,6 +1,10 @@
 #include "Config.h"
+#include "ConfigCache.h"
+#include "ProcessSectionIndex.h"
 #include "utils/WindowsUtils.h"
 #include <exception>
+#include <iterator>
+#include <sstream>
 
 namespace Profiler {
 	std::string Config::getDefaultConfigPath()
@@ -21,7 +25,8 @@ namespace Profiler {
 				// we must still load the values from the environment in this case so we don't return here
 			}
 			else {
-				loadYamlConfig(stream);
+				std::string contents((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+				loadCachedYamlConfig(configFilePath, contents);
 			}
 		}
 		else if (logProblemIfConfigFileDoesNotExist) {
@@ -37,34 +42,76 @@ namespace Profiler {
 		setOptions();
 	}
 
+	void Config::load(const ConfigFile& configFile, std::string processPath) {
+		this->processPath = processPath;
+		applyMatchingSections(configFile);
+		setOptions();
+	}
+
 	void Config::loadYamlConfig(std::istream& configFileContents) {
 		ConfigFile configFile;
+		if (parseYamlConfig(configFileContents, configFile)) {
+			applyMatchingSections(configFile);
+		}
+	}
+
+	void Config::loadCachedYamlConfig(const std::string& configFilePath, const std::string& configFileContents) {
+		ConfigCache cache(configFilePath + ".cache", ConfigCache::computeFingerprint(configFilePath, configFileContents));
+		if (cache.load() && cache.findResolvedOptions(processPath, configFileOptions)) {
+			return;
+		}
+
+		ConfigFile configFile;
+		if (cache.hasSections()) {
+			configFile = cache.getConfigFile();
+		}
+		else {
+			std::istringstream stream(configFileContents);
+			if (!parseYamlConfig(stream, configFile)) {
+				return;
+			}
+			cache.setConfigFile(configFile);
+		}
+
+		if (!applyMatchingSections(configFile)) {
+			return;
+		}
+		cache.addResolvedOptions(processPath, configFileOptions);
+
+		// the config file may well be in a read-only directory, so we simply do without the cache then
+		cache.save();
+	}
+
+	bool Config::parseYamlConfig(std::istream& configFileContents, ConfigFile& configFile) {
 		try {
 			configFile = ConfigParser::parse(configFileContents);
+			return true;
 		}
 		catch (const std::exception& e) {
 			problems.push_back(std::string("Failed to parse the config file: ") + e.what());
-			return;
 		}
 		catch (...) {
 			problems.push_back(std::string("Failed to parse the config file. The reason is unknown"));
-			return;
-		}
-
-		for (ProcessSection& section : configFile.sections) {
-			if (sectionMatches(section)) {
-				relevantConfigFileSections.insert(relevantConfigFileSections.begin(), section);
-			}
 		}
+		return false;
 	}
 
-	bool Config::sectionMatches(ProcessSection& section) {
-		if (!std::regex_match(processPath, section.executablePathRegex)) {
+	bool Config::applyMatchingSections(const ConfigFile& configFile) {
+		ProcessSectionIndex index(configFile);
+		std::vector<size_t> matchingSections;
+		try {
+			matchingSections = index.findMatchingSections(processPath);
+		}
+		catch (const std::regex_error& e) {
+			problems.push_back(std::string("Failed to parse the config file. Invalid executablePathRegex: ") + e.what());
 			return false;
 		}
-
-		std::string executableName = StringUtils::getLastPartOfPath(processPath);
-		return section.caseInsensitiveExecutableName.empty() || StringUtils::equalsIgnoreCase(section.caseInsensitiveExecutableName, executableName);
+		for (size_t sectionIndex : matchingSections) {
+			for (const auto& option : configFile.sections[sectionIndex].profilerOptions) {
+				configFileOptions[option.first] = option.second;
+			}
+		}
+		return true;
 	}
 
 	void Config::setOptions()
@@ -79,11 +126,16 @@ namespace Profiler {
 		startUploadDaemon = getBooleanOption("upload_daemon", false);
 		tgaEnabled = getBooleanOption("tga", true);
 		tiaEnabled = getBooleanOption("tia", false);
+		blockCoverageEnabled = getBooleanOption("block_coverage", false);
+		countCalls = getBooleanOption("call_counts", false);
 
 		tiaRequestSocket = getOption("tia_request_socket");
 		if (tiaRequestSocket.empty()) {
 			tiaRequestSocket = "tcp://127.0.0.1:7145";
 		}
+		tiaSubscribeSocket = getOption("tia_subscribe_socket");
+		streamTestCoverage = getBooleanOption("tia_stream_coverage", false);
+		callbackRecordingPath = getOption("record_callbacks");
 		std::string eagernessValue = getOption("eagerness");
 		if (eagernessValue.empty()) {
 			eagerness = 0;
@@ -97,6 +149,72 @@ namespace Profiler {
 			}
 		}
 
+		assemblyPatterns = GlobPatternList(getOption("assembly_include"), getOption("assembly_exclude"));
+		namespacePatterns = GlobPatternList(getOption("namespace_include"), getOption("namespace_exclude"));
+		logExcludedMethods = getBooleanOption("log_excluded_methods", false);
+
+		excludedAttributes.clear();
+		for (const std::string& attribute : StringUtils::split(getOption("excluded_attributes"), ';')) {
+			excludedAttributes.push_back(std::wstring(attribute.begin(), attribute.end()));
+		}
+
+		minimumIlSize = 0;
+		std::string minimumIlSizeValue = getOption("min_il_size");
+		if (!minimumIlSizeValue.empty()) {
+			int value = -1;
+			try {
+				value = std::stoi(minimumIlSizeValue);
+			}
+			catch (...) {
+				// handled below
+			}
+
+			if (value < 0) {
+				problems.push_back("Invalid minimum IL size configured: " + minimumIlSizeValue + ". Hooking methods of all sizes instead");
+			}
+			else {
+				minimumIlSize = static_cast<unsigned int>(value);
+			}
+		}
+
+		callSamplingInterval = 0;
+		std::string callSamplingIntervalValue = getOption("call_sampling_interval");
+		if (!callSamplingIntervalValue.empty()) {
+			int value = -1;
+			try {
+				value = std::stoi(callSamplingIntervalValue);
+			}
+			catch (...) {
+				// handled below
+			}
+
+			if (value < 0) {
+				problems.push_back("Invalid call sampling interval configured: " + callSamplingIntervalValue + ". Recording all calls instead");
+			}
+			else {
+				callSamplingInterval = static_cast<unsigned int>(value);
+			}
+		}
+
+		detachAfterIdleMinutes = 0;
+		std::string detachAfterIdleMinutesValue = getOption("detach_after_idle_minutes");
+		if (!detachAfterIdleMinutesValue.empty()) {
+			int value = -1;
+			try {
+				value = std::stoi(detachAfterIdleMinutesValue);
+			}
+			catch (...) {
+				// handled below
+			}
+
+			if (value < 0) {
+				problems.push_back("Invalid number of idle minutes before detaching configured: " + detachAfterIdleMinutesValue + ". Staying attached instead");
+			}
+			else {
+				detachAfterIdleMinutes = static_cast<unsigned int>(value);
+			}
+		}
+
 		disableProfilerIfProcessSuffixDoesntMatch();
 
 		// must happen last so all supported options have been queried by now
@@ -106,17 +224,11 @@ namespace Profiler {
 	void Config::warnAboutUnknownOptions() {
 		// We only inspect the sections that apply to the profiled process. Typos in the sections of other
 		// processes are not reported as every process would otherwise warn about every other process's options.
-		CaseInsensitiveStringSet unknownOptionNames;
-		for (ProcessSection& section : relevantConfigFileSections) {
-			for (const auto& option : section.profilerOptions) {
-				if (queriedOptionNames.find(option.first) == queriedOptionNames.end()) {
-					unknownOptionNames.insert(option.first);
-				}
+		for (const auto& option : configFileOptions) {
+			const std::string& optionName = option.first;
+			if (queriedOptionNames.find(optionName) != queriedOptionNames.end()) {
+				continue;
 			}
-		}
-
-		// the same option may be misspelled in several matching sections, so we warn only once per option name
-		for (const std::string& optionName : unknownOptionNames) {
 			warnings.push_back("Unknown profiler option '" + optionName
 				+ "' in the config file. Please check the spelling. This option is ignored.");
 		}
@@ -129,7 +241,7 @@ namespace Profiler {
 		}
 	}
 
-	std::string Config::getOption(std::string optionName) {
+	std::string Config::getOption(const char* optionName) {
 		// Remembering the queried options here relieves us of maintaining a separate list of all supported
 		// option names, which would silently go stale. warnAboutUnknownOptions reports everything that's left.
 		// This requires that setOptions queries every supported option unconditionally.
@@ -140,15 +252,14 @@ namespace Profiler {
 			return value;
 		}
 
-		for (ProcessSection section : relevantConfigFileSections) {
-			if (section.profilerOptions.find(optionName) != section.profilerOptions.end()) {
-				return section.profilerOptions[optionName];
-			}
+		CaseInsensitiveStringMap::const_iterator option = configFileOptions.find(optionName);
+		if (option != configFileOptions.end()) {
+			return option->second;
 		}
 		return "";
 	}
 
-	bool Config::getBooleanOption(std::string optionName, bool defaultValue) {
+	bool Config::getBooleanOption(const char* optionName, bool defaultValue) {
 		std::string value = getOption(optionName);
 		if (value.empty()) {
 			return defaultValue;
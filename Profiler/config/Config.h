@@ -3,6 +3,7 @@
 #include <fstream>
 #include "ConfigParser.h"
 #include "utils/Testing.h"
+#include "utils/GlobPatternList.h"
 
 namespace Profiler {
 	/** Abstracts reading a config value from the environment so the Config class is unit-testable. */
@@ -27,6 +28,9 @@ namespace Profiler {
 		/** Loads the config from the given YAML stream and applies all sections that apply to the given profiled process path. */
 		void EXPOSE_TO_CPP_TESTS load(std::istream& configFileContents, std::string processPath);
 
+		/** Applies all sections of the already parsed config file that apply to the given profiled process path. */
+		void EXPOSE_TO_CPP_TESTS load(const ConfigFile& configFile, std::string processPath);
+
 		/** Returns any problems encountered while loading the config, e.g. to log them. These are fatal and abort the profiled process. */
 		std::vector<std::string> getProblems() {
 			return problems;
@@ -42,6 +46,11 @@ namespace Profiler {
 			return configPath;
 		}
 
+		/** The names of all options the profiler supports, i.e. all options it queried while loading. */
+		const CaseInsensitiveLiteralSet& getSupportedOptionNames() {
+			return queriedOptionNames;
+		}
+
 		/** The directory to which to write the trace file. */
 		std::string getTargetDir() {
 			return targetDir;
@@ -101,17 +110,90 @@ namespace Profiler {
 			return tiaRequestSocket;
 		}
 
+		/**
+		 * The socket on which the test runner publishes test events to all profilers at once.
+		 * Empty if test events are instead delivered to each profiler on its own socket.
+		 */
+		std::string getTiaSubscribeSocket() {
+			return tiaSubscribeSocket;
+		}
+
+		/** Whether the methods called during a test should be sent to the test runner when the test ends, in addition to the trace file. */
+		bool shouldStreamTestCoverage() {
+			return streamTestCoverage;
+		}
+
+		/**
+		 * The file to which the raw stream of profiler callbacks should be recorded for replaying it offline,
+		 * see CallbackRecorder. Empty if callbacks should not be recorded.
+		 */
+		std::string getCallbackRecordingPath() {
+			return callbackRecordingPath;
+		}
+
+		/** Whether the number of calls should be recorded per method instead of only whether it was called. */
+		bool shouldCountCalls() {
+			return countCalls;
+		}
+
+		/**
+		 * Only every n-th call on average is recorded by the enter hook, with n being this interval.
+		 * 0 and 1 mean that all calls are recorded.
+		 */
+		unsigned int getCallSamplingInterval() {
+			return callSamplingInterval;
+		}
+
+		/**
+		 * The profiler detaches from the process once no new methods have been jitted or inlined for this many minutes.
+		 * 0 means that it stays attached until the process exits.
+		 */
+		unsigned int getDetachAfterIdleMinutes() {
+			return detachAfterIdleMinutes;
+		}
+
+		/** Patterns for the names of the assemblies whose methods should be recorded. */
+		const GlobPatternList& getAssemblyPatterns() {
+			return assemblyPatterns;
+		}
+
+		/** Patterns for the namespaces of the types whose methods should be recorded. */
+		const GlobPatternList& getNamespacePatterns() {
+			return namespacePatterns;
+		}
+
+		/** Methods whose IL code is smaller than this number of bytes are not hooked in TIA mode. 0 disables this. */
+		unsigned int getMinimumIlSize() {
+			return minimumIlSize;
+		}
+
+		/** Full names of attributes that exclude the methods they or their declaring types are annotated with from hooking in TIA mode. */
+		const std::vector<std::wstring>& getExcludedAttributes() {
+			return excludedAttributes;
+		}
+
+		/** Whether methods excluded from hooking as trivial should be written to the trace file. */
+		bool shouldLogExcludedMethods() {
+			return logExcludedMethods;
+		}
+
+		/** Whether methods should be instrumented to record which of their basic blocks were executed. */
+		bool isBlockCoverageEnabled() {
+			return blockCoverageEnabled;
+		}
+
 	private:
 
 		std::string processPath;
 		std::string configPath = "<not specified>";
-		std::vector<ProcessSection> relevantConfigFileSections;
+		/** The options of all config file sections that apply to the profiled process. Later sections win. */
+		CaseInsensitiveStringMap configFileOptions;
 		EnvironmentVariableReader* environmentVariableReader;
 		std::vector<std::string> problems;
 		std::vector<std::string> warnings;
 
 		/** The names of all options the profiler asked for, i.e. all options it supports. Filled by getOption. */
-		CaseInsensitiveStringSet queriedOptionNames;
+		CaseInsensitiveLiteralSet queriedOptionNames;
 
 		bool enabled;
 		std::string targetDir;
@@ -125,10 +207,23 @@ namespace Profiler {
 		bool tgaEnabled;
 		bool tiaEnabled;
 		std::string tiaRequestSocket;
+		std::string tiaSubscribeSocket;
+		bool streamTestCoverage;
+		std::string callbackRecordingPath;
+		bool blockCoverageEnabled;
+		bool countCalls;
+		unsigned int callSamplingInterval;
+		unsigned int detachAfterIdleMinutes;
+		GlobPatternList assemblyPatterns;
+		GlobPatternList namespacePatterns;
+		unsigned int minimumIlSize;
+		std::vector<std::wstring> excludedAttributes;
+		bool logExcludedMethods;
 
 		void apply(ConfigFile configFile);
-		std::string getOption(std::string key);
-		bool getBooleanOption(std::string key, bool defaultValue);
+		/** Must be called with a string literal, as only its address is remembered in queriedOptionNames. */
+		std::string getOption(const char* key);
+		bool getBooleanOption(const char* key, bool defaultValue);
 		void setOptions();
 
 		/**
@@ -137,7 +232,12 @@ namespace Profiler {
 		 */
 		void warnAboutUnknownOptions();
 		void loadYamlConfig(std::istream& configFileContents);
-		bool sectionMatches(ProcessSection& section);
+
+		/** Loads the config file with the given contents via its cache, which is updated if the profiled process is missing from it. */
+		void loadCachedYamlConfig(const std::string& configFilePath, const std::string& configFileContents);
+		bool parseYamlConfig(std::istream& configFileContents, ConfigFile& configFile);
+		/** Applies the options of all sections that match the profiled process. Returns false and adds a problem if a regex of a section is invalid. */
+		bool applyMatchingSections(const ConfigFile& configFile);
 
 		/** Backwards compatibility: disables the profiler if the suffix in the COR_PROFILER_PROCESS environment variable doesn't match the profiled process.  */
 		void disableProfilerIfProcessSuffixDoesntMatch();
@@ -0,0 +1,224 @@
+#include "ConfigCache.h"
+#include <Windows.h>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+namespace Profiler {
+	namespace {
+		/** Marks the beginning of a cache file. */
+		const unsigned int MAGIC = 0x43435054;
+
+		void writeNumber(std::ostream& stream, unsigned long long value) {
+			stream.write(reinterpret_cast<const char*>(&value), sizeof(value));
+		}
+
+		void writeString(std::ostream& stream, const std::string& value) {
+			writeNumber(stream, value.size());
+			stream.write(value.data(), value.size());
+		}
+
+		void writeOptions(std::ostream& stream, const CaseInsensitiveStringMap& options) {
+			writeNumber(stream, options.size());
+			for (const auto& option : options) {
+				writeString(stream, option.first);
+				writeString(stream, option.second);
+			}
+		}
+
+		/** Reads the binary cache contents. All read methods return false if the contents end prematurely. */
+		class Reader {
+		public:
+			explicit Reader(const std::string& contents) : contents(contents) {}
+
+			bool readNumber(unsigned long long& value) {
+				if (contents.size() - position < sizeof(value)) {
+					return false;
+				}
+				memcpy(&value, contents.data() + position, sizeof(value));
+				position += sizeof(value);
+				return true;
+			}
+
+			bool readString(std::string& value) {
+				unsigned long long length = 0;
+				if (!readNumber(length) || contents.size() - position < length) {
+					return false;
+				}
+				value = contents.substr(position, static_cast<size_t>(length));
+				position += static_cast<size_t>(length);
+				return true;
+			}
+
+			bool readOptions(CaseInsensitiveStringMap& options) {
+				unsigned long long count = 0;
+				if (!readNumber(count)) {
+					return false;
+				}
+				for (unsigned long long i = 0; i < count; i++) {
+					std::string name;
+					std::string value;
+					if (!readString(name) || !readString(value)) {
+						return false;
+					}
+					options[name] = value;
+				}
+				return true;
+			}
+
+			bool isAtEnd() {
+				return position == contents.size();
+			}
+
+		private:
+			const std::string& contents;
+			size_t position = 0;
+		};
+	}
+
+	ConfigCache::ConfigCache(const std::string& cacheFilePath, const ConfigFileFingerprint& fingerprint) :
+		cacheFilePath(cacheFilePath), fingerprint(fingerprint) {
+	}
+
+	ConfigFileFingerprint ConfigCache::computeFingerprint(const std::string& configFilePath, const std::string& contents) {
+		ConfigFileFingerprint result;
+		result.path = configFilePath;
+
+		WIN32_FILE_ATTRIBUTE_DATA attributes;
+		if (GetFileAttributesExA(configFilePath.c_str(), GetFileExInfoStandard, &attributes)) {
+			result.size = (static_cast<unsigned long long>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+			result.lastWriteTime = (static_cast<unsigned long long>(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+		}
+
+		result.hash = 14695981039346656037ULL;
+		for (char c : contents) {
+			result.hash ^= static_cast<unsigned char>(c);
+			result.hash *= 1099511628211ULL;
+		}
+		return result;
+	}
+
+	bool ConfigCache::load() {
+		std::ifstream stream(cacheFilePath, std::ios::binary);
+		if (stream.fail()) {
+			return false;
+		}
+		std::string contents((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+		Reader reader(contents);
+
+		unsigned long long magic = 0;
+		unsigned long long version = 0;
+		ConfigFileFingerprint cachedFingerprint;
+		if (!reader.readNumber(magic) || magic != MAGIC || !reader.readNumber(version) || version != FORMAT_VERSION
+			|| !reader.readString(cachedFingerprint.path) || !reader.readNumber(cachedFingerprint.size)
+			|| !reader.readNumber(cachedFingerprint.lastWriteTime) || !reader.readNumber(cachedFingerprint.hash)
+			|| !(cachedFingerprint == fingerprint)) {
+			return false;
+		}
+
+		std::vector<ProcessSection> cachedSections;
+		unsigned long long sectionCount = 0;
+		if (!reader.readNumber(sectionCount)) {
+			return false;
+		}
+		for (unsigned long long i = 0; i < sectionCount; i++) {
+			ProcessSection section;
+			if (!reader.readString(section.executablePathPattern) || !reader.readString(section.caseInsensitiveExecutableName)
+				|| !reader.readOptions(section.profilerOptions)) {
+				return false;
+			}
+			cachedSections.push_back(section);
+		}
+
+		std::map<std::string, CaseInsensitiveStringMap, StringUtils::CaseInsensitiveComparator> cachedOptions;
+		unsigned long long processCount = 0;
+		if (!reader.readNumber(processCount)) {
+			return false;
+		}
+		for (unsigned long long i = 0; i < processCount; i++) {
+			std::string processPath;
+			if (!reader.readString(processPath) || !reader.readOptions(cachedOptions[processPath])) {
+				return false;
+			}
+		}
+		if (!reader.isAtEnd()) {
+			return false;
+		}
+
+		sections = cachedSections;
+		resolvedOptions = cachedOptions;
+		hasConfigFile = true;
+		return true;
+	}
+
+	bool ConfigCache::save() const {
+		std::ostringstream stream(std::ios::binary);
+		writeNumber(stream, MAGIC);
+		writeNumber(stream, FORMAT_VERSION);
+		writeString(stream, fingerprint.path);
+		writeNumber(stream, fingerprint.size);
+		writeNumber(stream, fingerprint.lastWriteTime);
+		writeNumber(stream, fingerprint.hash);
+
+		writeNumber(stream, sections.size());
+		for (const ProcessSection& section : sections) {
+			writeString(stream, section.executablePathPattern);
+			writeString(stream, section.caseInsensitiveExecutableName);
+			writeOptions(stream, section.profilerOptions);
+		}
+
+		writeNumber(stream, resolvedOptions.size());
+		for (const auto& processOptions : resolvedOptions) {
+			writeString(stream, processOptions.first);
+			writeOptions(stream, processOptions.second);
+		}
+
+		// Written to a file of our own first, so that other processes only ever see complete caches
+		std::string temporaryFilePath = cacheFilePath + "." + std::to_string(GetCurrentProcessId()) + ".tmp";
+		{
+			std::ofstream file(temporaryFilePath, std::ios::binary | std::ios::trunc);
+			if (file.fail()) {
+				return false;
+			}
+			file << stream.str();
+			if (file.fail()) {
+				file.close();
+				DeleteFileA(temporaryFilePath.c_str());
+				return false;
+			}
+		}
+		if (!MoveFileExA(temporaryFilePath.c_str(), cacheFilePath.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+			DeleteFileA(temporaryFilePath.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	ConfigFile ConfigCache::getConfigFile() const {
+		ConfigFile configFile;
+		configFile.sections = sections;
+		return configFile;
+	}
+
+	void ConfigCache::setConfigFile(const ConfigFile& configFile) {
+		sections = configFile.sections;
+		resolvedOptions.clear();
+		hasConfigFile = true;
+	}
+
+	bool ConfigCache::findResolvedOptions(const std::string& processPath, CaseInsensitiveStringMap& options) const {
+		auto entry = resolvedOptions.find(processPath);
+		if (entry == resolvedOptions.end()) {
+			return false;
+		}
+		options = entry->second;
+		return true;
+	}
+
+	void ConfigCache::addResolvedOptions(const std::string& processPath, const CaseInsensitiveStringMap& options) {
+		if (resolvedOptions.size() >= MAX_CACHED_PROCESSES) {
+			resolvedOptions.clear();
+		}
+		resolvedOptions[processPath] = options;
+	}
+}
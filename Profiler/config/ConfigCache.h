@@ -0,0 +1,82 @@
+#pragma once
+#include <map>
+#include <string>
+#include <vector>
+#include "ConfigParser.h"
+#include "utils/StringUtils.h"
+#include "utils/Testing.h"
+
+namespace Profiler {
+	/** Identifies one version of a config file. */
+	struct ConfigFileFingerprint {
+		std::string path;
+		unsigned long long size = 0;
+		unsigned long long lastWriteTime = 0;
+		/** FNV-1a hash of the file contents, which also detects changes that keep size and last write time. */
+		unsigned long long hash = 0;
+
+		bool operator==(const ConfigFileFingerprint& other) const {
+			return StringUtils::equalsIgnoreCase(path, other.path) && size == other.size && lastWriteTime == other.lastWriteTime && hash == other.hash;
+		}
+	};
+
+	/**
+	 * Binary cache of a parsed config file, stored next to it. Besides the parsed sections, it stores the options
+	 * that apply to each executable that has been profiled with this config. A process that finds its executable
+	 * in the cache neither parses the YAML nor compiles any regex. Other processes at least skip the YAML parsing.
+	 *
+	 * The cache is only used if the fingerprint of the config file matches. It is replaced atomically, so concurrently
+	 * starting processes never read a partially written cache. If several processes add their executable at the same
+	 * time, only one of them wins, the others are added again on their next start.
+	 */
+	class ConfigCache
+	{
+	public:
+		/** Creates an empty cache for the config file with the given fingerprint that is stored in the given file. */
+		EXPOSE_TO_CPP_TESTS ConfigCache(const std::string& cacheFilePath, const ConfigFileFingerprint& fingerprint);
+
+		/** Computes the fingerprint of the config file at the given path with the given contents. */
+		static EXPOSE_TO_CPP_TESTS ConfigFileFingerprint computeFingerprint(const std::string& configFilePath, const std::string& contents);
+
+		/** Reads the cache file. Returns false if it doesn't exist, is corrupt or belongs to another version of the config file. */
+		bool EXPOSE_TO_CPP_TESTS load();
+
+		/** Writes the cache file. Returns false if that is not possible, e.g. because the directory is read-only. */
+		bool EXPOSE_TO_CPP_TESTS save() const;
+
+		/** Whether the parsed sections of the config file are known. */
+		bool hasSections() const {
+			return hasConfigFile;
+		}
+
+		/** Returns the parsed config file. Must only be called if hasSections(). */
+		ConfigFile EXPOSE_TO_CPP_TESTS getConfigFile() const;
+
+		/** Remembers the sections of the parsed config file. */
+		void EXPOSE_TO_CPP_TESTS setConfigFile(const ConfigFile& configFile);
+
+		/** Looks up the options from the config file that apply to the given process. Returns false if they are not cached. */
+		bool EXPOSE_TO_CPP_TESTS findResolvedOptions(const std::string& processPath, CaseInsensitiveStringMap& options) const;
+
+		/** Remembers the options from the config file that apply to the given process. */
+		void EXPOSE_TO_CPP_TESTS addResolvedOptions(const std::string& processPath, const CaseInsensitiveStringMap& options);
+
+	private:
+		/** Identifies the file format, must be changed whenever the format changes. */
+		static const unsigned int FORMAT_VERSION = 1;
+
+		/** Bounds the size of the cache for configs that are used with a lot of different executables. */
+		static const size_t MAX_CACHED_PROCESSES = 1000;
+
+		std::string cacheFilePath;
+		ConfigFileFingerprint fingerprint;
+
+		bool hasConfigFile = false;
+
+		/** The sections of the config file. */
+		std::vector<ProcessSection> sections;
+
+		/** Maps from the paths of processes to the options that apply to them. */
+		std::map<std::string, CaseInsensitiveStringMap, StringUtils::CaseInsensitiveComparator> resolvedOptions;
+	};
+}
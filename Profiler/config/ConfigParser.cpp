@@ -30,19 +30,23 @@ namespace Profiler {
 		return configFile;
 	}
 
+	std::regex ConfigParser::compileExecutablePathRegex(const std::string& pattern) {
+		return std::regex(pattern, std::regex_constants::ECMAScript | std::regex_constants::icase);
+	}
+
 	ProcessSection ConfigParser::parseMatchSection(YAML::Node& node)
 	{
 		ProcessSection section;
 
-		std::string processRegex = node["executablePathRegex"].as<std::string>(".*");
-		section.executablePathRegex = std::regex(processRegex, std::regex_constants::ECMAScript | std::regex_constants::icase);
+		section.executablePathPattern = node["executablePathRegex"].as<std::string>(".*");
 
 		section.caseInsensitiveExecutableName = { node["executableName"].as<std::string>("") };
 
 		for (auto optionEntry : node["profiler"]) {
 			std::string optionName = optionEntry.first.as<std::string>();
 			std::string value = optionEntry.second.as<std::string>();
-			section.profilerOptions[optionName] = value;
+			// normalized once here so that unknown options are reported consistently regardless of their spelling in the file
+			section.profilerOptions[StringUtils::lowercase(optionName)] = value;
 		}
 
 		return section;
@@ -9,8 +9,11 @@
 namespace Profiler {
 	/** A process-specific config section. */
 	struct ProcessSection {
-		/** Regular expression that must match the full process path for the section to be applied. Defaults to ".*" in case the user didn't set this field explicitly. */
-		std::regex executablePathRegex;
+		/**
+		 * Regular expression that must match the full process path for the section to be applied. Defaults to ".*" in case the user didn't set this field explicitly.
+		 * Only compiled with ConfigParser::compileExecutablePathRegex when a process must be matched against it, as compiling takes far longer than parsing.
+		 */
+		std::string executablePathPattern;
 		/** Name of the executable to which this section applies or the empty string if this field should be ignored. Must be compared case-insensitively. */
 		std::string caseInsensitiveExecutableName;
 		/** The profiler options to apply if this section matches the profiled process. */
@@ -45,6 +48,9 @@ namespace Profiler {
 		/** Parses the given stream as a YAML config file. Throws ConfigParsingException if parsing fails. */
 		static EXPOSE_TO_CPP_TESTS ConfigFile parse(std::istream& stream);
 
+		/** Compiles the executable path pattern as the parser does. Throws std::regex_error for invalid patterns. */
+		static EXPOSE_TO_CPP_TESTS std::regex compileExecutablePathRegex(const std::string& pattern);
+
 	private:
 		static ConfigFile parseUnsafe(std::istream& stream);
 		static ProcessSection parseMatchSection(YAML::Node& node);
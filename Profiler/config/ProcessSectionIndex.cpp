@@ -0,0 +1,149 @@
+#include "ProcessSectionIndex.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+namespace Profiler {
+	ProcessSectionIndex::ProcessSectionIndex(const ConfigFile& configFile) : sections(configFile.sections) {
+		for (size_t i = 0; i < sections.size(); i++) {
+			const ProcessSection& section = sections[i];
+
+			Candidate candidate;
+			candidate.sectionIndex = i;
+			candidate.matchesAllPaths = section.executablePathPattern == ".*";
+			if (!candidate.matchesAllPaths) {
+				candidate.requiredLiteral = getRequiredLiteral(section.executablePathPattern);
+			}
+
+			if (section.caseInsensitiveExecutableName.empty()) {
+				candidatesForAllExecutables.push_back(candidate);
+			}
+			else {
+				candidatesByExecutableName[section.caseInsensitiveExecutableName].push_back(candidate);
+			}
+		}
+	}
+
+	std::vector<size_t> ProcessSectionIndex::findMatchingSections(const std::string& processPath) const {
+		std::string uppercasedProcessPath = StringUtils::uppercase(processPath);
+
+		std::vector<size_t> matchingSections;
+		addMatching(candidatesForAllExecutables, processPath, uppercasedProcessPath, matchingSections);
+
+		auto executableCandidates = candidatesByExecutableName.find(StringUtils::getLastPartOfPath(processPath));
+		if (executableCandidates != candidatesByExecutableName.end()) {
+			size_t sectionsForAllExecutables = matchingSections.size();
+			addMatching(executableCandidates->second, processPath, uppercasedProcessPath, matchingSections);
+			std::inplace_merge(matchingSections.begin(), matchingSections.begin() + sectionsForAllExecutables, matchingSections.end());
+		}
+		return matchingSections;
+	}
+
+	void ProcessSectionIndex::addMatching(const std::vector<Candidate>& candidates, const std::string& processPath,
+		const std::string& uppercasedProcessPath, std::vector<size_t>& matchingSections) const {
+		for (const Candidate& candidate : candidates) {
+			if (candidate.matchesAllPaths) {
+				matchingSections.push_back(candidate.sectionIndex);
+				continue;
+			}
+			if (!candidate.requiredLiteral.empty() && uppercasedProcessPath.find(candidate.requiredLiteral) == std::string::npos) {
+				continue;
+			}
+			std::regex executablePathRegex = ConfigParser::compileExecutablePathRegex(sections[candidate.sectionIndex].executablePathPattern);
+			if (std::regex_match(processPath, executablePathRegex)) {
+				matchingSections.push_back(candidate.sectionIndex);
+			}
+		}
+	}
+
+	std::string ProcessSectionIndex::getRequiredLiteral(const std::string& pattern) {
+		std::string longestLiteral;
+		std::string currentLiteral;
+		int groupDepth = 0;
+
+		for (size_t i = 0; i < pattern.length(); i++) {
+			char c = pattern[i];
+			bool isLiteral = false;
+
+			if (c == '|' && groupDepth == 0) {
+				// the alternatives need not share any literal, so nothing is required
+				return "";
+			}
+			else if (c == '\\' && i + 1 < pattern.length()) {
+				i++;
+				c = pattern[i];
+				// escaped letters and digits are character classes, anchors, back references or character codes.
+				// The operands of the latter are no literals either, e.g. the digits of \x41
+				isLiteral = !isalnum(static_cast<unsigned char>(c));
+				if (c == 'x') {
+					i += 2;
+				}
+				else if (c == 'u') {
+					i += 4;
+				}
+				else if (c == 'c') {
+					i += 1;
+				}
+				else if (isdigit(static_cast<unsigned char>(c))) {
+					while (i + 1 < pattern.length() && isdigit(static_cast<unsigned char>(pattern[i + 1]))) {
+						i++;
+					}
+				}
+			}
+			else if (c == '[') {
+				// skip the character class, which may contain any of the special characters
+				size_t end = i + 1;
+				if (end < pattern.length() && pattern[end] == '^') {
+					end++;
+				}
+				if (end < pattern.length() && pattern[end] == ']') {
+					end++;
+				}
+				while (end < pattern.length() && pattern[end] != ']') {
+					if (pattern[end] == '\\') {
+						end++;
+					}
+					end++;
+				}
+				i = end;
+			}
+			else if (c == '(') {
+				groupDepth++;
+			}
+			else if (c == ')') {
+				groupDepth--;
+			}
+			else if (c == '?' || c == '*' || c == '{') {
+				// the preceding character is optional or repeated
+				if (!currentLiteral.empty()) {
+					currentLiteral.pop_back();
+				}
+				if (c == '{') {
+					i = pattern.find('}', i);
+					if (i == std::string::npos) {
+						return "";
+					}
+				}
+			}
+			else if (strchr(".+^$", c) == nullptr) {
+				isLiteral = true;
+			}
+
+			// non-ASCII characters may be case-folded differently by the regex, so we don't rely on them
+			if (isLiteral && groupDepth == 0 && static_cast<unsigned char>(c) < 0x80) {
+				currentLiteral += static_cast<char>(toupper(c));
+				continue;
+			}
+
+			if (currentLiteral.length() > longestLiteral.length()) {
+				longestLiteral = currentLiteral;
+			}
+			currentLiteral.clear();
+		}
+
+		if (currentLiteral.length() > longestLiteral.length()) {
+			longestLiteral = currentLiteral;
+		}
+		return longestLiteral;
+	}
+}
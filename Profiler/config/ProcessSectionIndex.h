@@ -0,0 +1,57 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ConfigParser.h"
+#include "utils/Testing.h"
+
+namespace Profiler {
+	/**
+	 * Finds the sections of a config file that apply to a process without evaluating the regex of every section.
+	 * Sections with an executable name are looked up by that name. The regexes of the remaining candidates are only
+	 * compiled and evaluated if the process path contains the literal text that the regex requires, and not at all for ".*".
+	 *
+	 * The index refers to the sections of the given config file, which must outlive it.
+	 */
+	class ProcessSectionIndex
+	{
+	public:
+		EXPOSE_TO_CPP_TESTS ProcessSectionIndex(const ConfigFile& configFile);
+
+		/**
+		 * Returns the indices of all sections that apply to the given process in the order in which they appear in the config file.
+		 * Throws std::regex_error if the regex of a candidate section is invalid.
+		 */
+		std::vector<size_t> EXPOSE_TO_CPP_TESTS findMatchingSections(const std::string& processPath) const;
+
+		/**
+		 * Returns the longest text that every path matched by the given executable path regex must contain,
+		 * uppercased, or the empty string if the regex is too complex to tell.
+		 */
+		static EXPOSE_TO_CPP_TESTS std::string getRequiredLiteral(const std::string& pattern);
+
+	private:
+		/** A section that can apply to a process. */
+		struct Candidate {
+			size_t sectionIndex;
+
+			/** Whether the regex of the section matches all paths, so it need not be evaluated. */
+			bool matchesAllPaths;
+
+			/** Uppercased text that must occur in the path for the regex to match. May be empty. */
+			std::string requiredLiteral;
+		};
+
+		const std::vector<ProcessSection>& sections;
+
+		/** Maps from the executable name to the sections for that executable, in config file order. */
+		std::unordered_map<std::string, std::vector<Candidate>, StringUtils::CaseInsensitiveHash, StringUtils::CaseInsensitiveEquality> candidatesByExecutableName;
+
+		/** The sections without an executable name, in config file order. */
+		std::vector<Candidate> candidatesForAllExecutables;
+
+		/** Appends the indices of the candidates whose regex matches the given path to the given list. */
+		void addMatching(const std::vector<Candidate>& candidates, const std::string& processPath,
+			const std::string& uppercasedProcessPath, std::vector<size_t>& matchingSections) const;
+	};
+}
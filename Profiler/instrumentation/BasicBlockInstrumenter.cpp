@@ -0,0 +1,581 @@
+#include "BasicBlockInstrumenter.h"
+
+namespace Profiler {
+	namespace {
+		/** The kinds of inline operands an IL instruction can have. */
+		enum class OperandType {
+			None,
+			Int8,
+			Int16,
+			Int32,
+			Int64,
+			ShortBranch,
+			Branch,
+			Switch,
+			Invalid
+		};
+
+		// Method header flags, see ECMA-335 II.25.4
+		const BYTE TINY_FORMAT = 0x2;
+		const BYTE FAT_FORMAT = 0x3;
+		const USHORT FAT_FORMAT_MORE_SECTS = 0x8;
+		const USHORT FAT_FORMAT_INIT_LOCALS = 0x10;
+		const USHORT FAT_HEADER_SIZE_IN_DWORDS = 3;
+		const ULONG FAT_HEADER_SIZE = 12;
+
+		// Exception handling section flags, see ECMA-335 II.25.4.5
+		const BYTE SECTION_EH_TABLE = 0x1;
+		const BYTE SECTION_FAT_FORMAT = 0x40;
+		const BYTE SECTION_MORE_SECTS = 0x80;
+		const ULONG SMALL_CLAUSE_SIZE = 12;
+		const ULONG FAT_CLAUSE_SIZE = 24;
+		const ULONG CLAUSE_FILTER = 0x1;
+
+		// Opcodes we need to treat specially
+		const USHORT OPCODE_JMP = 0x27;
+		const USHORT OPCODE_RET = 0x2A;
+		const USHORT OPCODE_SHORT_BRANCH_FIRST = 0x2B;
+		const USHORT OPCODE_SHORT_BRANCH_LAST = 0x37;
+		const USHORT SHORT_TO_LONG_BRANCH_DELTA = 0x0D;
+		const USHORT OPCODE_THROW = 0x7A;
+		const USHORT OPCODE_ENDFINALLY = 0xDC;
+		const USHORT OPCODE_LEAVE = 0xDD;
+		const USHORT OPCODE_LEAVE_S = 0xDE;
+		const USHORT OPCODE_ENDFILTER = 0xFE11;
+		const USHORT OPCODE_TAIL = 0xFE14;
+		const USHORT OPCODE_RETHROW = 0xFE1A;
+
+		// The probe is: ldc.i8/ldc.i4 <address>; conv.u; ldc.i4.1; stind.i1
+		const BYTE OPCODE_LDC_I4 = 0x20;
+		const BYTE OPCODE_LDC_I8 = 0x21;
+		const BYTE OPCODE_CONV_U = 0xE0;
+		const BYTE OPCODE_LDC_I4_1 = 0x17;
+		const BYTE OPCODE_STIND_I1 = 0x52;
+		const ULONG PROBE_SIZE = 1 + sizeof(void*) + 3;
+		const USHORT PROBE_STACK_SIZE = 2;
+
+		OperandType getOneByteOperandType(BYTE opcode) {
+			if (opcode >= 0x0E && opcode <= 0x13) {
+				return OperandType::Int8;
+			}
+			if (opcode >= OPCODE_SHORT_BRANCH_FIRST && opcode <= OPCODE_SHORT_BRANCH_LAST) {
+				return OperandType::ShortBranch;
+			}
+			if (opcode >= 0x38 && opcode <= 0x44) {
+				return OperandType::Branch;
+			}
+			if ((opcode >= 0x6F && opcode <= 0x75) || (opcode >= 0x7B && opcode <= 0x81)) {
+				return OperandType::Int32;
+			}
+			if ((opcode >= 0xA6 && opcode <= 0xB2) || (opcode >= 0xBB && opcode <= 0xC1) || (opcode >= 0xC7 && opcode <= 0xCF)) {
+				return OperandType::Invalid;
+			}
+
+			switch (opcode) {
+			case 0x1F:
+				return OperandType::Int8;
+			case 0x20:
+			case 0x22:
+			case 0x27:
+			case 0x28:
+			case 0x29:
+			case 0x79:
+			case 0x8C:
+			case 0x8D:
+			case 0x8F:
+			case 0xA3:
+			case 0xA4:
+			case 0xA5:
+			case 0xC2:
+			case 0xC6:
+			case 0xD0:
+				return OperandType::Int32;
+			case 0x21:
+			case 0x23:
+				return OperandType::Int64;
+			case 0x45:
+				return OperandType::Switch;
+			case OPCODE_LEAVE:
+				return OperandType::Branch;
+			case OPCODE_LEAVE_S:
+				return OperandType::ShortBranch;
+			case 0x24:
+			case 0x77:
+			case 0x78:
+			case 0xC4:
+			case 0xC5:
+				return OperandType::Invalid;
+			default:
+				return opcode <= OPCODE_CONV_U ? OperandType::None : OperandType::Invalid;
+			}
+		}
+
+		OperandType getTwoByteOperandType(BYTE opcode) {
+			switch (opcode) {
+			case 0x06:
+			case 0x07:
+			case 0x15:
+			case 0x16:
+			case 0x1C:
+				return OperandType::Int32;
+			case 0x09:
+			case 0x0A:
+			case 0x0B:
+			case 0x0C:
+			case 0x0D:
+			case 0x0E:
+				return OperandType::Int16;
+			case 0x12:
+			case 0x19:
+				return OperandType::Int8;
+			case 0x08:
+			case 0x10:
+			case 0x1B:
+				return OperandType::Invalid;
+			default:
+				return opcode <= 0x1E ? OperandType::None : OperandType::Invalid;
+			}
+		}
+
+		/** Whether execution never falls through to the instruction following the given one. */
+		bool endsBasicBlock(USHORT opcode) {
+			switch (opcode) {
+			case OPCODE_JMP:
+			case OPCODE_RET:
+			case OPCODE_THROW:
+			case OPCODE_ENDFINALLY:
+			case OPCODE_ENDFILTER:
+			case OPCODE_RETHROW:
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		/** Whether the given two-byte opcode is a prefix that must stay attached to the following instruction. */
+		bool isPrefix(USHORT opcode) {
+			switch (opcode) {
+			case 0xFE12: // unaligned.
+			case 0xFE13: // volatile.
+			case OPCODE_TAIL:
+			case 0xFE16: // constrained.
+			case 0xFE19: // no.
+			case 0xFE1E: // readonly.
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		USHORT readUShort(const BYTE* data) {
+			return static_cast<USHORT>(data[0] | (data[1] << 8));
+		}
+
+		ULONG readULong(const BYTE* data) {
+			return static_cast<ULONG>(data[0]) | (static_cast<ULONG>(data[1]) << 8)
+				| (static_cast<ULONG>(data[2]) << 16) | (static_cast<ULONG>(data[3]) << 24);
+		}
+
+		void appendUShort(std::vector<BYTE>& out, USHORT value) {
+			out.push_back(static_cast<BYTE>(value));
+			out.push_back(static_cast<BYTE>(value >> 8));
+		}
+
+		void appendULong(std::vector<BYTE>& out, ULONG value) {
+			for (int i = 0; i < 4; i++) {
+				out.push_back(static_cast<BYTE>(value >> (8 * i)));
+			}
+		}
+	}
+
+	bool BasicBlockInstrumenter::parse(const BYTE* methodBody, ULONG methodBodySize) {
+		instructions.clear();
+		exceptionClauses.clear();
+		blockOffsets.clear();
+
+		ULONG headerSize = 0;
+		bool hasMoreSections = false;
+		if (!parseHeader(methodBody, methodBodySize, headerSize, hasMoreSections)) {
+			return false;
+		}
+		code = methodBody + headerSize;
+
+		if (hasMoreSections) {
+			// Extra sections start at the next 4-byte boundary after the code
+			ULONG sectionsStart = (headerSize + codeSize + 3) & ~3UL;
+			if (sectionsStart >= methodBodySize || !parseExceptionSections(methodBody + sectionsStart, methodBody + methodBodySize)) {
+				return false;
+			}
+		}
+
+		return parseInstructions() && markBlockStarts();
+	}
+
+	ULONG BasicBlockInstrumenter::getCodeSize(const BYTE* methodBody, ULONG methodBodySize) {
+		BasicBlockInstrumenter instrumenter;
+		ULONG headerSize = 0;
+		bool hasMoreSections = false;
+		if (!instrumenter.parseHeader(methodBody, methodBodySize, headerSize, hasMoreSections)) {
+			return 0;
+		}
+		return instrumenter.codeSize;
+	}
+
+	bool BasicBlockInstrumenter::parseHeader(const BYTE* methodBody, ULONG methodBodySize, ULONG& headerSize, bool& hasMoreSections) {
+		if (methodBody == nullptr || methodBodySize == 0) {
+			return false;
+		}
+
+		if ((methodBody[0] & 0x3) == TINY_FORMAT) {
+			headerSize = 1;
+			codeSize = methodBody[0] >> 2;
+			maxStack = 8;
+			localVarSigToken = 0;
+			initLocals = false;
+			hasMoreSections = false;
+		}
+		else if ((methodBody[0] & 0x3) == FAT_FORMAT) {
+			if (methodBodySize < FAT_HEADER_SIZE) {
+				return false;
+			}
+			USHORT flagsAndSize = readUShort(methodBody);
+			if ((flagsAndSize >> 12) != FAT_HEADER_SIZE_IN_DWORDS) {
+				return false;
+			}
+			headerSize = FAT_HEADER_SIZE;
+			maxStack = readUShort(methodBody + 2);
+			codeSize = readULong(methodBody + 4);
+			localVarSigToken = readULong(methodBody + 8);
+			initLocals = (flagsAndSize & FAT_FORMAT_INIT_LOCALS) != 0;
+			hasMoreSections = (flagsAndSize & FAT_FORMAT_MORE_SECTS) != 0;
+		}
+		else {
+			return false;
+		}
+
+		return codeSize > 0 && codeSize <= methodBodySize - headerSize;
+	}
+
+	bool BasicBlockInstrumenter::parseExceptionSections(const BYTE* sections, const BYTE* end) {
+		const BYTE* section = sections;
+		while (true) {
+			if (section + 4 > end) {
+				return false;
+			}
+			BYTE kind = section[0];
+			if ((kind & SECTION_EH_TABLE) == 0) {
+				// we only know how to preserve exception handling tables
+				return false;
+			}
+
+			bool isFat = (kind & SECTION_FAT_FORMAT) != 0;
+			ULONG dataSize = isFat ? (readULong(section) >> 8) : section[1];
+			ULONG clauseSize = isFat ? FAT_CLAUSE_SIZE : SMALL_CLAUSE_SIZE;
+			if (dataSize < 4 || section + dataSize > end) {
+				return false;
+			}
+
+			ULONG clauseCount = (dataSize - 4) / clauseSize;
+			const BYTE* clause = section + 4;
+			for (ULONG i = 0; i < clauseCount; i++, clause += clauseSize) {
+				ExceptionClause parsed;
+				if (isFat) {
+					parsed.flags = readULong(clause);
+					parsed.tryOffset = readULong(clause + 4);
+					parsed.tryLength = readULong(clause + 8);
+					parsed.handlerOffset = readULong(clause + 12);
+					parsed.handlerLength = readULong(clause + 16);
+					parsed.classTokenOrFilterOffset = readULong(clause + 20);
+				}
+				else {
+					parsed.flags = readUShort(clause);
+					parsed.tryOffset = readUShort(clause + 2);
+					parsed.tryLength = clause[4];
+					parsed.handlerOffset = readUShort(clause + 5);
+					parsed.handlerLength = clause[7];
+					parsed.classTokenOrFilterOffset = readULong(clause + 8);
+				}
+				exceptionClauses.push_back(parsed);
+			}
+
+			if ((kind & SECTION_MORE_SECTS) == 0) {
+				return true;
+			}
+			// The next section is again 4-byte aligned
+			section += (dataSize + 3) & ~3UL;
+		}
+	}
+
+	bool BasicBlockInstrumenter::parseInstructions() {
+		ULONG offset = 0;
+		while (offset < codeSize) {
+			Instruction instruction;
+			instruction.offset = offset;
+			instruction.isBlockStart = false;
+
+			OperandType operandType;
+			ULONG opcodeSize = 1;
+			if (code[offset] == 0xFE) {
+				if (offset + 1 >= codeSize) {
+					return false;
+				}
+				instruction.opcode = static_cast<USHORT>(0xFE00 | code[offset + 1]);
+				operandType = getTwoByteOperandType(code[offset + 1]);
+				opcodeSize = 2;
+			}
+			else {
+				instruction.opcode = code[offset];
+				operandType = getOneByteOperandType(code[offset]);
+			}
+
+			ULONG operandOffset = offset + opcodeSize;
+			switch (operandType) {
+			case OperandType::None:
+				instruction.operandSize = 0;
+				break;
+			case OperandType::Int8:
+			case OperandType::ShortBranch:
+				instruction.operandSize = 1;
+				break;
+			case OperandType::Int16:
+				instruction.operandSize = 2;
+				break;
+			case OperandType::Int32:
+			case OperandType::Branch:
+				instruction.operandSize = 4;
+				break;
+			case OperandType::Int64:
+				instruction.operandSize = 8;
+				break;
+			case OperandType::Switch:
+				if (operandOffset + 4 > codeSize) {
+					return false;
+				}
+				instruction.operandSize = 4 + 4 * readULong(code + operandOffset);
+				break;
+			default:
+				return false;
+			}
+
+			ULONG nextOffset = operandOffset + instruction.operandSize;
+			if (nextOffset > codeSize || nextOffset < operandOffset) {
+				return false;
+			}
+
+			// Branch targets are relative to the start of the next instruction
+			if (operandType == OperandType::ShortBranch) {
+				instruction.branchTargets.push_back(nextOffset + static_cast<signed char>(code[operandOffset]));
+			}
+			else if (operandType == OperandType::Branch) {
+				instruction.branchTargets.push_back(nextOffset + static_cast<LONG>(readULong(code + operandOffset)));
+			}
+			else if (operandType == OperandType::Switch) {
+				ULONG targetCount = readULong(code + operandOffset);
+				for (ULONG i = 0; i < targetCount; i++) {
+					instruction.branchTargets.push_back(nextOffset + static_cast<LONG>(readULong(code + operandOffset + 4 + 4 * i)));
+				}
+			}
+
+			instructions.push_back(instruction);
+			offset = nextOffset;
+		}
+		return true;
+	}
+
+	bool BasicBlockInstrumenter::markBlockStarts() {
+		bool isValid = true;
+		markBlockStartAt(0, isValid);
+
+		for (size_t i = 0; i < instructions.size(); i++) {
+			const Instruction& instruction = instructions[i];
+			for (ULONG target : instruction.branchTargets) {
+				markBlockStartAt(target, isValid);
+			}
+
+			bool isBranch = !instruction.branchTargets.empty() || instruction.opcode == 0x45;
+			if ((isBranch || endsBasicBlock(instruction.opcode)) && i + 1 < instructions.size()) {
+				instructions[i + 1].isBlockStart = true;
+			}
+		}
+
+		for (const ExceptionClause& clause : exceptionClauses) {
+			markBlockStartAt(clause.tryOffset, isValid);
+			markBlockStartAt(clause.tryOffset + clause.tryLength, isValid);
+			markBlockStartAt(clause.handlerOffset, isValid);
+			markBlockStartAt(clause.handlerOffset + clause.handlerLength, isValid);
+			if (clause.flags & CLAUSE_FILTER) {
+				markBlockStartAt(clause.classTokenOrFilterOffset, isValid);
+			}
+		}
+
+		for (size_t i = 1; i < instructions.size(); i++) {
+			// A probe must neither separate a prefix from its instruction nor a tail call from its ret
+			bool followsPrefix = isPrefix(instructions[i - 1].opcode);
+			bool followsTailCall = i >= 2 && instructions[i - 2].opcode == OPCODE_TAIL;
+			if (instructions[i].isBlockStart && (followsPrefix || followsTailCall)) {
+				return false;
+			}
+		}
+
+		for (const Instruction& instruction : instructions) {
+			if (instruction.isBlockStart) {
+				blockOffsets.push_back(instruction.offset);
+			}
+		}
+		return isValid;
+	}
+
+	void BasicBlockInstrumenter::markBlockStartAt(ULONG offset, bool& isValidTarget) {
+		if (offset == codeSize) {
+			// The end of the last block, e.g. the end of a handler at the end of the method
+			return;
+		}
+
+		size_t low = 0;
+		size_t high = instructions.size();
+		while (low < high) {
+			size_t middle = (low + high) / 2;
+			if (instructions[middle].offset < offset) {
+				low = middle + 1;
+			}
+			else {
+				high = middle;
+			}
+		}
+
+		if (low == instructions.size() || instructions[low].offset != offset) {
+			// Targets in the middle of an instruction or outside the code are invalid IL
+			isValidTarget = false;
+			return;
+		}
+		instructions[low].isBlockStart = true;
+	}
+
+	ULONG BasicBlockInstrumenter::getNewSize(const Instruction& instruction) const {
+		ULONG opcodeSize = instruction.opcode > 0xFF ? 2 : 1;
+		ULONG operandSize = instruction.operandSize;
+		bool isShortBranch = (instruction.opcode >= OPCODE_SHORT_BRANCH_FIRST && instruction.opcode <= OPCODE_SHORT_BRANCH_LAST)
+			|| instruction.opcode == OPCODE_LEAVE_S;
+		if (isShortBranch) {
+			// Short branches are widened as the probes may push their targets out of range
+			operandSize = 4;
+		}
+		return (instruction.isBlockStart ? PROBE_SIZE : 0) + opcodeSize + operandSize;
+	}
+
+	std::vector<BYTE> BasicBlockInstrumenter::instrument(volatile BYTE* hitFlags) const {
+		// Maps original offsets of all instructions (and the end of the code) to new offsets.
+		// For block starts, the new offset points to the probe so that branches execute it.
+		std::vector<ULONG> newOffsets(instructions.size() + 1);
+		ULONG newCodeSize = 0;
+		for (size_t i = 0; i < instructions.size(); i++) {
+			newOffsets[i] = newCodeSize;
+			newCodeSize += getNewSize(instructions[i]);
+		}
+		newOffsets[instructions.size()] = newCodeSize;
+
+		auto mapOffset = [&](ULONG originalOffset) -> ULONG {
+			if (originalOffset >= codeSize) {
+				return newCodeSize;
+			}
+			size_t low = 0;
+			size_t high = instructions.size();
+			while (low < high) {
+				size_t middle = (low + high) / 2;
+				if (instructions[middle].offset < originalOffset) {
+					low = middle + 1;
+				}
+				else {
+					high = middle;
+				}
+			}
+			return newOffsets[low];
+		};
+
+		std::vector<BYTE> body;
+		body.reserve(FAT_HEADER_SIZE + newCodeSize + 4 + exceptionClauses.size() * FAT_CLAUSE_SIZE + 4);
+
+		USHORT flags = FAT_FORMAT | (FAT_HEADER_SIZE_IN_DWORDS << 12);
+		if (initLocals) {
+			flags |= FAT_FORMAT_INIT_LOCALS;
+		}
+		if (!exceptionClauses.empty()) {
+			flags |= FAT_FORMAT_MORE_SECTS;
+		}
+		appendUShort(body, flags);
+		ULONG newMaxStack = static_cast<ULONG>(maxStack) + PROBE_STACK_SIZE;
+		appendUShort(body, static_cast<USHORT>(newMaxStack > 0xFFFF ? 0xFFFF : newMaxStack));
+		appendULong(body, newCodeSize);
+		appendULong(body, localVarSigToken);
+
+		size_t blockIndex = 0;
+		for (size_t i = 0; i < instructions.size(); i++) {
+			const Instruction& instruction = instructions[i];
+			if (instruction.isBlockStart) {
+				UINT_PTR address = reinterpret_cast<UINT_PTR>(hitFlags + blockIndex);
+				blockIndex++;
+				body.push_back(sizeof(void*) == 8 ? OPCODE_LDC_I8 : OPCODE_LDC_I4);
+				for (size_t byteIndex = 0; byteIndex < sizeof(void*); byteIndex++) {
+					body.push_back(static_cast<BYTE>(static_cast<unsigned long long>(address) >> (8 * byteIndex)));
+				}
+				body.push_back(OPCODE_CONV_U);
+				body.push_back(OPCODE_LDC_I4_1);
+				body.push_back(OPCODE_STIND_I1);
+			}
+
+			ULONG nextNewOffset = newOffsets[i + 1];
+			const BYTE* originalOperand = code + instruction.offset + (instruction.opcode > 0xFF ? 2 : 1);
+			if (instruction.opcode > 0xFF) {
+				body.push_back(0xFE);
+				body.push_back(static_cast<BYTE>(instruction.opcode));
+			}
+			else if (instruction.opcode >= OPCODE_SHORT_BRANCH_FIRST && instruction.opcode <= OPCODE_SHORT_BRANCH_LAST) {
+				body.push_back(static_cast<BYTE>(instruction.opcode + SHORT_TO_LONG_BRANCH_DELTA));
+			}
+			else if (instruction.opcode == OPCODE_LEAVE_S) {
+				body.push_back(static_cast<BYTE>(OPCODE_LEAVE));
+			}
+			else {
+				body.push_back(static_cast<BYTE>(instruction.opcode));
+			}
+
+			if (instruction.opcode == 0x45) {
+				appendULong(body, static_cast<ULONG>(instruction.branchTargets.size()));
+				for (ULONG target : instruction.branchTargets) {
+					appendULong(body, static_cast<ULONG>(mapOffset(target) - nextNewOffset));
+				}
+			}
+			else if (!instruction.branchTargets.empty()) {
+				appendULong(body, static_cast<ULONG>(mapOffset(instruction.branchTargets[0]) - nextNewOffset));
+			}
+			else {
+				body.insert(body.end(), originalOperand, originalOperand + instruction.operandSize);
+			}
+		}
+
+		if (!exceptionClauses.empty()) {
+			while (body.size() % 4 != 0) {
+				body.push_back(0);
+			}
+			ULONG dataSize = 4 + static_cast<ULONG>(exceptionClauses.size()) * FAT_CLAUSE_SIZE;
+			appendULong(body, (dataSize << 8) | SECTION_EH_TABLE | SECTION_FAT_FORMAT);
+			for (const ExceptionClause& clause : exceptionClauses) {
+				ULONG tryStart = mapOffset(clause.tryOffset);
+				ULONG handlerStart = mapOffset(clause.handlerOffset);
+				appendULong(body, clause.flags);
+				appendULong(body, tryStart);
+				appendULong(body, mapOffset(clause.tryOffset + clause.tryLength) - tryStart);
+				appendULong(body, handlerStart);
+				appendULong(body, mapOffset(clause.handlerOffset + clause.handlerLength) - handlerStart);
+				if (clause.flags & CLAUSE_FILTER) {
+					appendULong(body, mapOffset(clause.classTokenOrFilterOffset));
+				}
+				else {
+					appendULong(body, clause.classTokenOrFilterOffset);
+				}
+			}
+		}
+
+		return body;
+	}
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <cor.h>
+#include <vector>
+#include "utils/Testing.h"
+
+namespace Profiler {
+	/**
+	 * Rewrites the IL body of a single method so that every basic block sets a flag in a
+	 * preallocated hit array when it is entered. The probes are plain stores of a constant
+	 * to a fixed address, i.e. they are lock-free, never allocate and never call back into
+	 * the profiler.
+	 *
+	 * Usage: call parse() with the original method body, allocate one byte per entry of
+	 * getBlockOffsets() and pass that memory to instrument(). The memory must stay valid for
+	 * the lifetime of the process as the JIT bakes its address into the generated code.
+	 */
+	class BasicBlockInstrumenter
+	{
+	public:
+		/**
+		 * Parses the given method body (header, IL code and exception handling sections) and
+		 * determines its basic blocks. Returns false if the body is malformed or uses constructs
+		 * we cannot safely instrument. In that case, the method must be left untouched.
+		 * The method body must stay valid until instrument() has been called.
+		 */
+		bool EXPOSE_TO_CPP_TESTS parse(const BYTE* methodBody, ULONG methodBodySize);
+
+		/**
+		 * Returns the size of the IL code of the given method body without header and exception handling
+		 * sections, or 0 if the header is malformed. Cheaper than parse() as it only reads the header.
+		 */
+		static ULONG EXPOSE_TO_CPP_TESTS getCodeSize(const BYTE* methodBody, ULONG methodBodySize);
+
+		/** The original IL offsets of all basic blocks found by parse(). Block i sets hitFlags[i]. */
+		const std::vector<ULONG>& getBlockOffsets() const {
+			return blockOffsets;
+		}
+
+		/**
+		 * Returns the instrumented method body including a fat header and the remapped exception
+		 * handling clauses. Must only be called after parse() returned true.
+		 */
+		std::vector<BYTE> EXPOSE_TO_CPP_TESTS instrument(volatile BYTE* hitFlags) const;
+
+	private:
+		/** A single decoded IL instruction. */
+		struct Instruction {
+			/** Offset of the instruction in the original IL code. */
+			ULONG offset;
+
+			/** The opcode. Two-byte opcodes are stored as 0xFE00 | second byte. */
+			USHORT opcode;
+
+			/** Size of the inline operand in the original IL code. */
+			ULONG operandSize;
+
+			/** Absolute original target offsets of branches and switches. */
+			std::vector<ULONG> branchTargets;
+
+			/** Whether a probe must be inserted before this instruction. */
+			bool isBlockStart;
+		};
+
+		/** A single exception handling clause, always stored in fat format. */
+		struct ExceptionClause {
+			ULONG flags;
+			ULONG tryOffset;
+			ULONG tryLength;
+			ULONG handlerOffset;
+			ULONG handlerLength;
+			/** Either the class token or the filter offset, depending on the flags. */
+			ULONG classTokenOrFilterOffset;
+		};
+
+		const BYTE* code = nullptr;
+		ULONG codeSize = 0;
+		USHORT maxStack = 0;
+		mdToken localVarSigToken = 0;
+		bool initLocals = false;
+		std::vector<Instruction> instructions;
+		std::vector<ExceptionClause> exceptionClauses;
+		std::vector<ULONG> blockOffsets;
+
+		bool parseHeader(const BYTE* methodBody, ULONG methodBodySize, ULONG& headerSize, bool& hasMoreSections);
+		bool parseInstructions();
+		bool parseExceptionSections(const BYTE* sections, const BYTE* end);
+		bool markBlockStarts();
+		void markBlockStartAt(ULONG offset, bool& isValidTarget);
+		ULONG getNewSize(const Instruction& instruction) const;
+	};
+}
@@ -0,0 +1,67 @@
+#include "BlockCoverage.h"
+
+namespace Profiler {
+	BlockCoverage::BlockCoverage() {
+	}
+
+	BlockCoverage::~BlockCoverage() {
+	}
+
+	bool BlockCoverage::isRegistered(int assemblyNumber, mdToken functionToken) {
+		synchronization.enter();
+		auto assembly = assemblies.find(assemblyNumber);
+		bool registered = assembly != assemblies.end() && assembly->second.methods.count(functionToken) > 0;
+		synchronization.leave();
+		return registered;
+	}
+
+	BYTE* BlockCoverage::registerMethod(int assemblyNumber, mdToken functionToken, const std::vector<ULONG>& blockOffsets) {
+		synchronization.enter();
+		AssemblyBlocks& assembly = assemblies[assemblyNumber];
+		BYTE* hitFlags = nullptr;
+		if (assembly.methods.count(functionToken) == 0) {
+			hitFlags = allocateHitFlags(assembly, blockOffsets.size());
+			assembly.methods[functionToken] = { functionToken, hitFlags, blockOffsets };
+		}
+		synchronization.leave();
+		return hitFlags;
+	}
+
+	BYTE* BlockCoverage::allocateHitFlags(AssemblyBlocks& assembly, size_t count) {
+		// Must be called from synchronized context
+		if (count > CHUNK_SIZE) {
+			assembly.chunks.emplace_back(new BYTE[count]{});
+			return assembly.chunks.back().get();
+		}
+
+		if (assembly.usedBytesInCurrentChunk + count > CHUNK_SIZE) {
+			// The previous chunk stays alive but is not used for new methods anymore
+			assembly.chunks.emplace_back(new BYTE[CHUNK_SIZE]{});
+			assembly.currentChunk = assembly.chunks.back().get();
+			assembly.usedBytesInCurrentChunk = 0;
+		}
+
+		BYTE* hitFlags = assembly.currentChunk + assembly.usedBytesInCurrentChunk;
+		assembly.usedBytesInCurrentChunk += count;
+		return hitFlags;
+	}
+
+	void BlockCoverage::collectCoveredBlocks(std::vector<BlockInfo>& coveredBlocks) {
+		synchronization.enter();
+		for (auto& assembly : assemblies) {
+			for (auto& entry : assembly.second.methods) {
+				InstrumentedMethod& method = entry.second;
+				for (size_t i = 0; i < method.blockOffsets.size(); i++) {
+					// A plain store suffices, as the probes only ever store 1. A hit between the read and the reset is
+					// reported with this collection and a later hit sets the flag again, so no hit is lost.
+					volatile BYTE& hitFlag = method.hitFlags[i];
+					if (hitFlag != 0) {
+						hitFlag = 0;
+						coveredBlocks.push_back({ assembly.first, method.functionToken, method.blockOffsets[i] });
+					}
+				}
+			}
+		}
+		synchronization.leave();
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "FunctionInfo.h"
+#include "utils/Lock.h"
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace Profiler {
+	/**
+	 * Owns the hit flags of all methods instrumented with basic block probes, grouped per assembly.
+	 * Each block gets one byte so that a probe is a single plain store without any read-modify-write.
+	 * The flags are allocated in chunks that are never moved or freed while the profiler is loaded,
+	 * as their addresses are compiled into the instrumented code.
+	 *
+	 * All methods in this class are thread-safe. The probes themselves do not synchronize at all.
+	 */
+	class BlockCoverage
+	{
+	public:
+		BlockCoverage();
+		virtual ~BlockCoverage() noexcept;
+
+		/** Whether the given method has already been instrumented, e.g. for another generic instantiation. */
+		bool isRegistered(int assemblyNumber, mdToken functionToken);
+
+		/**
+		 * Allocates zeroed hit flags for the given blocks of a method and remembers their IL offsets.
+		 * Returns nullptr if the method has already been registered concurrently by another thread.
+		 */
+		BYTE* registerMethod(int assemblyNumber, mdToken functionToken, const std::vector<ULONG>& blockOffsets);
+
+		/** Appends all blocks that were executed since the last call to the given list and resets their hit flags. */
+		void collectCoveredBlocks(std::vector<BlockInfo>& coveredBlocks);
+
+	private:
+		/** Size of a single allocation of hit flags. Methods with more blocks get their own chunk. */
+		static const size_t CHUNK_SIZE = 64 * 1024;
+
+		/** The blocks of a single instrumented method. */
+		struct InstrumentedMethod {
+			mdToken functionToken;
+			BYTE* hitFlags;
+			std::vector<ULONG> blockOffsets;
+		};
+
+		/** The hit flags and instrumented methods of a single assembly. */
+		struct AssemblyBlocks {
+			std::vector<std::unique_ptr<BYTE[]>> chunks;
+			BYTE* currentChunk = nullptr;
+			size_t usedBytesInCurrentChunk = CHUNK_SIZE;
+			std::map<mdToken, InstrumentedMethod> methods;
+		};
+
+		Lock synchronization;
+		std::map<int, AssemblyBlocks> assemblies;
+
+		BYTE* allocateHitFlags(AssemblyBlocks& assembly, size_t count);
+	};
+}
@@ -8,16 +8,14 @@
 namespace Profiler {
 	FileLogBase::FileLogBase()
 	{
-		InitializeCriticalSection(&criticalSection);
 	}
 
 
 	FileLogBase::~FileLogBase()
 	{
-		DeleteCriticalSection(&criticalSection);
 	}
 
-	void FileLogBase::createLogFile(std::string directory, std::string name) {
+	void FileLogBase::createLogFile(std::string directory, std::string name, const std::string& firstLines) {
 		const std::string fallbackDirectory = "c:\\users\\public\\";
 		if (directory.empty()) {
 			// c:\users\public is usually writable for everyone
@@ -37,24 +35,46 @@ namespace Profiler {
 
 		std::string logFilePath = directory + "\\" + name;
 
-		logFile = std::wofstream(logFilePath);
+		std::wofstream file(logFilePath);
+		criticalSection.enter();
+		logFile = std::move(file);
+		isCreated = true;
+		filePath = logFilePath;
+		if (logFile.is_open()) {
+			logFile << converter.from_bytes(firstLines) << bufferedWrites;
+		}
+		bufferedWrites.clear();
+		criticalSection.leave();
+	}
+
+	std::string FileLogBase::getFilePath()
+	{
+		criticalSection.enter();
+		std::string path = filePath;
+		criticalSection.leave();
+		return path;
 	}
 
 	void FileLogBase::shutdown()
 	{
-		EnterCriticalSection(&criticalSection);
+		criticalSection.enter();
 		if (logFile.is_open()) {
 			logFile.close();
 		}
-		LeaveCriticalSection(&criticalSection);
+		isCreated = true;
+		bufferedWrites.clear();
+		criticalSection.leave();
 	}
 
 	void FileLogBase::writeWideToFile(const std::wstring& string) {
+		criticalSection.enter();
 		if (logFile.is_open()) {
-			EnterCriticalSection(&criticalSection);
 			logFile << string;
-			LeaveCriticalSection(&criticalSection);
 		}
+		else if (!isCreated) {
+			bufferedWrites += string;
+		}
+		criticalSection.leave();
 	}
 
 	void FileLogBase::writeWideTupleToFile(const std::wstring& key, const std::wstring& value) {
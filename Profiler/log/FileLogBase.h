@@ -5,6 +5,7 @@
 #include <fstream>
 #include <locale>
 #include <codecvt>
+#include "utils/Lock.h"
 
 namespace Profiler {
 	/**
@@ -20,22 +21,33 @@ namespace Profiler {
 		/** Closes the log. Further calls to logging methods will be ignored. */
 		void shutdown();
 
-		
+		/** Returns the path of the log file or the empty string if it has not been created yet. */
+		std::string getFilePath();
+
 
 	protected:
 		/** File into which results are written. INVALID_HANDLE if the file has not been opened yet. */
 		std::wofstream logFile;
 
-		/** Synchronizes access to the log file. */
-		CRITICAL_SECTION criticalSection;
+		/** Synchronizes access to the log file and the buffered writes. */
+		Lock criticalSection;
+
+		/** Everything written before the log file was created. */
+		std::wstring bufferedWrites;
+
+		/** Whether createLogFile has been called, i.e. writes are no longer buffered. */
+		bool isCreated = false;
+
+		/** Path of the log file once it has been created. */
+		std::string filePath;
 
 		std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
 
 		/**
-		 * Create the log file. Must be the first method called on this object.
-		 * This method is not thread-safe or reentrant.
+		 * Create the log file and write the given first lines to it, followed by everything that has been written before.
+		 * This method is not reentrant, but other threads may write to the log concurrently.
 		 */
-		void createLogFile(std::string directory, std::string name);
+		void createLogFile(std::string directory, std::string name, const std::string& firstLines = "");
 
 		/** Writes the given string to the log file. */
 		void writeToFile(const std::string& string);
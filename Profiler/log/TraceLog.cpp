@@ -25,25 +25,54 @@ namespace Profiler {
 		writeFunctionInfosToLog(LOG_KEY_CALLED, functions);
 	}
 
+	void TraceLog::writeExcludedFunctionInfosToLog(const std::vector<FunctionInfo>& functions)
+	{
+		writeFunctionInfosToLog(LOG_KEY_EXCLUDED, functions);
+	}
+
+	void TraceLog::writeCalledFunctionCountsToLog(const std::vector<FunctionCallCount>& functions)
+	{
+		std::stringstream stream;
+		appendFunctionCallCounts(stream, functions);
+		writeToFile(stream.str());
+	}
+
+	void TraceLog::writeBlockInfosToLog(const std::vector<BlockInfo>& blocks)
+	{
+		std::stringstream stream;
+		for (const BlockInfo& block : blocks) {
+			stream << LOG_KEY_BLOCK << '=' << block.assemblyNumber << ':' << block.functionToken << ':' << block.ilOffset << "\n";
+		}
+		writeToFile(stream.str());
+	}
+
 	void TraceLog::createLogFile(const std::string& targetDir) {
 		std::string timeStamp = getFormattedCurrentTime();
 
 		std::string fileName = "";
 		fileName = fileName + "coverage_" + timeStamp + ".txt";
 
-		FileLogBase::createLogFile(targetDir, fileName);
-
-		writeTupleToFile(LOG_KEY_INFO, VERSION_DESCRIPTION);
-		writeTupleToFile(LOG_KEY_STARTED, timeStamp);
+		std::string firstLines = LOG_KEY_INFO + "=" + VERSION_DESCRIPTION + "\n" + LOG_KEY_STARTED + "=" + timeStamp + "\n";
+		FileLogBase::createLogFile(targetDir, fileName, firstLines);
 	}
 
 	void TraceLog::writeFunctionInfosToLog(const std::string& key, const std::vector<FunctionInfo>& functions) {
 		std::stringstream stream;
+		appendFunctionInfos(stream, key, functions);
+		writeToFile(stream.str());
+	}
+
+	void TraceLog::appendFunctionInfos(std::stringstream& stream, const std::string& key, const std::vector<FunctionInfo>& functions) {
 		const std::string endLine = "\n";
 		for (const FunctionInfo& function : functions) {
 			stream << key << '=' << function.assemblyNumber << ':' << function.functionToken << endLine;
 		}
-		writeToFile(stream.str());
+	}
+
+	void TraceLog::appendFunctionCallCounts(std::stringstream& stream, const std::vector<FunctionCallCount>& functions) {
+		for (const FunctionCallCount& function : functions) {
+			stream << LOG_KEY_CALLED << '=' << function.function.assemblyNumber << ':' << function.function.functionToken << ':' << function.count << "\n";
+		}
 	}
 
 	void TraceLog::info(const std::string& message) {
@@ -96,6 +125,30 @@ namespace Profiler {
 		writeTupleToFile(LOG_KEY_TESTCASE, testEndLine);
 	}
 
+	std::string TraceLog::getTestCaseTime()
+	{
+		return getFormattedCurrentTime();
+	}
+
+	void TraceLog::writeContextTestCase(const std::string& startTime, const std::string& testName, const std::vector<FunctionInfo>& calledFunctions,
+		const std::vector<FunctionCallCount>& calledFunctionCounts, const std::string& result, const std::string& duration)
+	{
+		// Lines will look like those of other test cases, but with a different key:
+		// ContextTest=Start:{Start Date}:{Testname}
+		// Called=...
+		// ContextTest=End:{End Date}:{Result}:{Duration}
+		std::stringstream stream;
+		stream << LOG_KEY_CONTEXT_TESTCASE << "=Start:" << startTime << ':' << testName << "\n";
+		appendFunctionInfos(stream, LOG_KEY_CALLED, calledFunctions);
+		appendFunctionCallCounts(stream, calledFunctionCounts);
+		stream << LOG_KEY_CONTEXT_TESTCASE << "=End:" << getFormattedCurrentTime();
+		if (!result.empty()) {
+			stream << ':' << result << ':' << duration;
+		}
+		stream << "\n";
+		writeToFile(stream.str());
+	}
+
 	void TraceLog::shutdown() {
 		std::string timeStamp = getFormattedCurrentTime();
 		writeTupleToFile(LOG_KEY_STOPPED, timeStamp);
@@ -6,6 +6,7 @@
 #include <vector>
 #include <map>
 #include <set>
+#include <sstream>
 
 
 namespace Profiler {
@@ -27,6 +28,15 @@ namespace Profiler {
 		/** Write all information about the given called functions to the log. */
 		void writeCalledFunctionInfosToLog(const std::vector<FunctionInfo>& functions);
 
+		/** Write all information about the given called functions and their number of calls to the log. */
+		void writeCalledFunctionCountsToLog(const std::vector<FunctionCallCount>& functions);
+
+		/** Write all information about the given functions that were excluded from hooking to the log. */
+		void writeExcludedFunctionInfosToLog(const std::vector<FunctionInfo>& functions);
+
+		/** Write all information about the given executed basic blocks to the log. */
+		void writeBlockInfosToLog(const std::vector<BlockInfo>& blocks);
+
 		/**
 		 * Create the log file and add general information.
 		 * Can be called as an alternative for createLogFile method of the base class as first method called on the object.
@@ -59,6 +69,16 @@ namespace Profiler {
 
 		void endTestCase(const std::string& result = "", const std::string& duration = "");
 
+		/** Returns the current time in the format used for the start and end of test cases. */
+		std::string getTestCaseTime();
+
+		/**
+		 * Writes a test case that ran concurrently with others in a test context as one block, so that its lines cannot interleave
+		 * with those of other test cases. The called functions are given either with or without call counts.
+		 */
+		void writeContextTestCase(const std::string& startTime, const std::string& testName, const std::vector<FunctionInfo>& calledFunctions,
+			const std::vector<FunctionCallCount>& calledFunctionCounts, const std::string& result, const std::string& duration);
+
 	protected:
 		/** The key to log information about the profiler startup. */
 		const std::string LOG_KEY_STARTED = "Started";
@@ -75,9 +95,18 @@ namespace Profiler {
 		/** The key to log information about called methods. */
 		const std::string LOG_KEY_CALLED = "Called";
 
+		/** The key to log information about methods excluded from hooking. */
+		const std::string LOG_KEY_EXCLUDED = "Excluded";
+
+		/** The key to log information about executed basic blocks. */
+		const std::string LOG_KEY_BLOCK = "Block";
+
 		/** The key to log information about test cases. */
 		const std::string LOG_KEY_TESTCASE = "Test";
 
+		/** The key to log information about test cases that ran in a test context. */
+		const std::string LOG_KEY_CONTEXT_TESTCASE = "ContextTest";
+
 		/** The key to log information useful when interpreting the traces. */
 		const std::string LOG_KEY_INFO = "Info";
 
@@ -99,5 +128,11 @@ namespace Profiler {
 	private:
 		/** Write all information about the given functions to the log. */
 		void writeFunctionInfosToLog(const std::string& key, const std::vector<FunctionInfo>& functions);
+
+		/** Appends a line for each of the given functions to the stream. */
+		void appendFunctionInfos(std::stringstream& stream, const std::string& key, const std::vector<FunctionInfo>& functions);
+
+		/** Appends a called line with the number of calls for each of the given functions to the stream. */
+		void appendFunctionCallCounts(std::stringstream& stream, const std::vector<FunctionCallCount>& functions);
 	};
 }
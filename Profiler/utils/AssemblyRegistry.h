@@ -0,0 +1,244 @@
+#pragma once
+#include <corprof.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include "utils/Lock.h"
+
+namespace Profiler {
+	/// <summary>
+	/// Assigns dense numbers to loaded assemblies and caches what we know about their manifest modules.
+	/// All lookups are lock-free, so resolving functions never waits for assembly loads on other threads.
+	/// Only registrations are serialized among each other. Nothing is ever removed.
+	/// </summary>
+	class AssemblyRegistry final
+	{
+	public:
+		/// <summary>
+		/// Everything we know about a registered assembly.
+		/// </summary>
+		struct Assembly {
+			AssemblyID assemblyId = 0;
+
+			/// <summary>
+			/// 0 until the module info has been registered.
+			/// </summary>
+			ModuleID manifestModuleId = 0;
+
+			std::wstring name;
+
+			/// <summary>
+			/// Whether the assembly matches the configured assembly patterns.
+			/// </summary>
+			bool isInteresting = true;
+		};
+
+	private:
+		/// <summary>
+		/// Open addressing map from AssemblyIDs or ModuleIDs to assembly numbers. Readers are lock-free,
+		/// writers must be serialized. A number is always stored before its key is released, so readers that acquire a key
+		/// also see its number. Replaced tables are kept alive, as lock-free readers may still be using them.
+		/// </summary>
+		class IdMap {
+		private:
+			struct Slot {
+				std::atomic<UINT_PTR> id;
+				std::atomic<int> number;
+			};
+
+			struct Table {
+				unsigned int moduloMask;
+				std::unique_ptr<Slot[]> slots;
+
+				explicit Table(unsigned int size) : moduloMask(size - 1), slots(new Slot[size]{}) {}
+			};
+
+			std::vector<std::unique_ptr<Table>> tables;
+			std::atomic<Table*> currentTable;
+			unsigned int numElements = 0;
+
+			/// <summary>
+			/// Same hash as in the FunctionIdSet, see there. IDs are aligned pointers, so their lowest bits cannot be used directly.
+			/// </summary>
+			static inline unsigned int hash(UINT_PTR id) {
+#if UINTPTR_MAX > 0xFFFFFFFF
+				id ^= id >> 30;
+				id *= 0xbf58476d1ce4e5b9;
+				id ^= id >> 27;
+				id *= 0x94d049bb133111eb;
+				id ^= id >> 31;
+#else
+				id ^= id >> 16;
+				id *= 0x21f0aaadU;
+				id ^= id >> 15;
+				id *= 0x735a2d97U;
+				id ^= id >> 15;
+#endif
+				return static_cast<unsigned int>(id);
+			}
+
+			static void insertInto(Table* table, UINT_PTR id, int number) {
+				unsigned int position = hash(id) & table->moduloMask;
+				while (table->slots[position].id.load(std::memory_order_relaxed) != 0
+					&& table->slots[position].id.load(std::memory_order_relaxed) != id) {
+					position = (position + 1) & table->moduloMask;
+				}
+				table->slots[position].number.store(number, std::memory_order_relaxed);
+				table->slots[position].id.store(id, std::memory_order_release);
+			}
+
+		public:
+			IdMap() {
+				tables.push_back(std::make_unique<Table>(1024));
+				currentTable = tables.back().get();
+			}
+
+			/// <summary>
+			/// Returns the number stored for the given ID or 0 if there is none. Lock-free.
+			/// </summary>
+			int find(UINT_PTR id) {
+				Table* table = currentTable.load(std::memory_order_acquire);
+				unsigned int position = hash(id) & table->moduloMask;
+				UINT_PTR current;
+				while ((current = table->slots[position].id.load(std::memory_order_acquire)) != 0) {
+					if (current == id) {
+						return table->slots[position].number.load(std::memory_order_relaxed);
+					}
+					position = (position + 1) & table->moduloMask;
+				}
+				return 0;
+			}
+
+			/// <summary>
+			/// Stores the number for the given ID. Must be called from synchronized context.
+			/// </summary>
+			void insert(UINT_PTR id, int number) {
+				Table* table = currentTable.load(std::memory_order_relaxed);
+				if (numElements + 1 > (table->moduloMask + 1) / 2) {
+					std::unique_ptr<Table> newTable = std::make_unique<Table>((table->moduloMask + 1) * 2);
+					for (unsigned int i = 0; i <= table->moduloMask; i++) {
+						UINT_PTR existingId = table->slots[i].id.load(std::memory_order_relaxed);
+						if (existingId != 0) {
+							insertInto(newTable.get(), existingId, table->slots[i].number.load(std::memory_order_relaxed));
+						}
+					}
+					table = newTable.get();
+					tables.push_back(std::move(newTable));
+					currentTable.store(table, std::memory_order_release);
+				}
+				insertInto(table, id, number);
+				numElements++;
+			}
+		};
+
+		/// <summary>
+		/// Assemblies are stored in chunks that are never moved, so that readers can access them without locking.
+		/// </summary>
+		const static int CHUNK_SIZE = 256;
+		const static int MAX_CHUNKS = 4096;
+
+		std::unique_ptr<Assembly[]> chunks[MAX_CHUNKS];
+
+		/// <summary>
+		/// The number that the next registered assembly gets. Numbering starts at 1.
+		/// </summary>
+		std::atomic<int> nextNumber{1};
+
+		IdMap assemblyNumbers;
+		IdMap moduleNumbers;
+
+		/// <summary>
+		/// Serializes registrations.
+		/// </summary>
+		ReadWriteLock writeLock;
+
+		Assembly* getOrCreate(int number) {
+			if (number <= 0 || number >= CHUNK_SIZE * MAX_CHUNKS) {
+				return nullptr;
+			}
+			std::unique_ptr<Assembly[]>& chunk = chunks[number / CHUNK_SIZE];
+			if (chunk == nullptr) {
+				chunk.reset(new Assembly[CHUNK_SIZE]);
+			}
+			return &chunk[number % CHUNK_SIZE];
+		}
+
+	public:
+		AssemblyRegistry() = default;
+
+		AssemblyRegistry(const AssemblyRegistry&) = delete;
+		AssemblyRegistry& operator=(const AssemblyRegistry&) = delete;
+
+		/// <summary>
+		/// Assigns the next number to the given assembly and returns it. Numbers are assigned in the order of
+		/// the calls, so the first registered assembly, i.e. the core library, always gets number 1.
+		/// </summary>
+		int registerAssembly(AssemblyID assemblyId) {
+			writeLock.enter();
+			int number = nextNumber.load(std::memory_order_relaxed);
+			Assembly* assembly = getOrCreate(number);
+			if (assembly != nullptr) {
+				assembly->assemblyId = assemblyId;
+			}
+			assemblyNumbers.insert(assemblyId, number);
+			// Released last, so that readers that see the number also see the assembly's chunk
+			nextNumber.store(number + 1, std::memory_order_release);
+			writeLock.leave();
+			return number;
+		}
+
+		/// <summary>
+		/// Stores the manifest module and name of the assembly with the given number. Afterwards, functions of
+		/// the module can be resolved to the assembly without asking the CLR for the AssemblyID.
+		/// </summary>
+		void registerModule(int number, ModuleID manifestModuleId, const std::wstring& name, bool isInteresting) {
+			writeLock.enter();
+			Assembly* assembly = getOrCreate(number);
+			if (assembly != nullptr) {
+				assembly->manifestModuleId = manifestModuleId;
+				assembly->name = name;
+				assembly->isInteresting = isInteresting;
+			}
+			// Published last, so that readers that find the module also see the attributes
+			moduleNumbers.insert(manifestModuleId, number);
+			writeLock.leave();
+		}
+
+		/// <summary>
+		/// Returns the number of the given assembly or 0 if it has not been registered. Lock-free.
+		/// </summary>
+		int getAssemblyNumber(AssemblyID assemblyId) {
+			return assemblyNumbers.find(assemblyId);
+		}
+
+		/// <summary>
+		/// Returns the number of the assembly with the given manifest module or 0 if the module has not been registered. Lock-free.
+		/// </summary>
+		int getAssemblyNumberOfModule(ModuleID moduleId) {
+			return moduleNumbers.find(moduleId);
+		}
+
+		/// <summary>
+		/// Returns the assembly with the given number or nullptr if there is none. Lock-free.
+		/// The module attributes may only be read once registerModule has returned for the assembly, which is
+		/// always the case for assemblies that were found via getAssemblyNumberOfModule.
+		/// </summary>
+		const Assembly* getAssembly(int number) {
+			if (number <= 0 || number >= nextNumber.load(std::memory_order_acquire) || number >= CHUNK_SIZE * MAX_CHUNKS) {
+				return nullptr;
+			}
+			return &chunks[number / CHUNK_SIZE][number % CHUNK_SIZE];
+		}
+
+		/// <summary>
+		/// Whether functions of the given module should be profiled. Modules that have not been registered are
+		/// considered interesting, as we rather record too much than lose coverage. Lock-free.
+		/// </summary>
+		bool isInterestingModule(ModuleID moduleId) {
+			const Assembly* assembly = getAssembly(getAssemblyNumberOfModule(moduleId));
+			return assembly == nullptr || assembly->isInteresting;
+		}
+	};
+}
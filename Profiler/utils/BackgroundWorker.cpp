@@ -0,0 +1,52 @@
+#include "BackgroundWorker.h"
+#include "Debug.h"
+
+namespace Profiler {
+	BackgroundWorker::~BackgroundWorker() {
+		stop();
+	}
+
+	void BackgroundWorker::post(const std::function<void()>& task) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (isStopping) {
+			return;
+		}
+		if (thread == nullptr) {
+			thread = std::make_unique<std::thread>(&BackgroundWorker::run, this);
+		}
+		tasks.push_back(task);
+		condition.notify_one();
+	}
+
+	void BackgroundWorker::stop() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			isStopping = true;
+			condition.notify_one();
+		}
+		if (thread != nullptr && thread->joinable()) {
+			thread->join();
+		}
+	}
+
+	void BackgroundWorker::run() {
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true) {
+			condition.wait(lock, [this]() { return isStopping || !tasks.empty(); });
+			if (tasks.empty()) {
+				return;
+			}
+			std::function<void()> task = tasks.front();
+			tasks.pop_front();
+
+			lock.unlock();
+			try {
+				task();
+			}
+			catch (...) {
+				Debug::getInstance().logErrorWithStracktrace("BackgroundWorker");
+			}
+			lock.lock();
+		}
+	}
+}
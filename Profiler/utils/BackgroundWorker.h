@@ -0,0 +1,42 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "Testing.h"
+
+namespace Profiler {
+	/**
+	 * Runs tasks one after another on a single background thread, so that expensive work does not delay
+	 * the CLR callback that triggered it. The thread is only started with the first task.
+	 * All methods are thread-safe.
+	 */
+	class BackgroundWorker
+	{
+	public:
+		BackgroundWorker() = default;
+
+		/** Stops the worker, see stop(). */
+		EXPOSE_TO_CPP_TESTS ~BackgroundWorker();
+
+		BackgroundWorker(const BackgroundWorker&) = delete;
+		BackgroundWorker& operator=(const BackgroundWorker&) = delete;
+
+		/** Schedules the given task. Tasks posted after stop() are ignored. */
+		void EXPOSE_TO_CPP_TESTS post(const std::function<void()>& task);
+
+		/** Runs all pending tasks and waits for the thread to finish. */
+		void EXPOSE_TO_CPP_TESTS stop();
+
+	private:
+		std::mutex mutex;
+		std::condition_variable condition;
+		std::deque<std::function<void()>> tasks;
+		bool isStopping = false;
+		std::unique_ptr<std::thread> thread;
+
+		void run();
+	};
+}
@@ -0,0 +1,181 @@
+#include "CallbackRecorder.h"
+#include <sstream>
+
+namespace Profiler {
+	namespace {
+		const std::string MAGIC = "TIACB";
+		const unsigned char FORMAT_VERSION = 1;
+
+		/** The buffered callbacks are written to the file once they exceed this size. */
+		const size_t FLUSH_THRESHOLD = 1 << 20;
+
+		/** The ID of the last recording started by any recorder. IDs start at 1. */
+		std::atomic<unsigned int> lastRecordingId(0);
+
+		/** The number of the current thread in the recording it last recorded a callback for. */
+		struct ThreadNumber {
+			unsigned int recordingId;
+			unsigned int number;
+		};
+
+		thread_local ThreadNumber currentThreadNumber = { 0, 0 };
+
+		void writeVarint(std::string& out, unsigned long long value) {
+			while (value >= 0x80) {
+				out += static_cast<char>((value & 0x7F) | 0x80);
+				value >>= 7;
+			}
+			out += static_cast<char>(value);
+		}
+
+		bool readVarint(const std::string& data, size_t& position, unsigned long long& value) {
+			value = 0;
+			for (unsigned int shift = 0; shift < 64; shift += 7) {
+				if (position >= data.size()) {
+					return false;
+				}
+				unsigned char byte = static_cast<unsigned char>(data[position++]);
+				value |= static_cast<unsigned long long>(byte & 0x7F) << shift;
+				if ((byte & 0x80) == 0) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		bool hasText(RecordedCallback::Type type) {
+			return type == RecordedCallback::Type::TEST_START || type == RecordedCallback::Type::TEST_END;
+		}
+
+		/** Appends the callback, encoding its ID relative to the previous one, which is then updated. */
+		void appendCallback(std::string& out, RecordedCallback::Type type, unsigned int thread, unsigned long long id,
+			const std::string& text, unsigned long long& previousId) {
+			long long difference = static_cast<long long>(id - previousId);
+			previousId = id;
+			out += static_cast<char>(type);
+			writeVarint(out, thread);
+			writeVarint(out, (static_cast<unsigned long long>(difference) << 1) ^ static_cast<unsigned long long>(difference >> 63));
+			if (hasText(type)) {
+				writeVarint(out, text.size());
+				out += text;
+			}
+		}
+	}
+
+	CallbackRecorder::~CallbackRecorder() noexcept {
+		close();
+	}
+
+	bool CallbackRecorder::open(const std::string& path) {
+		lock.enter();
+		file.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+		bool opened = file.is_open();
+		if (opened) {
+			buffer = MAGIC;
+			buffer += static_cast<char>(FORMAT_VERSION);
+			previousId = 0;
+			threadCount = 0;
+			recordingId = ++lastRecordingId;
+			isOpen = true;
+		}
+		lock.leave();
+		return opened;
+	}
+
+	void CallbackRecorder::record(RecordedCallback::Type type, unsigned long long id, const std::string& text) {
+		if (!isOpen) {
+			return;
+		}
+		unsigned int thread = getCurrentThread();
+		lock.enter();
+		if (isOpen) {
+			appendCallback(buffer, type, thread, id, text, previousId);
+			if (buffer.size() >= FLUSH_THRESHOLD) {
+				file.write(buffer.data(), buffer.size());
+				buffer.clear();
+			}
+		}
+		lock.leave();
+	}
+
+	void CallbackRecorder::close() {
+		lock.enter();
+		if (isOpen) {
+			isOpen = false;
+			file.write(buffer.data(), buffer.size());
+			file.close();
+			buffer.clear();
+		}
+		lock.leave();
+	}
+
+	unsigned int CallbackRecorder::getCurrentThread() {
+		unsigned int recording = recordingId;
+		if (currentThreadNumber.recordingId != recording) {
+			currentThreadNumber.recordingId = recording;
+			currentThreadNumber.number = threadCount++;
+		}
+		return currentThreadNumber.number;
+	}
+
+	std::string CallbackRecorder::encode(const std::vector<RecordedCallback>& callbacks) {
+		std::string data = MAGIC;
+		data += static_cast<char>(FORMAT_VERSION);
+		unsigned long long previousId = 0;
+		for (const RecordedCallback& callback : callbacks) {
+			appendCallback(data, callback.type, callback.thread, callback.id, callback.text, previousId);
+		}
+		return data;
+	}
+
+	bool CallbackRecorder::decode(const std::string& data, std::vector<RecordedCallback>& callbacks) {
+		if (data.compare(0, MAGIC.size(), MAGIC) != 0 || data.size() <= MAGIC.size()
+			|| static_cast<unsigned char>(data[MAGIC.size()]) != FORMAT_VERSION) {
+			return false;
+		}
+
+		std::vector<RecordedCallback> decoded;
+		unsigned long long previousId = 0;
+		size_t position = MAGIC.size() + 1;
+		while (position < data.size()) {
+			RecordedCallback callback;
+			unsigned char type = static_cast<unsigned char>(data[position++]);
+			if (type < static_cast<unsigned char>(RecordedCallback::Type::ENTER) || type > static_cast<unsigned char>(RecordedCallback::Type::TEST_END)) {
+				return false;
+			}
+			callback.type = static_cast<RecordedCallback::Type>(type);
+
+			unsigned long long thread = 0;
+			unsigned long long zigzag = 0;
+			if (!readVarint(data, position, thread) || !readVarint(data, position, zigzag)) {
+				return false;
+			}
+			callback.thread = static_cast<unsigned int>(thread);
+			long long difference = static_cast<long long>(zigzag >> 1) ^ -static_cast<long long>(zigzag & 1);
+			callback.id = previousId + static_cast<unsigned long long>(difference);
+			previousId = callback.id;
+
+			if (hasText(callback.type)) {
+				unsigned long long length = 0;
+				if (!readVarint(data, position, length) || data.size() - position < length) {
+					return false;
+				}
+				callback.text = data.substr(position, static_cast<size_t>(length));
+				position += static_cast<size_t>(length);
+			}
+			decoded.push_back(std::move(callback));
+		}
+		callbacks = std::move(decoded);
+		return true;
+	}
+
+	bool CallbackRecorder::readFile(const std::string& path, std::vector<RecordedCallback>& callbacks) {
+		std::ifstream file(path, std::ios::in | std::ios::binary);
+		if (!file.is_open()) {
+			return false;
+		}
+		std::ostringstream contents;
+		contents << file.rdbuf();
+		return decode(contents.str(), callbacks);
+	}
+}
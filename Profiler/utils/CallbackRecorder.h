@@ -0,0 +1,84 @@
+#pragma once
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "Lock.h"
+#include "Testing.h"
+
+namespace Profiler {
+	/** A profiler callback as recorded by the CallbackRecorder. */
+	struct RecordedCallback {
+		enum class Type : unsigned char {
+			/** A call of a hooked method. The ID is its FunctionID. */
+			ENTER = 1,
+			/** The ID is the FunctionID of the jitted method. */
+			JIT_COMPILATION_FINISHED = 2,
+			/** The ID is the FunctionID of the inlined method. */
+			JIT_INLINING = 3,
+			/** The ID is the AssemblyID of the loaded assembly. */
+			ASSEMBLY_LOAD_FINISHED = 4,
+			/** The ID is the test context, the text the test name. */
+			TEST_START = 5,
+			/** The ID is the test context, the text the result and duration, e.g. "PASSED:42". */
+			TEST_END = 6,
+		};
+
+		Type type = Type::ENTER;
+
+		/** The thread that received the callback, numbered from 0 in the order in which threads first received one. */
+		unsigned int thread = 0;
+
+		unsigned long long id = 0;
+
+		std::string text;
+	};
+
+	/**
+	 * Records the raw stream of profiler callbacks to a compact binary file, so that it can be replayed offline and
+	 * without a CLR with the CallbackReplay, e.g. to benchmark the recording of the called methods.
+	 *
+	 * The file starts with the magic "TIACB" and a version byte. Each callback follows as its type (1 byte), thread,
+	 * the zigzag-encoded difference of its ID to the ID of the previous callback and, for test events, the length of the
+	 * text and its bytes. All numbers except the type are LEB128-encoded.
+	 */
+	class CallbackRecorder {
+	public:
+		CallbackRecorder() = default;
+
+		virtual ~CallbackRecorder() noexcept;
+
+		/** Starts recording to the given file. Returns false if it cannot be created. */
+		bool EXPOSE_TO_CPP_TESTS open(const std::string& path);
+
+		/** Records a callback on the current thread. Does nothing if the recorder is not open. Thread-safe. */
+		void EXPOSE_TO_CPP_TESTS record(RecordedCallback::Type type, unsigned long long id, const std::string& text = std::string());
+
+		/** Writes the remaining callbacks and closes the file. Further callbacks are ignored. */
+		void EXPOSE_TO_CPP_TESTS close();
+
+		/** Encodes the given callbacks in the format of the recorded files. */
+		static std::string EXPOSE_TO_CPP_TESTS encode(const std::vector<RecordedCallback>& callbacks);
+
+		/** Decodes the contents of a recorded file. Returns false if it is malformed or has an unsupported version. */
+		static bool EXPOSE_TO_CPP_TESTS decode(const std::string& data, std::vector<RecordedCallback>& callbacks);
+
+		/** Reads and decodes the given recorded file. Returns false if it cannot be read or is malformed. */
+		static bool EXPOSE_TO_CPP_TESTS readFile(const std::string& path, std::vector<RecordedCallback>& callbacks);
+
+	private:
+		/** Guards the file, the buffer and the previous ID, as callbacks arrive concurrently. */
+		Lock lock;
+		std::ofstream file;
+		std::string buffer;
+		unsigned long long previousId = 0;
+		std::atomic<bool> isOpen{false};
+		std::atomic<unsigned int> threadCount{0};
+
+		/** Identifies the current recording among all recordings of all recorders, so that threads renumber themselves for each one. */
+		std::atomic<unsigned int> recordingId{0};
+
+		/** Returns the number of the current thread in this recording. */
+		unsigned int getCurrentThread();
+	};
+}
@@ -0,0 +1,39 @@
+#include "CallbackReplay.h"
+#include <atomic>
+#include <thread>
+
+namespace Profiler {
+	void CallbackReplay::replay(const std::vector<RecordedCallback>& callbacks,
+		const std::function<void(const RecordedCallback&)>& handler, bool preserveInterleaving) {
+		std::vector<std::vector<size_t>> callbacksByThread;
+		for (size_t i = 0; i < callbacks.size(); i++) {
+			unsigned int thread = callbacks[i].thread;
+			if (thread >= callbacksByThread.size()) {
+				callbacksByThread.resize(thread + 1);
+			}
+			callbacksByThread[thread].push_back(i);
+		}
+
+		// The index of the callback whose turn it is if the interleaving is preserved
+		std::atomic<size_t> nextCallback(0);
+		std::vector<std::thread> threads;
+		for (const std::vector<size_t>& indices : callbacksByThread) {
+			threads.emplace_back([&callbacks, &handler, &indices, &nextCallback, preserveInterleaving]() {
+				for (size_t index : indices) {
+					if (preserveInterleaving) {
+						while (nextCallback.load(std::memory_order_acquire) != index) {
+							std::this_thread::yield();
+						}
+					}
+					handler(callbacks[index]);
+					if (preserveInterleaving) {
+						nextCallback.store(index + 1, std::memory_order_release);
+					}
+				}
+			});
+		}
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+	}
+}
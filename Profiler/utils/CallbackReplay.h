@@ -0,0 +1,25 @@
+#pragma once
+#include <functional>
+#include <vector>
+#include "CallbackRecorder.h"
+#include "Testing.h"
+
+namespace Profiler {
+	/**
+	 * Replays callbacks recorded by the CallbackRecorder without a CLR, e.g. into the enter hook, so that the overhead
+	 * of the profiler can be measured deterministically and regressions of its hot paths can be tested.
+	 * The callbacks are only dispatched to a handler. There is no handler for the CProfilerCallback yet, as it needs
+	 * an ICorProfilerInfo, so only the enter hook can currently be driven with the ENTER callbacks.
+	 */
+	class CallbackReplay {
+	public:
+		/**
+		 * Calls the handler for each of the callbacks, on one thread per recorded thread, and returns once all of them
+		 * have been handled. If preserveInterleaving is true, each callback is handled only after all callbacks
+		 * recorded before it, which reproduces the interleaving of the recording but serializes the threads.
+		 * Otherwise the threads run concurrently and only the order per thread is preserved, e.g. to measure contention.
+		 */
+		static void EXPOSE_TO_CPP_TESTS replay(const std::vector<RecordedCallback>& callbacks,
+			const std::function<void(const RecordedCallback&)>& handler, bool preserveInterleaving = true);
+	};
+}
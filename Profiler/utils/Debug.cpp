@@ -24,7 +24,6 @@ namespace Profiler {
 	}
 
 	Debug::Debug() {
-		InitializeCriticalSection(&loggingSynchronization);
 		DWORD pid = GetCurrentProcessId();
 		std::string logFilePath = "C:\\Users\\Public\\profiler_debug." + std::to_string(pid) + ".log";
 		logFile = CreateFile(logFilePath.c_str(), GENERIC_WRITE, FILE_SHARE_READ,
@@ -39,10 +38,10 @@ namespace Profiler {
 
 		message += "\r\n";
 
-		EnterCriticalSection(&loggingSynchronization);
+		loggingSynchronization.enter();
 		DWORD dwWritten = 0;
 		WriteFile(logFile, message.c_str(), static_cast<DWORD>(strlen(message.c_str())), &dwWritten, nullptr);
-		LeaveCriticalSection(&loggingSynchronization);
+		loggingSynchronization.leave();
 	}
 
 	void Debug::logErrorWithStracktrace(std::string context) {
@@ -57,6 +56,5 @@ namespace Profiler {
 		if (logFile != INVALID_HANDLE_VALUE) {
 			CloseHandle(logFile);
 		}
-		DeleteCriticalSection(&loggingSynchronization);
 	}
 }
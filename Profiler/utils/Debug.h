@@ -1,6 +1,7 @@
 #pragma once
 #include <atlbase.h>
 #include <string>
+#include "Lock.h"
 namespace Profiler {
 	/**
 	 * Helper for debugging. Logs messages to C:\Users\Public\profiler_debug.PID.log where
@@ -24,7 +25,7 @@ namespace Profiler {
 		virtual ~Debug();
 
 		HANDLE logFile = INVALID_HANDLE_VALUE;
-		CRITICAL_SECTION loggingSynchronization;
+		Lock loggingSynchronization;
 	};
 }
 
@@ -0,0 +1,159 @@
+#include "FileVersionCache.h"
+#include <array>
+#include <codecvt>
+#include <fstream>
+#include <locale>
+#include <memory>
+#include <sstream>
+
+#pragma comment(lib, "version.lib")
+
+namespace Profiler {
+	namespace {
+		/** Separates the fields of a cache entry. Cannot occur in paths. */
+		const wchar_t FIELD_SEPARATOR = L'\t';
+	}
+
+	FileVersionCache::FileVersionCache(const std::wstring& cacheFile, VersionReader versionReader) :
+		cacheFile(cacheFile), versionReader(versionReader) {
+	}
+
+	std::wstring FileVersionCache::getVersionInfo(const std::wstring& assemblyPath) {
+		WIN32_FILE_ATTRIBUTE_DATA attributes;
+		if (!GetFileAttributesExW(assemblyPath.c_str(), GetFileExInfoStandard, &attributes)) {
+			return versionReader(assemblyPath);
+		}
+
+		if (!isLoaded) {
+			load();
+		}
+
+		ULONGLONG size = (static_cast<ULONGLONG>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+		ULONGLONG lastWriteTime = (static_cast<ULONGLONG>(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+		std::wostringstream key;
+		key << assemblyPath << FIELD_SEPARATOR << size << FIELD_SEPARATOR << lastWriteTime;
+
+		std::map<std::wstring, std::wstring>::const_iterator entry = entries.find(key.str());
+		if (entry != entries.end()) {
+			return entry->second;
+		}
+
+		std::wstring versionInfo = versionReader(assemblyPath);
+		entries[key.str()] = versionInfo;
+		append(key.str(), versionInfo);
+		return versionInfo;
+	}
+
+	void FileVersionCache::load() {
+		isLoaded = true;
+		if (cacheFile.empty()) {
+			return;
+		}
+
+		std::ifstream file(cacheFile, std::ios::binary | std::ios::ate);
+		if (!file.is_open()) {
+			return;
+		}
+		if (file.tellg() > MAX_CACHE_FILE_SIZE) {
+			file.close();
+			DeleteFileW(cacheFile.c_str());
+			return;
+		}
+		file.seekg(0);
+
+		std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
+		std::string line;
+		while (std::getline(file, line)) {
+			// A line without terminator may still be written by another process
+			if (file.eof()) {
+				break;
+			}
+			std::wstring entry;
+			try {
+				entry = converter.from_bytes(line);
+			}
+			catch (const std::range_error&) {
+				continue;
+			}
+
+			// path, size and last write time form the key, the rest are the versions
+			size_t separator = entry.find(FIELD_SEPARATOR);
+			if (separator != std::wstring::npos) {
+				separator = entry.find(FIELD_SEPARATOR, separator + 1);
+			}
+			if (separator != std::wstring::npos) {
+				separator = entry.find(FIELD_SEPARATOR, separator + 1);
+			}
+			if (separator != std::wstring::npos) {
+				entries[entry.substr(0, separator)] = entry.substr(separator + 1);
+			}
+		}
+	}
+
+	void FileVersionCache::append(const std::wstring& key, const std::wstring& versionInfo) {
+		if (cacheFile.empty()) {
+			return;
+		}
+
+		HANDLE file = CreateFileW(cacheFile.c_str(), FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+			nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			return;
+		}
+
+		std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
+		std::string line = converter.to_bytes(key + FIELD_SEPARATOR + versionInfo + L"\n");
+		DWORD bytesWritten = 0;
+		WriteFile(file, line.data(), static_cast<DWORD>(line.size()), &bytesWritten, nullptr);
+		CloseHandle(file);
+	}
+
+	std::wstring FileVersionCache::getDefaultCacheFile() {
+		std::array<wchar_t, MAX_PATH> programData;
+		DWORD length = GetEnvironmentVariableW(L"ProgramData", programData.data(), static_cast<DWORD>(programData.size()));
+		if (length == 0 || length >= programData.size()) {
+			return L"";
+		}
+
+		std::wstring directory = std::wstring(programData.data()) + L"\\Teamscale .NET Profiler";
+		if (!CreateDirectoryW(directory.c_str(), nullptr) && GetLastError() != ERROR_ALREADY_EXISTS) {
+			return L"";
+		}
+		return directory + L"\\file_versions.cache";
+	}
+
+	std::wstring FileVersionCache::readVersionInfo(const std::wstring& assemblyPath) {
+		DWORD infoSize = GetFileVersionInfoSizeW(assemblyPath.c_str(), nullptr);
+		if (!infoSize) {
+			return L"";
+		}
+
+		std::unique_ptr<BYTE[]> versionInfo{ new BYTE[infoSize] };
+		if (!GetFileVersionInfoW(assemblyPath.c_str(), 0L, infoSize, versionInfo.get())) {
+			return L"";
+		}
+
+		VS_FIXEDFILEINFO* fileInfo = nullptr;
+		UINT fileInfoLength = 0;
+		if (!VerQueryValueW(versionInfo.get(), L"\\", (void**)&fileInfo, &fileInfoLength)) {
+			return L"";
+		}
+		if (fileInfo == nullptr) {
+			return L"";
+		}
+
+		std::wostringstream out;
+		out << " FileVersion:"
+			<< HIWORD(fileInfo->dwFileVersionMS) << "."
+			<< LOWORD(fileInfo->dwFileVersionMS) << "."
+			<< HIWORD(fileInfo->dwFileVersionLS) << "."
+			<< LOWORD(fileInfo->dwFileVersionLS);
+
+		out << " ProductVersion:"
+			<< HIWORD(fileInfo->dwProductVersionMS) << "."
+			<< LOWORD(fileInfo->dwProductVersionMS) << "."
+			<< HIWORD(fileInfo->dwProductVersionLS) << "."
+			<< LOWORD(fileInfo->dwProductVersionLS);
+		return out.str();
+	}
+}
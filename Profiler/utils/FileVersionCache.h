@@ -0,0 +1,59 @@
+#pragma once
+#include <Windows.h>
+#include <functional>
+#include <map>
+#include <string>
+#include "Testing.h"
+
+namespace Profiler {
+	/**
+	 * Caches the file and product versions of assemblies in a file that is shared by all profiled processes
+	 * on the machine. Entries are keyed by path, size and last write time of the assembly, so a changed
+	 * assembly is read again. Reading the version resources of a DLL is expensive compared to looking it up
+	 * here, and the same DLLs are loaded by every process of an application.
+	 *
+	 * The cache file is append-only. Every process appends the versions it had to read with a single write,
+	 * so concurrent processes do not corrupt each other's entries. Incomplete lines are ignored when loading.
+	 * This class is not thread-safe.
+	 */
+	class FileVersionCache
+	{
+	public:
+		/** Reads the version resources of the given file and returns them formatted for the trace file or the empty string. */
+		typedef std::function<std::wstring(const std::wstring&)> VersionReader;
+
+		/**
+		 * Creates a cache that is persisted in the given file, which is only loaded on first use.
+		 * An empty path disables persisting the cache.
+		 */
+		EXPOSE_TO_CPP_TESTS FileVersionCache(const std::wstring& cacheFile, VersionReader versionReader = readVersionInfo);
+
+		/** Returns the versions of the given assembly formatted for the trace file, e.g. " FileVersion:1.0.0.0 ProductVersion:1.0.0.0". */
+		EXPOSE_TO_CPP_TESTS std::wstring getVersionInfo(const std::wstring& assemblyPath);
+
+		/** Reads the versions from the resources of the given file. */
+		static EXPOSE_TO_CPP_TESTS std::wstring readVersionInfo(const std::wstring& assemblyPath);
+
+		/** Returns the path of the cache file that is shared by all processes on this machine. */
+		static std::wstring getDefaultCacheFile();
+
+	private:
+		/** Larger cache files are started anew, so stale entries of updated assemblies do not accumulate forever. */
+		static const long long MAX_CACHE_FILE_SIZE = 16 * 1024 * 1024;
+
+		std::wstring cacheFile;
+
+		VersionReader versionReader;
+
+		bool isLoaded = false;
+
+		/** Maps from path, size and last write time to the versions. */
+		std::map<std::wstring, std::wstring> entries;
+
+		/** Reads all complete entries of the cache file. */
+		void load();
+
+		/** Appends the given entry to the cache file. */
+		void append(const std::wstring& key, const std::wstring& versionInfo);
+	};
+}
@@ -0,0 +1,168 @@
+#pragma once
+#include <corprof.h>
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+#include <memory>
+#include "utils/Lock.h"
+
+namespace Profiler {
+	/// <summary>
+	/// Set of functionIDs that may be used from many threads at once without external synchronization.
+	/// Lookups are lock-free. Inserts claim an empty slot with a single compare-and-swap and only take
+	/// a shared lock, so concurrent inserts do not wait for each other. Only a resize takes the lock
+	/// exclusively. Replaced arrays are kept alive until the set is destroyed, as lock-free readers may
+	/// still be using them.
+	/// </summary>
+	class ConcurrentFunctionIdSet final
+	{
+	private:
+		const static unsigned int DEFAULT_SIZE = 131'072;
+
+		/// <summary>
+		/// The slots together with their size, so that lock-free readers always see a consistent pair.
+		/// </summary>
+		struct Table {
+			unsigned int moduloMask;
+			std::unique_ptr<std::atomic<FunctionID>[]> slots;
+			std::atomic<unsigned int> numElements{0};
+
+			explicit Table(unsigned int size) : moduloMask(size - 1), slots(new std::atomic<FunctionID>[size]{}) {}
+		};
+
+		/// <summary>
+		/// All tables ever allocated, the last one is the current one. Only modified while holding the resize lock exclusively.
+		/// </summary>
+		std::vector<std::unique_ptr<Table>> tables;
+
+		/// <summary>
+		/// The table that is used for lookups and inserts.
+		/// </summary>
+		std::atomic<Table*> currentTable;
+
+		/// <summary>
+		/// Held shared by inserts and exclusively by resizes.
+		/// </summary>
+		ReadWriteLock resizeLock;
+
+		/// <summary>
+		/// Same hash as in the FunctionIdSet, see there.
+		/// </summary>
+		static inline FunctionID hash(FunctionID f) {
+#if UINTPTR_MAX > 0xFFFFFFFF
+			f ^= f >> 30;
+			f *= 0xbf58476d1ce4e5b9;
+			f ^= f >> 27;
+			f *= 0x94d049bb133111eb;
+			f ^= f >> 31;
+			return f;
+#else
+			f ^= f >> 16;
+			f *= 0x21f0aaadU;
+			f ^= f >> 15;
+			f *= 0x735a2d97U;
+			f ^= f >> 15;
+			return f;
+#endif
+		}
+
+		enum class InsertResult {
+			Inserted,
+			AlreadyContained,
+			TableFull
+		};
+
+		/// <summary>
+		/// Claims a free slot for f with a compare-and-swap. Probing stops after a bounded number of slots,
+		/// in which case the table is considered full even if it still has free slots elsewhere.
+		/// </summary>
+		static InsertResult insertInto(Table* table, FunctionID f) {
+			unsigned int position = static_cast<unsigned int>(hash(f)) & table->moduloMask;
+			for (unsigned int probes = 0; probes <= table->moduloMask; probes++) {
+				FunctionID current = table->slots[position];
+				if (current == 0) {
+					if (table->slots[position].compare_exchange_strong(current, f)) {
+						table->numElements++;
+						return InsertResult::Inserted;
+					}
+					// Another thread claimed the slot first, so we must check what it inserted, which the exchange stored in current
+				}
+				if (current == f) {
+					return InsertResult::AlreadyContained;
+				}
+				position = (position + 1) & table->moduloMask;
+			}
+			return InsertResult::TableFull;
+		}
+
+		/// <summary>
+		/// Replaces the given table with one of twice the size, unless another thread has already done so.
+		/// </summary>
+		void increaseSize(Table* fullTable) {
+			resizeLock.enter();
+			if (currentTable == fullTable) {
+				unsigned int oldSize = fullTable->moduloMask + 1;
+				std::unique_ptr<Table> newTable = std::make_unique<Table>(oldSize * 2);
+				for (unsigned int i = 0; i < oldSize; i++) {
+					if (fullTable->slots[i] != 0) {
+						insertInto(newTable.get(), fullTable->slots[i]);
+					}
+				}
+				currentTable = newTable.get();
+				tables.push_back(std::move(newTable));
+			}
+			resizeLock.leave();
+		}
+
+	public:
+		ConcurrentFunctionIdSet() {
+			// Copied, as make_unique would bind the constant to a reference, which GCC and Clang only link with a definition outside of the class
+			tables.push_back(std::make_unique<Table>(static_cast<unsigned int>(DEFAULT_SIZE)));
+			currentTable = tables.back().get();
+		}
+
+		ConcurrentFunctionIdSet(const ConcurrentFunctionIdSet&) = delete;
+		ConcurrentFunctionIdSet& operator=(const ConcurrentFunctionIdSet&) = delete;
+
+		/// <summary>
+		/// True if the set contains FunctionID f, false otherwise. Lock-free.
+		/// May return false for a function that another thread is inserting concurrently.
+		/// </summary>
+		bool contains(FunctionID f) {
+			Table* table = currentTable;
+			unsigned int position = static_cast<unsigned int>(hash(f)) & table->moduloMask;
+			for (unsigned int probes = 0; probes <= table->moduloMask; probes++) {
+				FunctionID current = table->slots[position];
+				if (current == f) {
+					return true;
+				}
+				if (current == 0) {
+					return false;
+				}
+				position = (position + 1) & table->moduloMask;
+			}
+			return false;
+		}
+
+		/// <summary>
+		/// Inserts FunctionID f into the set. Returns true for exactly one of all threads that insert the same
+		/// function, i.e. the caller may record the function if and only if this returns true.
+		/// </summary>
+		bool insert(FunctionID f) {
+			while (true) {
+				resizeLock.enterShared();
+				Table* table = currentTable;
+				InsertResult result = insertInto(table, f);
+				bool isOverloaded = table->numElements > table->moduloMask / 2;
+				resizeLock.leaveShared();
+
+				if (result == InsertResult::TableFull || isOverloaded) {
+					increaseSize(table);
+				}
+				if (result != InsertResult::TableFull) {
+					return result == InsertResult::Inserted;
+				}
+			}
+		}
+	};
+}
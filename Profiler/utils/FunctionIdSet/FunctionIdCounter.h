@@ -0,0 +1,203 @@
+#pragma once
+#include <corprof.h>
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+#include <memory>
+
+namespace Profiler {
+	/// <summary>
+	/// Companion of the FunctionIdSet that stores a saturating call counter per functionID.
+	/// Lookups and increments of already known functions are lock-free, only adding a new function
+	/// must be synchronized by the caller. This keeps the enter hook at one lookup and one interlocked
+	/// increment for all but the first call of a function.
+	/// </summary>
+	class FunctionIdCounter final
+	{
+	public:
+		/// <summary>
+		/// Counters stop at this value. It is well below LONG_MAX so that threads that increment
+		/// concurrently right at the limit can never make the counter overflow.
+		/// </summary>
+		const static LONG SATURATION = 0x7FFF0000;
+
+	private:
+		const static unsigned int DEFAULT_SIZE = 65'536;
+
+		struct Slot {
+			std::atomic<FunctionID> functionId;
+			std::atomic<LONG> count;
+		};
+
+		/// <summary>
+		/// The slots together with their size, so that lock-free readers always see a consistent pair.
+		/// </summary>
+		struct Table {
+			unsigned int moduloMask;
+			std::unique_ptr<Slot[]> slots;
+
+			explicit Table(unsigned int size) : moduloMask(size - 1), slots(new Slot[size]{}) {}
+		};
+
+		unsigned int numElements = 0;
+		unsigned int maxElements = DEFAULT_SIZE / 2;
+
+		/// <summary>
+		/// All tables allocated since the last clear. Tables replaced by a resize may still be in use by
+		/// lock-free readers, so they are kept until they are retired by a clear.
+		/// </summary>
+		std::vector<std::unique_ptr<Table>> tables;
+
+		/// <summary>
+		/// The tables replaced by the last clear. A reader holds a table only for a single lookup and increment,
+		/// so they are freed one clear later, i.e. after a whole test, rather than right away.
+		/// </summary>
+		std::vector<std::unique_ptr<Table>> retiredTables;
+
+		/// <summary>
+		/// The table new functions are added to. Always the last entry of tables.
+		/// </summary>
+		std::atomic<Table*> currentTable;
+
+		/// <summary>
+		/// Same hash as in the FunctionIdSet, see there.
+		/// </summary>
+		static inline FunctionID hash(FunctionID f) {
+#if UINTPTR_MAX > 0xFFFFFFFF
+			f ^= f >> 30;
+			f *= 0xbf58476d1ce4e5b9;
+			f ^= f >> 27;
+			f *= 0x94d049bb133111eb;
+			f ^= f >> 31;
+			return f;
+#else
+			f ^= f >> 16;
+			f *= 0x21f0aaadU;
+			f ^= f >> 15;
+			f *= 0x735a2d97U;
+			f ^= f >> 15;
+			return f;
+#endif
+		}
+
+		static inline Slot* findSlot(Table* table, FunctionID f) {
+			unsigned int position = static_cast<unsigned int>(hash(f)) & table->moduloMask;
+			while (table->slots[position].functionId != 0) {
+				if (table->slots[position].functionId == f) {
+					return &table->slots[position];
+				}
+				position = (position + 1) & table->moduloMask;
+			}
+			return nullptr;
+		}
+
+		static inline Slot* findFreeSlot(Table* table, FunctionID f) {
+			unsigned int position = static_cast<unsigned int>(hash(f)) & table->moduloMask;
+			while (table->slots[position].functionId != 0) {
+				position = (position + 1) & table->moduloMask;
+			}
+			return &table->slots[position];
+		}
+
+		/// <summary>
+		/// Doubles the size of the array. Increments that race with the resize may be lost, which
+		/// only affects the counts, never whether a function is contained.
+		/// </summary>
+		void increaseSize() {
+			Table* oldTable = currentTable;
+			unsigned int oldSize = oldTable->moduloMask + 1;
+			std::unique_ptr<Table> newTable = std::make_unique<Table>(oldSize * 2);
+			for (unsigned int i = 0; i < oldSize; i++) {
+				Slot& oldSlot = oldTable->slots[i];
+				if (oldSlot.functionId != 0) {
+					Slot* newSlot = findFreeSlot(newTable.get(), oldSlot.functionId);
+					newSlot->count = oldSlot.count.load();
+					newSlot->functionId = oldSlot.functionId.load();
+				}
+			}
+
+			maxElements = oldSize;
+			currentTable = newTable.get();
+			tables.push_back(std::move(newTable));
+		}
+
+	public:
+		FunctionIdCounter() {
+			// The cast passes a temporary, for the same reason as in the ConcurrentFunctionIdSet
+			tables.push_back(std::make_unique<Table>(static_cast<unsigned int>(DEFAULT_SIZE)));
+			currentTable = tables.back().get();
+		}
+
+		/// <summary>
+		/// Returns the counter of FunctionID f or nullptr if f has not been added yet. Lock-free.
+		/// </summary>
+		std::atomic<LONG>* find(FunctionID f) {
+			Slot* slot = findSlot(currentTable, f);
+			return slot == nullptr ? nullptr : &slot->count;
+		}
+
+		/// <summary>
+		/// Increments the given counter unless it is saturated. Lock-free.
+		/// </summary>
+		static inline void increment(std::atomic<LONG>* count) {
+			if (*count < SATURATION) {
+				(*count)++;
+			}
+		}
+
+		/// <summary>
+		/// Counts one call of FunctionID f, adding it if necessary. Must be called from synchronized context.
+		/// </summary>
+		void add(FunctionID f) {
+			Slot* slot = findSlot(currentTable, f);
+			if (slot != nullptr) {
+				increment(&slot->count);
+				return;
+			}
+
+			if (numElements + 1 > maxElements) {
+				increaseSize();
+			}
+			numElements++;
+			slot = findFreeSlot(currentTable, f);
+			// The count must be visible before lock-free readers can find the function
+			slot->count = 1;
+			slot->functionId = f;
+		}
+
+		/// <summary>
+		/// Empties the counter by switching to a new table. Must be called from synchronized context.
+		/// The replaced tables are not modified, so threads in the enter hook that still use them can neither
+		/// lose counts of the next test nor credit their call to it. Increments that race with the clear are lost.
+		/// </summary>
+		void clear() {
+			numElements = 0;
+			maxElements = DEFAULT_SIZE / 2;
+			retiredTables = std::move(tables);
+			tables.clear();
+			tables.push_back(std::make_unique<Table>(static_cast<unsigned int>(DEFAULT_SIZE)));
+			currentTable = tables.back().get();
+		}
+
+		/// <summary>
+		/// Current size of the underlying array.
+		/// </summary>
+		unsigned int size() {
+			return currentTable.load()->moduloMask + 1;
+		}
+
+		/// <summary>
+		/// Get the FunctionID at index i of the underlying array or 0 if that slot is empty.
+		/// </summary>
+		FunctionID at(unsigned int i) {
+			return currentTable.load()->slots[i].functionId;
+		}
+
+		/// <summary>
+		/// Get the count at index i of the underlying array.
+		/// </summary>
+		ULONG countAt(unsigned int i) {
+			return static_cast<ULONG>(currentTable.load()->slots[i].count);
+		}
+	};
+}
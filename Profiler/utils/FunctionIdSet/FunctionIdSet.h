@@ -1,6 +1,8 @@
 #pragma once
 #include <corprof.h>
+#include <stdint.h>
 #include <limits.h>
+#include <atomic>
 #include <vector>
 #include <memory>
 
@@ -8,6 +10,7 @@ namespace Profiler {
 	/// <summary>
 	/// Set that can only contain functionIDs, which are just unsigned ints.
 	/// This is based on an array and is a lot faster than the default set implementation of the standard library for this use case.
+	/// Lookups are lock-free and may run concurrently with inserts and clears, which must be synchronized by the caller.
 	/// </summary>
 	class FunctionIdSet final
 	{
@@ -17,29 +20,53 @@ namespace Profiler {
 
 		static const FunctionID rotationMask = (-1) & (CHAR_BIT * sizeof(FunctionID) - 1);
 
-		unsigned int currentSize = DEFAULT_SIZE;
+		/// <summary>
+		/// The slots together with their size, so that lock-free readers always see a consistent pair.
+		/// </summary>
+		struct Table {
+			unsigned int moduloMask;
+			std::unique_ptr<std::atomic<FunctionID>[]> slots;
+
+			explicit Table(unsigned int size) : moduloMask(size - 1), slots(new std::atomic<FunctionID>[size]{}) {}
+		};
+
 		unsigned int numElements = 0;
 		unsigned int maxElements = DEFAULT_SIZE / 2;
-		unsigned int moduloMask = currentSize - 1;
-		std::unique_ptr<FunctionID[]> set{ new FunctionID[DEFAULT_SIZE] {0} };
 
+		/// <summary>
+		/// All tables allocated since the last clear. Tables replaced by a resize may still be probed by
+		/// lock-free readers, so they are only retired by the next clear.
+		/// </summary>
+		std::vector<std::unique_ptr<Table>> tables;
 
 		/// <summary>
-		/// Updates the size of the array and reinserts the element into the new array.
+		/// The tables replaced by the last clear. A reader holds a table only for a single lookup, so they
+		/// are freed one clear later, i.e. after a whole test, rather than right away.
+		/// </summary>
+		std::vector<std::unique_ptr<Table>> retiredTables;
+
+		/// <summary>
+		/// The table used for lookups and inserts. Always the last entry of tables.
+		/// </summary>
+		std::atomic<Table*> currentTable;
+
+		/// <summary>
+		/// Replaces the current table with one of twice the size that contains the same elements.
 		/// </summary>
 		void increase_size() {
-			maxElements = currentSize;
-			currentSize *= 2;
-			moduloMask = currentSize - 1;
-			numElements = 0;
-			std::unique_ptr<FunctionID[]> old_set = move(set);
-			set = std::make_unique<FunctionID[]>(currentSize);
-			std::fill_n(set.get(), currentSize, 0);
-			for (unsigned int i = 0; i < maxElements; i++) {
-				if (old_set[i] != 0) {
-					insert(old_set[i]);
+			Table* oldTable = currentTable;
+			unsigned int oldSize = oldTable->moduloMask + 1;
+			tables.push_back(std::make_unique<Table>(oldSize * 2));
+			Table* newTable = tables.back().get();
+			for (unsigned int i = 0; i < oldSize; i++) {
+				FunctionID f = oldTable->slots[i];
+				if (f != 0) {
+					insertInto(newTable, f);
 				}
 			}
+			maxElements = oldSize;
+			// Published only after it is filled, so that readers never miss an element
+			currentTable = newTable;
 		}
 
 		/// <summary>
@@ -49,25 +76,7 @@ namespace Profiler {
 			return (f >> 1) | (f << rotationMask);
 		}
 
-		inline bool try_insert(unsigned int position, const FunctionID f) {
-			if (set[position] == f) {
-				return true;
-			}
-			if (set[position] == 0) {
-				numElements++;
-				if (numElements > maxElements) {
-					increase_size();
-					insert(f);
-					return true;
-				}
-
-				set[position] = f;
-				return true;
-			}
-			return false;
-		}
-
-		inline unsigned int nextPosition(byte& moveCounter, FunctionID& currentValue) {
+		static inline unsigned int nextPosition(const Table* table, unsigned char& moveCounter, FunctionID& currentValue) {
 			if (moveCounter == 3) {
 				moveCounter = 0;
 				currentValue = hash(currentValue);
@@ -76,16 +85,36 @@ namespace Profiler {
 				currentValue++;
 				moveCounter++;
 			}
-			return currentValue & moduloMask;
+			return currentValue & table->moduloMask;
 		}
 
+		/// <summary>
+		/// Stores f in the first free slot of its probe sequence, unless the table already contains it. Returns whether f was stored.
+		/// </summary>
+		static bool insertInto(Table* table, FunctionID f) {
+			// Try insertion at the number modulo the size of the set first, then rotate bits and xor to find a new position
+			unsigned int position = f & table->moduloMask;
+			FunctionID currentValue = f;
+			unsigned char moveCounter = 0;
+			while (true) {
+				FunctionID current = table->slots[position];
+				if (current == f) {
+					return false;
+				}
+				if (current == 0) {
+					table->slots[position] = f;
+					return true;
+				}
+				position = nextPosition(table, moveCounter, currentValue);
+			}
+		}
 
 		/// <summary>
 		/// Hash function for integers/longs as found on https://github.com/skeeto/hash-prospector
 		/// Also relevant: discussion here https://www.reddit.com/r/RNG/comments/jqnq20/the_wang_and_jenkins_integer_hash_functions_just/
 		/// </summary>
-		inline FunctionID hash(FunctionID f) {
-#ifdef _WIN64
+		static inline FunctionID hash(FunctionID f) {
+#if UINTPTR_MAX > 0xFFFFFFFF
 			f ^= f >> 30;
 			f *= 0xbf58476d1ce4e5b9;
 			f ^= f >> 27;
@@ -104,74 +133,73 @@ namespace Profiler {
 
 
 	public:
+		FunctionIdSet() {
+			// The cast passes a temporary, as make_unique would otherwise need a definition of the constant outside of the class
+			tables.push_back(std::make_unique<Table>(static_cast<unsigned int>(DEFAULT_SIZE)));
+			currentTable = tables.back().get();
+		}
+
+		FunctionIdSet(const FunctionIdSet&) = delete;
+		FunctionIdSet& operator=(const FunctionIdSet&) = delete;
 
 		/// <summary>
-		/// Empties the set and sets back the size of the underlying array.
+		/// Empties the set and sets back the size of the underlying array by switching to a new table.
+		/// The replaced tables stay valid until the next clear, so threads that are still probing them are not affected.
 		/// </summary>
 		void clear() {
-			currentSize = DEFAULT_SIZE;
-			maxElements = DEFAULT_SIZE / 2;
 			numElements = 0;
-			set.reset(new FunctionID[DEFAULT_SIZE]{ });
+			maxElements = DEFAULT_SIZE / 2;
+			retiredTables = std::move(tables);
+			tables.clear();
+			tables.push_back(std::make_unique<Table>(static_cast<unsigned int>(DEFAULT_SIZE)));
+			currentTable = tables.back().get();
 		}
 
 		/// <summary>
 		/// Current size of the set.
 		/// </summary>
 		unsigned int size() {
-			return currentSize;
+			return currentTable.load()->moduloMask + 1;
 		}
 
 		/// <summary>
 		/// Get the element at index i of the underlying array.
 		/// </summary>
 		FunctionID at(unsigned int i) {
-			return set[i];
+			return currentTable.load()->slots[i];
 		}
 
 		/// <summary>
-		/// True if the set contains FunctionID f, false otherwise.
+		/// True if the set contains FunctionID f, false otherwise. Lock-free.
 		/// </summary>
 		bool contains(FunctionID f) {
-			// Check the number modulo the size of the set first
-			unsigned int position = f & moduloMask;
-			if (set[position] == 0) {
-				return false;
-			}
-			if (set[position] == f) {
-				return true;
-			}
-
-			// Apply hash function until we found the value or an empty spot
+			const Table* table = currentTable;
+			// Check the number modulo the size of the set first, then apply the hash function until we find the value or an empty spot
+			unsigned int position = f & table->moduloMask;
 			FunctionID currentValue = f;
-			byte moveCounter = 0;
-			while (set[position] != f) {
-				position = nextPosition(moveCounter, currentValue);
-				if (set[position] == 0) {
+			unsigned char moveCounter = 0;
+			while (true) {
+				FunctionID current = table->slots[position];
+				if (current == f) {
+					return true;
+				}
+				if (current == 0) {
 					return false;
 				}
+				position = nextPosition(table, moveCounter, currentValue);
 			}
-			return true;
 		}
 
 		/// <summary>
-		/// Inserts FunctionID f into the set.
+		/// Inserts FunctionID f into the set. Must be called from synchronized context.
 		/// </summary>
 		void insert(FunctionID f) {
-			// Try insertion at the number modulo the size of the set first
-			unsigned int position = f & moduloMask;
-			if (try_insert(position, f))
-			{
-				return;
-			}
-
-			// Then rotate bits and xor to try and find a new position
-			FunctionID currentValue = f;
-			byte moveCounter = 0;
-			while (!try_insert(position, f)) {
-				position = nextPosition(moveCounter, currentValue);
+			if (insertInto(currentTable, f)) {
+				numElements++;
+				if (numElements > maxElements) {
+					increase_size();
+				}
 			}
 		}
 	};
 }
-
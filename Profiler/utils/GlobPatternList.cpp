@@ -0,0 +1,69 @@
+#include "GlobPatternList.h"
+#include "StringUtils.h"
+#include <cwctype>
+
+namespace Profiler {
+	GlobPatternList::GlobPatternList(const std::string& includePatterns, const std::string& excludePatterns) :
+		includePatterns(splitPatterns(includePatterns)), excludePatterns(splitPatterns(excludePatterns)) {
+	}
+
+	std::vector<std::wstring> GlobPatternList::splitPatterns(const std::string& patterns) {
+		std::vector<std::wstring> result;
+		for (const std::string& pattern : StringUtils::split(patterns, ';')) {
+			// Assembly names and namespaces in patterns are expected to be ASCII
+			result.push_back(std::wstring(pattern.begin(), pattern.end()));
+		}
+		return result;
+	}
+
+	bool GlobPatternList::matches(const std::wstring& text) const {
+		bool isIncluded = includePatterns.empty();
+		for (const std::wstring& pattern : includePatterns) {
+			if (matchesPattern(pattern, text)) {
+				isIncluded = true;
+				break;
+			}
+		}
+		if (!isIncluded) {
+			return false;
+		}
+
+		for (const std::wstring& pattern : excludePatterns) {
+			if (matchesPattern(pattern, text)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool GlobPatternList::matchesPattern(const std::wstring& pattern, const std::wstring& text) {
+		// Greedy matching that backtracks to the last star, which is linear for patterns with a single star
+		size_t patternIndex = 0;
+		size_t textIndex = 0;
+		size_t lastStar = std::wstring::npos;
+		size_t textIndexAtLastStar = 0;
+		while (textIndex < text.length()) {
+			if (patternIndex < pattern.length() && pattern[patternIndex] == L'*') {
+				lastStar = patternIndex++;
+				textIndexAtLastStar = textIndex;
+			}
+			else if (patternIndex < pattern.length() && (pattern[patternIndex] == L'?'
+				|| std::towlower(pattern[patternIndex]) == std::towlower(text[textIndex]))) {
+				patternIndex++;
+				textIndex++;
+			}
+			else if (lastStar != std::wstring::npos) {
+				patternIndex = lastStar + 1;
+				textIndex = ++textIndexAtLastStar;
+			}
+			else {
+				return false;
+			}
+		}
+
+		while (patternIndex < pattern.length() && pattern[patternIndex] == L'*') {
+			patternIndex++;
+		}
+		return patternIndex == pattern.length();
+	}
+}
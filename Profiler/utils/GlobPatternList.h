@@ -0,0 +1,42 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "Testing.h"
+
+namespace Profiler {
+	/**
+	 * Maintains a list of include and exclude glob patterns, like the GlobPatternList of the upload daemon.
+	 * Special characters:
+	 *
+	 * - * matches any number of characters
+	 * - ? matches any one character
+	 *
+	 * Patterns must always match the entire input string and are matched case-insensitively.
+	 * Unlike in the upload daemon, an empty include list includes everything, so that an unconfigured
+	 * list does not filter anything.
+	 */
+	class GlobPatternList
+	{
+	public:
+		/** Creates a list that matches everything. */
+		GlobPatternList() = default;
+
+		/** Creates a list from the given semicolon-separated include and exclude patterns. */
+		EXPOSE_TO_CPP_TESTS GlobPatternList(const std::string& includePatterns, const std::string& excludePatterns);
+
+		/** Whether this list has no patterns at all, i.e. matches everything. */
+		bool isEmpty() const {
+			return includePatterns.empty() && excludePatterns.empty();
+		}
+
+		/** Returns true if the given text is included and none of the exclude patterns match it. */
+		bool EXPOSE_TO_CPP_TESTS matches(const std::wstring& text) const;
+
+	private:
+		std::vector<std::wstring> includePatterns;
+		std::vector<std::wstring> excludePatterns;
+
+		static std::vector<std::wstring> splitPatterns(const std::string& patterns);
+		static bool matchesPattern(const std::wstring& pattern, const std::wstring& text);
+	};
+}
@@ -0,0 +1,46 @@
+#include "IdleTimer.h"
+#include "Debug.h"
+
+namespace Profiler {
+	IdleTimer::IdleTimer(std::chrono::milliseconds idleTime, const std::function<void()>& onIdle)
+		: idleMilliseconds(idleTime.count()), onIdle(onIdle), lastActivity(now()) {
+		thread = std::make_unique<std::thread>(&IdleTimer::run, this);
+	}
+
+	IdleTimer::~IdleTimer() {
+		stop();
+	}
+
+	void IdleTimer::stop() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			isStopping = true;
+			condition.notify_one();
+		}
+		if (thread != nullptr && thread->joinable()) {
+			thread->join();
+		}
+	}
+
+	void IdleTimer::run() {
+		std::unique_lock<std::mutex> lock(mutex);
+		while (!isStopping) {
+			// Activity only postpones the deadline, so it is checked once the previous one has passed
+			long long idleSince = lastActivity.load(std::memory_order_relaxed);
+			long long remainingMilliseconds = idleSince + idleMilliseconds - now();
+			if (remainingMilliseconds > 0) {
+				condition.wait_for(lock, std::chrono::milliseconds(remainingMilliseconds));
+				continue;
+			}
+
+			lock.unlock();
+			try {
+				onIdle();
+			}
+			catch (...) {
+				Debug::getInstance().logErrorWithStracktrace("IdleTimer");
+			}
+			return;
+		}
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "Testing.h"
+
+namespace Profiler {
+	/**
+	 * Calls a callback on an own thread once no activity has been reported for a given time, e.g. to detach the profiler
+	 * once the coverage of a long-running process has saturated. The callback is called at most once.
+	 * All methods are thread-safe.
+	 */
+	class IdleTimer
+	{
+	public:
+		/** Starts the timer. The idle time starts now. */
+		EXPOSE_TO_CPP_TESTS IdleTimer(std::chrono::milliseconds idleTime, const std::function<void()>& onIdle);
+
+		/** Stops the timer, see stop(). */
+		EXPOSE_TO_CPP_TESTS ~IdleTimer();
+
+		IdleTimer(const IdleTimer&) = delete;
+		IdleTimer& operator=(const IdleTimer&) = delete;
+
+		/** Restarts the idle time. Only a single atomic store, so it may be called from hot paths. */
+		void reportActivity() {
+			lastActivity.store(now(), std::memory_order_relaxed);
+		}
+
+		/** Waits for a running callback to finish. The callback is not called afterwards. Must not be called by the callback. */
+		void EXPOSE_TO_CPP_TESTS stop();
+
+	private:
+		const long long idleMilliseconds;
+		std::function<void()> onIdle;
+		std::atomic<long long> lastActivity;
+		std::mutex mutex;
+		std::condition_variable condition;
+		bool isStopping = false;
+		std::unique_ptr<std::thread> thread;
+
+		void run();
+
+		/** Milliseconds of the steady clock. */
+		static long long now() {
+			return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+	};
+}
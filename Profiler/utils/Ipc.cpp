@@ -1,56 +1,95 @@
 #include "Ipc.h"
 #include "zmq.h"
-#include <chrono>
 
 namespace Profiler {
-	using namespace std::chrono_literals;
-
 	constexpr int IPC_TIMEOUT_MS = 1000;
-	constexpr int IPC_BUFFER_SIZE = 768;
+	constexpr long IPC_REGISTRATION_RETRY_INTERVAL_MS = 3000;
+	constexpr long IPC_RESYNC_INTERVAL_MS = 3000;
 	constexpr int IPC_LINGER = 0;
 
 	// Message signaling test start event
 	const std::string TEST_START = "start:";
 	const std::string TEST_END = "end:";
 
-	Ipc::Ipc(Config* config, const std::function<void(std::string)>& testStartCallback, const std::function<void(std::string, std::string)>& testEndCallback, const std::function<void(std::string)>& errorCallback) :
+	// Test events for a test context carry its ID, e.g. "start@3:<name>" or "end@3:<result>:<duration>"
+	const char TEST_CONTEXT_SEPARATOR = '@';
+
+	// Request for the test event last published, answered with its binary frame
+	const std::string RESYNC = "resync";
+
+	// Result of a test whose end event was lost
+	const std::string TEST_RESULT_UNKNOWN = "SKIPPED";
+
+	// Request carrying the coverage of an ended test in a second, binary frame
+	const std::string TEST_COVERAGE = "coverage";
+
+	// In-process address on which the handler thread is woken up. Each Ipc has its own ZMQ context, so this needn't be unique.
+	const char* WAKEUP_ADDRESS = "inproc://wakeup";
+
+	Ipc::Ipc(Config* config, const std::function<void(std::string, unsigned int)>& testStartCallback, const std::function<std::string(std::string, std::string, unsigned int)>& testEndCallback, const std::function<void(std::string)>& errorCallback) :
 		config(config),
 		testStartCallback(testStartCallback),
 		testEndCallback(testEndCallback),
 		errorCallback(errorCallback),
-		zmqContext(zmq_ctx_new()),
-		handlerThread(std::make_unique<std::thread>(&Ipc::handlerThreadLoop, this))
+		zmqContext(zmq_ctx_new())
 	{
+		// must be connected before the handler thread starts, as it may be shut down right away
+		this->zmqWakeupReceiver = zmq_socket(this->zmqContext, ZMQ_PAIR);
+		zmq_bind(this->zmqWakeupReceiver, WAKEUP_ADDRESS);
+		this->zmqWakeupSender = zmq_socket(this->zmqContext, ZMQ_PAIR);
+		zmq_setsockopt(this->zmqWakeupSender, ZMQ_LINGER, &IPC_LINGER, sizeof(IPC_LINGER));
+		zmq_connect(this->zmqWakeupSender, WAKEUP_ADDRESS);
+
+		this->handlerThread = std::make_unique<std::thread>(&Ipc::handlerThreadLoop, this);
 	}
 
 	Ipc::~Ipc()
 	{
 		this->shutdown = true;
+		zmq_send(this->zmqWakeupSender, "", 0, ZMQ_DONTWAIT);
 		if (this->handlerThread->joinable()) {
 			this->handlerThread->join();
 		}
-		this->request("profiler_disconnected");
+		if (this->isRegistered) {
+			// the coverage of the last test is only pending if the process exits right after it
+			sendPendingTestCoverage(false);
+			this->request("profiler_disconnected", false);
+		}
 		if (this->zmqRequestSocket != nullptr) {
 			zmq_close(this->zmqRequestSocket);
 		}
+		zmq_close(this->zmqWakeupSender);
+		zmq_close(this->zmqWakeupReceiver);
 		zmq_ctx_shutdown(this->zmqContext);
 		zmq_ctx_term(this->zmqContext);
 	}
 
 	void Ipc::handlerThreadLoop() {
+		if (this->config->getTiaSubscribeSocket().empty()) {
+			replyLoop();
+		}
+		else {
+			subscriberLoop();
+		}
+	}
+
+	void Ipc::replyLoop() {
 		std::string address = "";
 		while (address.empty() && !this->shutdown) {
 			std::string addressRequest = "register:" + std::to_string(GetCurrentProcessId());
 			address = this->request(addressRequest);
 			if (address.empty()) {
-				std::this_thread::sleep_for(3000ms);
 				logError("Connection failed, trying again.");
+				sleepInterruptibly(IPC_REGISTRATION_RETRY_INTERVAL_MS);
 			}
 		}
+		if (this->shutdown) {
+			return;
+		}
+		this->isRegistered = true;
 		handleMessage(getCurrentTestName());
 
 		this->zmqReplySocket = zmq_socket(this->zmqContext, ZMQ_REP);
-		zmq_setsockopt(this->zmqReplySocket, ZMQ_RCVTIMEO, &IPC_TIMEOUT_MS, sizeof(IPC_TIMEOUT_MS));
 		zmq_setsockopt(this->zmqReplySocket, ZMQ_LINGER, &IPC_LINGER, sizeof(IPC_LINGER));
 
 		if (!!zmq_bind(this->zmqReplySocket, address.c_str())) {
@@ -60,51 +99,226 @@ namespace Profiler {
 			return;
 		}
 		while (!this->shutdown) {
-			std::array<char, IPC_BUFFER_SIZE> buf;
-			int len = zmq_recv(this->zmqReplySocket, &buf, buf.size(), 0);
-			if (len != -1) {
-				std::string message(buf.data(), len);
+			if (!waitForMessage(this->zmqReplySocket, -1, true)) {
+				continue;
+			}
+			std::string message;
+			if (receive(this->zmqReplySocket, message)) {
 				handleMessage(message);
 				zmq_send(this->zmqReplySocket, "ack", 3, 0);
+				sendPendingTestCoverage(true);
 			}
 		}
 		zmq_close(this->zmqReplySocket);
 	}
 
+	void Ipc::subscriberLoop() {
+		void* subscriberSocket = zmq_socket(this->zmqContext, ZMQ_SUB);
+		zmq_setsockopt(subscriberSocket, ZMQ_LINGER, &IPC_LINGER, sizeof(IPC_LINGER));
+		zmq_setsockopt(subscriberSocket, ZMQ_SUBSCRIBE, "", 0);
+		if (zmq_connect(subscriberSocket, this->config->getTiaSubscribeSocket().c_str()) == -1) {
+			zmq_close(subscriberSocket);
+			logError("Failed connecting to subscribe socket");
+			return;
+		}
+
+		// Events published before the subscription took effect are lost, so we ask for the current state.
+		// Later events that this state already includes are skipped based on their sequence number.
+		resynchronize();
+
+		while (!this->shutdown) {
+			if (!waitForMessage(subscriberSocket, -1, true)) {
+				continue;
+			}
+			// The test runner does not wait for us, so several events may have queued up. They are applied in order.
+			std::string frame;
+			while (!this->shutdown && receive(subscriberSocket, frame)) {
+				TestEvent event;
+				if (!TestEvent::decode(frame.data(), frame.size(), event)) {
+					continue;
+				}
+				if (this->hasSequenceNumber && event.sequenceNumber <= this->lastSequenceNumber) {
+					continue;
+				}
+				if (this->hasSequenceNumber && event.sequenceNumber != this->lastSequenceNumber + 1) {
+					// we missed an event, the current state includes this one as well unless the resync fails
+					resynchronize();
+					if (event.sequenceNumber <= this->lastSequenceNumber) {
+						continue;
+					}
+				}
+				// Without a baseline, e.g. because the test runner did not answer the resync, the first event becomes it
+				this->hasSequenceNumber = true;
+				this->lastSequenceNumber = event.sequenceNumber;
+				applyEvent(event);
+			}
+			sendPendingTestCoverage(true);
+		}
+		zmq_close(subscriberSocket);
+	}
+
+	void Ipc::resynchronize() {
+		// A test runner that does not answer would otherwise block the handling of every event for the request timeout
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (this->hasResynchronized && now - this->lastResynchronization < std::chrono::milliseconds(IPC_RESYNC_INTERVAL_MS)) {
+			return;
+		}
+		this->hasResynchronized = true;
+		this->lastResynchronization = now;
+
+		std::string frame = this->request(RESYNC);
+		TestEvent event;
+		if (!TestEvent::decode(frame.data(), frame.size(), event)) {
+			return;
+		}
+		this->isRegistered = true;
+		this->hasSequenceNumber = true;
+		this->lastSequenceNumber = event.sequenceNumber;
+
+		// Only the last event is known, so we can only catch up on the process-wide test
+		if (event.contextId != 0) {
+			return;
+		}
+		if (event.type == TestEvent::Type::START) {
+			if (!this->isTestRunning || this->currentTestName != event.testName) {
+				applyEvent(event);
+			}
+		}
+		else if (this->isTestRunning) {
+			if (event.type != TestEvent::Type::END) {
+				event.type = TestEvent::Type::END;
+				event.result = TEST_RESULT_UNKNOWN;
+				event.durationMilliseconds = 0;
+			}
+			applyEvent(event);
+		}
+	}
+
+	void Ipc::applyEvent(const TestEvent& event) {
+		switch (event.type) {
+		case TestEvent::Type::START:
+			startTest(event.testName, event.contextId);
+			break;
+		case TestEvent::Type::END:
+			endTest(event.result, std::to_string(event.durationMilliseconds), event.contextId);
+			break;
+		default:
+			break;
+		}
+	}
+
 	void Ipc::handleMessage(const std::string& message) {
-		if (message.find(TEST_START) == 0) {
-			this->testStartCallback(message.substr(TEST_START.length()));
+		unsigned int contextId = 0;
+		std::string event = message;
+		size_t contextSeparator = message.find(TEST_CONTEXT_SEPARATOR);
+		size_t contextEnd = message.find(':');
+		if (contextSeparator != std::string::npos && contextSeparator < contextEnd && contextEnd != std::string::npos) {
+			try {
+				contextId = std::stoul(message.substr(contextSeparator + 1, contextEnd - contextSeparator - 1));
+			}
+			catch (...) {
+				logError("Ignoring test event with invalid test context: " + message);
+				return;
+			}
+			event = message.substr(0, contextSeparator) + message.substr(contextEnd);
+		}
+
+		if (event.find(TEST_START) == 0) {
+			startTest(event.substr(TEST_START.length()), contextId);
+		}
+		else if (event.find(TEST_END) == 0) {
+			size_t last = event.rfind(':');
+			std::string testIdentifier = event.substr(0, last);
+			std::string duration = event.substr(last + 1);
+			endTest(testIdentifier.substr(TEST_END.length()), duration, contextId);
+		}
+	}
+
+	void Ipc::startTest(const std::string& testName, unsigned int contextId) {
+		if (contextId == 0) {
+			this->currentTestName = testName;
+			this->isTestRunning = !this->currentTestName.empty();
+		}
+		this->testStartCallback(testName, contextId);
+	}
+
+	void Ipc::endTest(const std::string& result, const std::string& duration, unsigned int contextId) {
+		if (contextId == 0) {
+			this->isTestRunning = false;
 		}
-		else if (message.find(TEST_END) == 0) {
-			// 21 = maximum length of long + 1
-			size_t last = message.find_last_of(':', 21);
-			std::string testIdentifier = message.substr(0, last);
-			std::string duration = message.substr(last + 1);
-			this->testEndCallback(testIdentifier.substr(TEST_END.length()), duration);
+		std::string coverage = this->testEndCallback(result, duration, contextId);
+		if (!coverage.empty()) {
+			this->pendingTestCoverage.push_back(std::move(coverage));
 		}
 	}
 
+	void Ipc::sendPendingTestCoverage(bool isInterruptible) {
+		for (const std::string& coverage : this->pendingTestCoverage) {
+			if (this->request({ TEST_COVERAGE, coverage }, isInterruptible).empty()) {
+				// the coverage is still written to the trace file, so we rather drop it than delay the next test events
+				logError("The test runner did not acknowledge the test coverage");
+				break;
+			}
+		}
+		this->pendingTestCoverage.clear();
+	}
+
 	std::string Ipc::getCurrentTestName()
 	{
 		std::string testnameRequest = "testname";
 		return this->request(testnameRequest);
 	}
 
-	std::string Ipc::request(const std::string& message)
+	std::string Ipc::request(const std::string& message, bool isInterruptible)
+	{
+		return request(std::vector<std::string>{ message }, isInterruptible);
+	}
+
+	std::string Ipc::request(const std::vector<std::string>& frames, bool isInterruptible)
 	{
 		if (!initRequestSocket()) {
 			return "";
 		}
-		zmq_send(this->zmqRequestSocket, message.data(), message.size(), 0);
-		std::array<char, IPC_BUFFER_SIZE> buffer;
-		int len = zmq_recv(this->zmqRequestSocket, buffer.data(), buffer.size(), 0);
-		if (len < 0) {
+		for (size_t i = 0; i < frames.size(); i++) {
+			zmq_send(this->zmqRequestSocket, frames[i].data(), frames[i].size(), i + 1 < frames.size() ? ZMQ_SNDMORE : 0);
+		}
+		std::string reply;
+		if (!waitForMessage(this->zmqRequestSocket, IPC_TIMEOUT_MS, isInterruptible) || !receive(this->zmqRequestSocket, reply)) {
+			// the REQ socket cannot send again before it received the reply, so we start over with a new one
 			zmq_close(this->zmqRequestSocket);
 			this->zmqRequestSocket = nullptr;
 			return "";
 		}
+		return reply;
+	}
+
+	bool Ipc::receive(void* socket, std::string& message) {
+		zmq_msg_t zmqMessage;
+		zmq_msg_init(&zmqMessage);
+		int len = zmq_msg_recv(&zmqMessage, socket, ZMQ_DONTWAIT);
+		if (len != -1) {
+			message.assign(static_cast<const char*>(zmq_msg_data(&zmqMessage)), zmq_msg_size(&zmqMessage));
+		}
+		zmq_msg_close(&zmqMessage);
+		return len != -1;
+	}
+
+	bool Ipc::waitForMessage(void* socket, long timeoutMilliseconds, bool isInterruptible) {
+		// The wakeup message is never received, so it interrupts all following waits as well
+		zmq_pollitem_t items[] = {
+			{ socket, 0, ZMQ_POLLIN, 0 },
+			{ this->zmqWakeupReceiver, 0, ZMQ_POLLIN, 0 },
+		};
+		int itemCount = isInterruptible ? 2 : 1;
+		if (zmq_poll(items, itemCount, timeoutMilliseconds) <= 0) {
+			return false;
+		}
+		return (items[0].revents & ZMQ_POLLIN) != 0 && !(isInterruptible && this->shutdown);
+	}
 
-		return std::string(buffer.data(), len);
+	void Ipc::sleepInterruptibly(long timeoutMilliseconds) {
+		zmq_pollitem_t wakeup = { this->zmqWakeupReceiver, 0, ZMQ_POLLIN, 0 };
+		zmq_poll(&wakeup, 1, timeoutMilliseconds);
 	}
 
 	bool Ipc::initRequestSocket() {
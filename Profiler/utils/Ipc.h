@@ -1,9 +1,12 @@
 #pragma once
 #include "config/Config.h"
+#include "TestEvent.h"
 
 #include <thread>
 #include <atomic>
+#include <chrono>
 #include <functional>
+#include <vector>
 
 namespace Profiler {
 	/*
@@ -12,7 +15,12 @@ namespace Profiler {
 	class Ipc
 	{
 	public:
-		Ipc(Config* config, const std::function<void(std::string)>& testStartCallback, const std::function<void(std::string, std::string)>& testEndCallback, const std::function<void(std::string)>& errorCallback);
+		/**
+		 * The callbacks are called on the handler thread with the test context of the test event, 0 for the process-wide test.
+		 * The test end callback may return the encoded coverage of the ended test, which is then sent to the test runner
+		 * asynchronously, or the empty string.
+		 */
+		Ipc(Config* config, const std::function<void(std::string, unsigned int)>& testStartCallback, const std::function<std::string(std::string, std::string, unsigned int)>& testEndCallback, const std::function<void(std::string)>& errorCallback);
 		~Ipc();
 		/*
 		 * Returns the name of the currently running test when in testwise coverage mode.
@@ -22,17 +30,74 @@ namespace Profiler {
 		void* zmqContext = nullptr;
 		void* zmqRequestSocket = nullptr;
 		void* zmqReplySocket = nullptr;
+		/** Receives a message from zmqWakeupSender when the handler thread must stop waiting. Only used by the handler thread. */
+		void* zmqWakeupReceiver = nullptr;
+		void* zmqWakeupSender = nullptr;
 		Config* config = nullptr;
 		std::unique_ptr<std::thread> handlerThread;
-		std::function<void(std::string)> testStartCallback;
-		std::function<void(std::string, std::string)> testEndCallback;
+		std::function<void(std::string, unsigned int)> testStartCallback;
+		std::function<std::string(std::string, std::string, unsigned int)> testEndCallback;
 		std::function<void(std::string)> errorCallback;
-		std::atomic<bool> shutdown = false;
+		std::atomic<bool> shutdown{false};
+		/** Whether the profiler registered with the test runner, i.e. whether it must say goodbye. */
+		std::atomic<bool> isRegistered{false};
+		/** Only accessed by the handler thread. Refers to the process-wide test, not to tests in test contexts. */
+		bool isTestRunning = false;
+		std::string currentTestName;
+		bool hasSequenceNumber = false;
+		unsigned long long lastSequenceNumber = 0;
+		bool hasResynchronized = false;
+		std::chrono::steady_clock::time_point lastResynchronization;
+		/** Coverage frames of ended tests that have not been sent yet. Only accessed by the handler thread and after it finished. */
+		std::vector<std::string> pendingTestCoverage;
+
 		void handlerThreadLoop();
+
+		/** Registers with the test runner and receives the test events on an own REP socket, acknowledging each one. */
+		void replyLoop();
+
+		/** Receives the sequence-numbered test events that the test runner publishes to all profilers. */
+		void subscriberLoop();
+
+		/**
+		 * Requests the current test from the test runner after events may have been missed and catches up on it.
+		 * Does nothing if the last request was less than IPC_RESYNC_INTERVAL_MS ago. Keeps the current sequence number if the request fails.
+		 */
+		void resynchronize();
+
+		/** Starts or ends a test according to the given published event. */
+		void applyEvent(const TestEvent& event);
+
+		/** Handles a test event in the text protocol, e.g. "start:<name>", optionally with a test context, e.g. "start@3:<name>". */
 		void handleMessage(const std::string& message);
+
+		void startTest(const std::string& testName, unsigned int contextId);
+
+		void endTest(const std::string& result, const std::string& duration, unsigned int contextId);
+
+		/** Sends the coverage of the ended tests to the test runner. Drops the remaining ones if the test runner does not acknowledge one. */
+		void sendPendingTestCoverage(bool isInterruptible);
+
 		bool initRequestSocket();
 		void logError(const std::string& message);
-		std::string request(const std::string& message);
+
+		/** Receives the next message of any size from the given socket without blocking. Returns false if there is none. */
+		bool receive(void* socket, std::string& message);
+
+		/** Sends the given request and returns the reply or the empty string if there is none within the timeout. */
+		std::string request(const std::string& message, bool isInterruptible = true);
+
+		/** Sends the given frames as one multipart request and returns the reply or the empty string if there is none within the timeout. */
+		std::string request(const std::vector<std::string>& frames, bool isInterruptible);
+
+		/**
+		 * Waits until a message can be received from the given socket without blocking. Returns false if that does not
+		 * happen within the given timeout (-1 for none) or, if interruptible, the Ipc is shut down in the meantime.
+		 */
+		bool waitForMessage(void* socket, long timeoutMilliseconds, bool isInterruptible);
+
+		/** Sleeps for the given time or until the Ipc is shut down. */
+		void sleepInterruptibly(long timeoutMilliseconds);
 	};
 
 }
@@ -0,0 +1,121 @@
+#pragma once
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <mutex>
+#include <shared_mutex>
+#endif
+
+namespace Profiler {
+	/**
+	 * A recursive lock. Uses a critical section on Windows and a recursive mutex on other platforms, e.g. for CoreCLR
+	 * on Linux, so that code synchronizing with it does not depend on the Windows API.
+	 */
+	class Lock {
+	public:
+#ifdef _WIN32
+		Lock() {
+			InitializeCriticalSection(&section);
+		}
+
+		~Lock() {
+			DeleteCriticalSection(&section);
+		}
+
+		void enter() {
+			EnterCriticalSection(&section);
+		}
+
+		/** Enters the lock if no other thread owns it. Returns whether it was entered. */
+		bool tryEnter() {
+			return TryEnterCriticalSection(&section) != FALSE;
+		}
+
+		void leave() {
+			LeaveCriticalSection(&section);
+		}
+#else
+		Lock() = default;
+
+		~Lock() = default;
+
+		void enter() {
+			mutex.lock();
+		}
+
+		/** Enters the lock if no other thread owns it. Returns whether it was entered. */
+		bool tryEnter() {
+			return mutex.try_lock();
+		}
+
+		void leave() {
+			mutex.unlock();
+		}
+#endif
+
+		Lock(const Lock&) = delete;
+		Lock& operator=(const Lock&) = delete;
+
+	private:
+#ifdef _WIN32
+		CRITICAL_SECTION section;
+#else
+		std::recursive_mutex mutex;
+#endif
+	};
+
+	/**
+	 * A non-recursive lock that may be held shared by many readers or exclusively by one writer. Uses a slim reader/writer
+	 * lock on Windows, which is cheaper than a critical section, and a shared mutex on other platforms.
+	 */
+	class ReadWriteLock {
+	public:
+#ifdef _WIN32
+		ReadWriteLock() = default;
+
+		void enter() {
+			AcquireSRWLockExclusive(&lock);
+		}
+
+		void leave() {
+			ReleaseSRWLockExclusive(&lock);
+		}
+
+		void enterShared() {
+			AcquireSRWLockShared(&lock);
+		}
+
+		void leaveShared() {
+			ReleaseSRWLockShared(&lock);
+		}
+#else
+		ReadWriteLock() = default;
+
+		void enter() {
+			mutex.lock();
+		}
+
+		void leave() {
+			mutex.unlock();
+		}
+
+		void enterShared() {
+			mutex.lock_shared();
+		}
+
+		void leaveShared() {
+			mutex.unlock_shared();
+		}
+#endif
+
+		ReadWriteLock(const ReadWriteLock&) = delete;
+		ReadWriteLock& operator=(const ReadWriteLock&) = delete;
+
+	private:
+#ifdef _WIN32
+		SRWLOCK lock = SRWLOCK_INIT;
+#else
+		std::shared_timed_mutex mutex;
+#endif
+	};
+}
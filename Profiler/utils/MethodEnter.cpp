@@ -2,18 +2,145 @@
 #include <iostream>
 #include "Debug.h"
 
+#ifdef _MSC_VER
+#define NOINLINE __declspec(noinline)
+#else
+#define NOINLINE __attribute__((noinline))
+#endif
+
 namespace Profiler {
 	namespace {
 		FunctionIdSet* calledFunctionSet;
+		FunctionIdCounter* calledFunctionCounter = nullptr;
 		bool isTestCaseRecording = false;
-		CRITICAL_SECTION* methodSetSynchronization;
+
+		/**
+		 * Whether the process-wide test case or a test context is recording. Checked first by the enter hooks,
+		 * so that they return right away while no test runs.
+		 */
+		volatile bool isAnyRecording = false;
+
+		/** Number of test contexts with a running test. Only changed by setTestContextRecording. */
+		unsigned int recordingTestContexts = 0;
+		Lock* methodSetSynchronization;
+		unsigned int samplingInterval = 0;
+		CallbackRecorder* callbackRecorder = nullptr;
+
+		/** Where the threads of a test context record their calls. Both null while no test runs in the context. */
+		struct TestContextRecording {
+			FunctionIdSet* volatile calledFunctionSet;
+			FunctionIdCounter* volatile calledFunctionCounter;
+
+			/**
+			 * Incremented whenever a test starts or stops in the context. The slow paths check it under the lock, so that a thread
+			 * that was still inside the enter hook when the test ended doesn't add its call after the test's calls were collected.
+			 * The call would otherwise leak into the next test of the context, which reuses the set or counter.
+			 */
+			volatile unsigned int generation;
+		};
+
+		TestContextRecording testContexts[MAX_TEST_CONTEXT_ID + 1] = {};
+
+		/** The test context that the current thread is bound to, 0 for none. */
+		thread_local unsigned int boundTestContextId = 0;
+
+		/** Number of calls on the current thread that are skipped before the next one is recorded. */
+		thread_local unsigned int callsUntilNextSample = 0;
+
+		/** State of the per-thread xorshift generator that randomizes the sampling distance. */
+		thread_local unsigned int randomState = 0;
+
+		/**
+		 * Whether the current call should be recorded. With sampling enabled, the distance between two
+		 * recorded calls on a thread is drawn uniformly from [1, 2 * samplingInterval - 1], so that on
+		 * average one in samplingInterval calls is recorded without locking onto periodic call patterns.
+		 */
+		inline bool shouldSample() {
+			if (samplingInterval <= 1) {
+				return true;
+			}
+			if (callsUntilNextSample > 0) {
+				callsUntilNextSample--;
+				return false;
+			}
+
+			if (randomState == 0) {
+				randomState = GetCurrentThreadId() | 1;
+			}
+			randomState ^= randomState << 13;
+			randomState ^= randomState >> 17;
+			randomState ^= randomState << 5;
+			callsUntilNextSample = randomState % (2 * samplingInterval - 1);
+			return true;
+		}
+
+		/** Whether the test for which the enter hook picked its set or counter is still running. Must be called with the lock held. */
+		inline bool isSameTest(unsigned int contextId, unsigned int generation) {
+			return contextId == 0 || testContexts[contextId].generation == generation;
+		}
+
+		/** Slow path of the first call of a method in a test, kept out of line so the enter hook stays small. */
+		NOINLINE void addFirstCall(FunctionIdSet* set, FunctionID functionId, unsigned int contextId, unsigned int generation) {
+			methodSetSynchronization->enter();
+			if (isSameTest(contextId, generation)) {
+				set->insert(functionId);
+			}
+			methodSetSynchronization->leave();
+		}
+
+		/** Slow path of the first call of a method in a test when counting calls. */
+		NOINLINE void addFirstCount(FunctionIdCounter* counter, FunctionID functionId, unsigned int contextId, unsigned int generation) {
+			methodSetSynchronization->enter();
+			if (isSameTest(contextId, generation)) {
+				counter->add(functionId);
+			}
+			methodSetSynchronization->leave();
+		}
+
+		void updateIsAnyRecording() {
+			isAnyRecording = isTestCaseRecording || recordingTestContexts > 0;
+		}
 	}
 
-	extern "C" void _stdcall EnterCpp(FunctionIDOrClientID funcId) {
-		if (isTestCaseRecording && !calledFunctionSet->contains(funcId.functionID)) {
-			EnterCriticalSection(methodSetSynchronization);
-			calledFunctionSet->insert(funcId.functionID);
-			LeaveCriticalSection(methodSetSynchronization);
+	extern "C" void __stdcall EnterCpp(FunctionIDOrClientID funcId) {
+		if (!isAnyRecording) {
+			return;
+		}
+		FunctionIdSet* set = calledFunctionSet;
+		FunctionIdCounter* counter = calledFunctionCounter;
+		bool isRecording = isTestCaseRecording;
+		unsigned int contextId = 0;
+		unsigned int generation = 0;
+		if (boundTestContextId != 0) {
+			// Threads of a context without a running test record into the process-wide test case like all others
+			const TestContextRecording& context = testContexts[boundTestContextId];
+			// Read before the set and counter, so that a generation that is still current under the lock belongs to the same test
+			unsigned int contextGeneration = context.generation;
+			FunctionIdSet* contextSet = context.calledFunctionSet;
+			FunctionIdCounter* contextCounter = context.calledFunctionCounter;
+			if (contextSet != nullptr || contextCounter != nullptr) {
+				set = contextSet;
+				counter = contextCounter;
+				isRecording = true;
+				contextId = boundTestContextId;
+				generation = contextGeneration;
+			}
+		}
+		if (!isRecording || !shouldSample()) {
+			return;
+		}
+
+		if (counter != nullptr) {
+			std::atomic<LONG>* count = counter->find(funcId.functionID);
+			if (count != nullptr) {
+				FunctionIdCounter::increment(count);
+			}
+			else {
+				addFirstCount(counter, funcId.functionID, contextId, generation);
+			}
+		}
+		else if (!set->contains(funcId.functionID)) {
+			addFirstCall(set, funcId.functionID, contextId, generation);
 		}
 	}
 
@@ -21,24 +148,114 @@ namespace Profiler {
 		calledFunctionSet = setToUse;
 	}
 
-	void setCriticalSection(CRITICAL_SECTION* methodSetSync) {
+	void setCalledMethodsCounter(FunctionIdCounter* counterToUse) {
+		calledFunctionCounter = counterToUse;
+	}
+
+	void setSamplingInterval(unsigned int interval) {
+		samplingInterval = interval;
+	}
+
+	void setCallbackRecorder(CallbackRecorder* recorder) {
+		callbackRecorder = recorder;
+	}
+
+	extern "C" void __stdcall EnterRecordingCpp(FunctionIDOrClientID funcId) {
+		callbackRecorder->record(RecordedCallback::Type::ENTER, funcId.functionID);
+		EnterCpp(funcId);
+	}
+
+	void setLock(Lock* methodSetSync) {
 		methodSetSynchronization = methodSetSync;
 	}
 
+	void drainCalledMethods(FunctionIdSet& set, std::vector<FunctionID>& functionIds) {
+		methodSetSynchronization->enter();
+		for (unsigned int i = 0; i < set.size(); i++) {
+			FunctionID value = set.at(i);
+			if (value != 0) {
+				functionIds.push_back(value);
+			}
+		}
+		set.clear();
+		methodSetSynchronization->leave();
+	}
+
 	void setTestCaseRecording(bool testCaseRecording) {
 		isTestCaseRecording = testCaseRecording;
+		updateIsAnyRecording();
+	}
+
+	void setTestContextRecording(unsigned int contextId, FunctionIdSet* setToUse, FunctionIdCounter* counterToUse) {
+		if (contextId == 0 || contextId > MAX_TEST_CONTEXT_ID) {
+			return;
+		}
+		TestContextRecording& context = testContexts[contextId];
+		bool wasRecording = context.calledFunctionSet != nullptr || context.calledFunctionCounter != nullptr;
+		bool isRecording = setToUse != nullptr || counterToUse != nullptr;
+		if (isRecording && !wasRecording) {
+			recordingTestContexts++;
+		}
+		else if (!isRecording && wasRecording) {
+			recordingTestContexts--;
+		}
+
+		// Starting to record must be visible before the hooks stop skipping calls, stopping the other way round.
+		// The generation changes before a new set is published and after the old one is withdrawn, so that every hook
+		// that picked up the old set has also read the old generation.
+		if (isRecording) {
+			context.generation++;
+			context.calledFunctionSet = setToUse;
+			context.calledFunctionCounter = counterToUse;
+			updateIsAnyRecording();
+		}
+		else {
+			updateIsAnyRecording();
+			context.calledFunctionSet = setToUse;
+			context.calledFunctionCounter = counterToUse;
+			context.generation++;
+		}
+	}
+
+	extern "C" void __stdcall SetTestContext(unsigned int contextId) {
+		boundTestContextId = contextId <= MAX_TEST_CONTEXT_ID ? contextId : 0;
 	}
 
 #ifdef _WIN64
 
+	// Checks the flag before calling into EnterCpp, so that the compiler emits a compare and return without a stack frame
+	// for the calls outside of tests and a tail call otherwise
 	void __fastcall FnEnterCallback(FunctionIDOrClientID funcId) {
-		EnterCpp(funcId);
+		if (isAnyRecording) {
+			EnterCpp(funcId);
+		}
 	}
 
-#else
+	void __fastcall FnEnterRecordingCallback(FunctionIDOrClientID funcId) {
+		EnterRecordingCpp(funcId);
+	}
+
+#elif defined(__x86_64__)
+
+	// System V x64, e.g. CoreCLR on Linux, passes the function ID in RDI like the first argument of any other function
+	void FnEnterCallback(FunctionIDOrClientID funcId) {
+		if (isAnyRecording) {
+			EnterCpp(funcId);
+		}
+	}
+
+	void FnEnterRecordingCallback(FunctionIDOrClientID funcId) {
+		EnterRecordingCpp(funcId);
+	}
+
+#elif defined(_M_IX86)
 
+	// The x86 hook must preserve the volatile registers, which only the inline assembler of MSVC can do without a stack frame
 	void __declspec(naked) FnEnterCallback(FunctionIDOrClientID funcId) {
 		__asm {
+			// Outside of tests, return before saving any registers
+			CMP BYTE PTR isAnyRecording, 0
+			JE skip
 			PUSH EAX
 			PUSH ECX
 			PUSH EDX
@@ -47,10 +264,27 @@ namespace Profiler {
 			POP EDX
 			POP ECX
 			POP EAX
+		skip:
+			RET 4
+		}
+	}
+
+	void __declspec(naked) FnEnterRecordingCallback(FunctionIDOrClientID funcId) {
+		__asm {
+			PUSH EAX
+			PUSH ECX
+			PUSH EDX
+			PUSH[ESP + 16]
+			CALL EnterRecordingCpp
+			POP EDX
+			POP ECX
+			POP EAX
 			RET 4
 		}
 	}
 
+#else
+#error "The enter hook has no stub for the calling convention of this platform"
 #endif
 }
 
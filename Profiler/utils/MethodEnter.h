@@ -2,35 +2,94 @@
 #include "FunctionInfo.h"
 #include <cor.h>
 #include <corprof.h>
+#ifdef _WIN32
 #include <windows.h>
+#endif
 #include <functional>
+#include <vector>
+#include "utils/Lock.h"
+#include "utils/CallbackRecorder.h"
+#include "utils/Testing.h"
 #include <utils/FunctionIdSet/FunctionIdSet.h>
+#include <utils/FunctionIdSet/FunctionIdCounter.h>
 
 namespace Profiler {
 	FunctionID constexpr NIL = static_cast<FunctionID>(-1);
 
+	/** Test contexts are numbered from 1 to this number. Context 0 is the process-wide test case. */
+	unsigned int constexpr MAX_TEST_CONTEXT_ID = 256;
+
 	/**
 	 * Sets the vector to be filled with methodIds from called methods at this time.
 	 */
-	void setCalledMethodsSet(FunctionIdSet*);
+	void EXPOSE_TO_CPP_TESTS setCalledMethodsSet(FunctionIdSet*);
+
+	/**
+	 * Sets the counter to be incremented for every called method. If set, it is used instead of the set.
+	 */
+	void EXPOSE_TO_CPP_TESTS setCalledMethodsCounter(FunctionIdCounter*);
+
+	/*
+	 * Sets how many calls are skipped on average for each recorded call. 0 or 1 record every call.
+	 * Only applies to calls during a test case or in a test context, no calls are recorded outside of tests.
+	 */
+	void EXPOSE_TO_CPP_TESTS setSamplingInterval(unsigned int);
 
 	/*
-	 * Sets the critical section for synchronization of the function id set.
+	 * Sets the lock for synchronization of the function id set.
+	 */
+	void EXPOSE_TO_CPP_TESTS setLock(Lock*);
+
+	/**
+	 * Appends the functions recorded in the given set to the given vector and empties the set, like at the end of a test.
+	 * Holds the lock set with setLock only while copying, so that the enter hooks are blocked as briefly as possible.
 	 */
-	void setCriticalSection(CRITICAL_SECTION*);
+	void EXPOSE_TO_CPP_TESTS drainCalledMethods(FunctionIdSet& set, std::vector<FunctionID>& functionIds);
 
 	/*
 	 * Sets the state of test case recording i.e. whether a test case is currently in progress or not.
 	 */
-	void setTestCaseRecording(bool);
+	void EXPOSE_TO_CPP_TESTS setTestCaseRecording(bool);
+
+	/**
+	 * Sets the set or, if not null, the counter to be filled by the threads bound to the given test context, which must not be 0.
+	 * Both null stops recording the context, so that its threads record into the process-wide test case again.
+	 * The set and counter must never be freed, as threads may still be recording into them.
+	 */
+	void EXPOSE_TO_CPP_TESTS setTestContextRecording(unsigned int contextId, FunctionIdSet*, FunctionIdCounter*);
+
+	/**
+	 * Binds the calling thread to the given test context, so that its calls are recorded for the test running in the context.
+	 * 0 unbinds it. Exported for the managed helper that binds the threads and async flows of concurrently running tests.
+	 */
+	EXTERN_C void __stdcall SetTestContext(unsigned int contextId);
+
+	/**
+	 * Sets the recorder to which FnEnterRecordingCallback records the calls before handling them.
+	 */
+	void setCallbackRecorder(CallbackRecorder*);
+
+	/**
+	 * Handles a method enter event like the enter hook. Exported so the replay of recorded callbacks can drive it.
+	 */
+	EXTERN_C void EXPOSE_TO_CPP_TESTS __stdcall EnterCpp(FunctionIDOrClientID);
 
 	/*
 	 * The callback function that is run on a method enter event.
 	 */
-#ifdef _WIN64
+#if defined(_WIN64) || defined(__x86_64__)
 	EXTERN_C void FnEnterCallback(FunctionIDOrClientID);
 #else
 	void FnEnterCallback(FunctionIDOrClientID);
 #endif
+
+	/*
+	 * The enter hook that additionally records each call with the recorder set by setCallbackRecorder.
+	 */
+#if defined(_WIN64) || defined(__x86_64__)
+	EXTERN_C void FnEnterRecordingCallback(FunctionIDOrClientID);
+#else
+	void FnEnterRecordingCallback(FunctionIDOrClientID);
+#endif
 }
 
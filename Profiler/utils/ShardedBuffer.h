@@ -0,0 +1,81 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <functional>
+#include <iterator>
+#include <thread>
+#include <vector>
+#include "utils/Lock.h"
+
+namespace Profiler {
+	/// <summary>
+	/// Buffer that many threads may append to without waiting for each other.
+	/// Elements are spread over a fixed number of shards by the ID of the appending thread, so that
+	/// every thread effectively has its own buffer and only contends with the rare other thread that
+	/// maps to the same shard. The elements are collected by a single owner with drainTo().
+	/// The order of elements appended by different threads is not preserved.
+	/// </summary>
+	template<typename T>
+	class ShardedBuffer final
+	{
+	private:
+		const static unsigned int SHARD_COUNT = 16;
+
+		/// <summary>
+		/// A lock and the elements it protects. The padding keeps the locks of neighbouring shards on
+		/// different cache lines, so that threads using different shards do not slow each other down.
+		/// </summary>
+		struct Shard {
+			ReadWriteLock lock;
+			std::vector<T> elements;
+			char padding[64];
+		};
+
+		std::array<Shard, SHARD_COUNT> shards;
+
+		/// <summary>
+		/// Number of elements in all shards. Maintained separately so that reading it needs no lock.
+		/// </summary>
+		std::atomic<long> numElements{0};
+
+	public:
+		ShardedBuffer() = default;
+
+		ShardedBuffer(const ShardedBuffer&) = delete;
+		ShardedBuffer& operator=(const ShardedBuffer&) = delete;
+
+		/// <summary>
+		/// Appends the given element to the shard of the current thread and returns the number of
+		/// elements in the whole buffer afterwards.
+		/// </summary>
+		long push(const T& element) {
+			Shard& shard = shards[std::hash<std::thread::id>()(std::this_thread::get_id()) % SHARD_COUNT];
+			shard.lock.enter();
+			shard.elements.push_back(element);
+			shard.lock.leave();
+			return ++numElements;
+		}
+
+		/// <summary>
+		/// Moves all elements to the end of the given vector. Each shard is only locked while its elements
+		/// are moved, so appending threads are never blocked for the whole drain.
+		/// </summary>
+		void drainTo(std::vector<T>& target) {
+			for (Shard& shard : shards) {
+				shard.lock.enter();
+				long count = static_cast<long>(shard.elements.size());
+				target.insert(target.end(), std::make_move_iterator(shard.elements.begin()), std::make_move_iterator(shard.elements.end()));
+				shard.elements.clear();
+				shard.lock.leave();
+				numElements -= count;
+			}
+		}
+
+		/// <summary>
+		/// Number of elements in the buffer. Lock-free, so the result may already be outdated when it is returned.
+		/// </summary>
+		long size() {
+			return numElements;
+		}
+	};
+}
@@ -25,8 +25,31 @@ namespace Profiler {
 		return result;
 	}
 
+	std::string StringUtils::lowercase(std::string const& value)
+	{
+		std::string result(value);
+		std::transform(result.begin(), result.end(), result.begin(), ::tolower);
+		return result;
+	}
+
 	bool StringUtils::equalsIgnoreCase(std::string const& value1, std::string const& value2) {
-		return uppercase(value1) == uppercase(value2);
+		return CaseInsensitiveEquality()(value1, value2);
+	}
+
+	std::vector<std::string> StringUtils::split(std::string const& value, char separator) {
+		std::vector<std::string> parts;
+		size_t start = 0;
+		while (start <= value.length()) {
+			size_t end = value.find(separator, start);
+			if (end == std::string::npos) {
+				end = value.length();
+			}
+			if (end > start) {
+				parts.push_back(value.substr(start, end - start));
+			}
+			start = end + 1;
+		}
+		return parts;
 	}
 
 	bool StringUtils::endsWithCaseInsensitive(std::string const& value, std::string const& suffix)
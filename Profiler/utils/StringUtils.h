@@ -2,8 +2,10 @@
 
 #include <string>
 #include <algorithm>
+#include <cstring>
 #include <map>
 #include <set>
+#include <vector>
 #include "Testing.h"
 
 namespace Profiler {
@@ -23,17 +25,72 @@ namespace Profiler {
 		/** Whether the given strings are equal regardless of casing. */
 		static EXPOSE_TO_CPP_TESTS bool equalsIgnoreCase(std::string const& value1, std::string const& value2);
 
+		/** Splits the given string at the given separator and drops empty parts. */
+		static EXPOSE_TO_CPP_TESTS std::vector<std::string> split(std::string const& value, char separator);
+
 		/** Returns a new string that is the uppercase variant of the given string. */
 		static EXPOSE_TO_CPP_TESTS std::string StringUtils::uppercase(std::string const& value);
 
-		/** Compares strings regardless of their casing. */
+		/** Returns a new string that is the lowercase variant of the given string. */
+		static EXPOSE_TO_CPP_TESTS std::string lowercase(std::string const& value);
+
+		/**
+		 * Compares strings regardless of their casing without copying them.
+		 * Transparent, so maps and sets can be searched with string literals without constructing a std::string.
+		 */
 		struct CaseInsensitiveComparator {
+			typedef void is_transparent;
+
 			bool operator() (const std::string& s1, const std::string& s2) const {
-				std::string str1(s1.length(), ' ');
-				std::string str2(s2.length(), ' ');
-				std::transform(s1.begin(), s1.end(), str1.begin(), ::tolower);
-				std::transform(s2.begin(), s2.end(), str2.begin(), ::tolower);
-				return  str1 < str2;
+				return compare(s1.c_str(), s1.length(), s2.c_str(), s2.length()) < 0;
+			}
+
+			bool operator() (const char* s1, const std::string& s2) const {
+				return compare(s1, strlen(s1), s2.c_str(), s2.length()) < 0;
+			}
+
+			bool operator() (const std::string& s1, const char* s2) const {
+				return compare(s1.c_str(), s1.length(), s2, strlen(s2)) < 0;
+			}
+
+			bool operator() (const char* s1, const char* s2) const {
+				return compare(s1, strlen(s1), s2, strlen(s2)) < 0;
+			}
+
+			static int compare(const char* s1, size_t length1, const char* s2, size_t length2) {
+				size_t length = length1 < length2 ? length1 : length2;
+				for (size_t i = 0; i < length; i++) {
+					int c1 = foldCase(s1[i]);
+					int c2 = foldCase(s2[i]);
+					if (c1 != c2) {
+						return c1 - c2;
+					}
+				}
+				return length1 < length2 ? -1 : (length1 > length2 ? 1 : 0);
+			}
+
+			/** Lowercases ASCII letters like tolower in the "C" locale, but without the function call. */
+			static int foldCase(char c) {
+				unsigned char value = static_cast<unsigned char>(c);
+				return value >= 'A' && value <= 'Z' ? value + ('a' - 'A') : value;
+			}
+		};
+
+		/** Hashes strings regardless of their casing without copying them. Consistent with CaseInsensitiveEquality. */
+		struct CaseInsensitiveHash {
+			size_t operator() (const std::string& value) const {
+				size_t hash = 2166136261U;
+				for (char c : value) {
+					hash = (hash ^ static_cast<size_t>(CaseInsensitiveComparator::foldCase(c))) * 16777619U;
+				}
+				return hash;
+			}
+		};
+
+		/** Whether strings are equal regardless of their casing without copying them. */
+		struct CaseInsensitiveEquality {
+			bool operator() (const std::string& s1, const std::string& s2) const {
+				return s1.length() == s2.length() && CaseInsensitiveComparator::compare(s1.c_str(), s1.length(), s2.c_str(), s2.length()) == 0;
 			}
 		};
 	};
@@ -43,5 +100,8 @@ namespace Profiler {
 
 	/** A set of strings that ignores the casing of its entries. */
 	typedef std::set<std::string, StringUtils::CaseInsensitiveComparator> CaseInsensitiveStringSet;
+
+	/** A set of string literals that ignores their casing. Only the pointers are stored, so the strings must outlive the set. */
+	typedef std::set<const char*, StringUtils::CaseInsensitiveComparator> CaseInsensitiveLiteralSet;
 }
 
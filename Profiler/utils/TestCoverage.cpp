@@ -0,0 +1,72 @@
+#include "TestCoverage.h"
+#include <algorithm>
+
+namespace Profiler {
+	namespace {
+		const unsigned char FORMAT_VERSION = 1;
+
+		void writeUInt32(std::string& frame, size_t value) {
+			for (int i = 0; i < 4; i++) {
+				frame += static_cast<char>((value >> (8 * i)) & 0xFF);
+			}
+		}
+
+		void writeString(std::string& frame, const std::string& value) {
+			writeUInt32(frame, value.size());
+			frame += value;
+		}
+
+		/** Writes 7 bits per byte, lowest first, with the highest bit set on all but the last byte. */
+		void writeVarint(std::string& frame, unsigned long value) {
+			while (value >= 0x80) {
+				frame += static_cast<char>((value & 0x7F) | 0x80);
+				value >>= 7;
+			}
+			frame += static_cast<char>(value);
+		}
+	}
+
+	std::string TestCoverage::encode(const std::string& testName, std::vector<FunctionInfo> methods,
+		const std::function<std::string(int)>& getAssemblyName) {
+		methods.erase(std::remove_if(methods.begin(), methods.end(), [](const FunctionInfo& method) {
+			return method.assemblyNumber == 0;
+			}), methods.end());
+		std::sort(methods.begin(), methods.end(), [](const FunctionInfo& first, const FunctionInfo& second) {
+			return first.assemblyNumber < second.assemblyNumber
+				|| (first.assemblyNumber == second.assemblyNumber && first.functionToken < second.functionToken);
+			});
+		methods.erase(std::unique(methods.begin(), methods.end(), [](const FunctionInfo& first, const FunctionInfo& second) {
+			return first.assemblyNumber == second.assemblyNumber && first.functionToken == second.functionToken;
+			}), methods.end());
+
+		std::string frame;
+		frame += static_cast<char>(FORMAT_VERSION);
+		writeString(frame, testName);
+
+		size_t assemblyCountPosition = frame.size();
+		size_t assemblyCount = 0;
+		writeUInt32(frame, 0);
+		for (size_t begin = 0; begin < methods.size();) {
+			int assemblyNumber = methods[begin].assemblyNumber;
+			size_t end = begin;
+			while (end < methods.size() && methods[end].assemblyNumber == assemblyNumber) {
+				end++;
+			}
+
+			writeString(frame, getAssemblyName(assemblyNumber));
+			writeUInt32(frame, end - begin);
+			unsigned long previousToken = 0;
+			for (size_t i = begin; i < end; i++) {
+				writeVarint(frame, methods[i].functionToken - previousToken);
+				previousToken = methods[i].functionToken;
+			}
+			assemblyCount++;
+			begin = end;
+		}
+
+		std::string count;
+		writeUInt32(count, assemblyCount);
+		frame.replace(assemblyCountPosition, count.size(), count);
+		return frame;
+	}
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+#include "FunctionInfo.h"
+#include "Testing.h"
+
+namespace Profiler {
+	/**
+	 * Encodes the methods called during a test as a compact binary frame that is sent to the test runner right after the test ended:
+	 *
+	 *   version (1 byte), test name length (4 bytes) and UTF-8 bytes, assembly count (4 bytes), and per assembly:
+	 *   name length (4 bytes) and UTF-8 bytes, method count (4 bytes), method tokens as LEB128 varints
+	 *
+	 * Each token is stored as the difference to the previous token of the same assembly, as tokens are sorted ascendingly.
+	 * All numbers are little-endian. Must match TestCoverage.cs.
+	 */
+	class TestCoverage {
+	public:
+		/**
+		 * Encodes the given methods, which may contain duplicates. Methods of assembly number 0, i.e. that could not be resolved,
+		 * are left out. The given function returns the UTF-8 name of an assembly number.
+		 */
+		static EXPOSE_TO_CPP_TESTS std::string encode(const std::string& testName, std::vector<FunctionInfo> methods,
+			const std::function<std::string(int)>& getAssemblyName);
+	};
+}
@@ -0,0 +1,87 @@
+#include "TestEvent.h"
+
+namespace Profiler {
+	namespace {
+		const unsigned char FORMAT_VERSION = 1;
+
+		void writeNumber(std::string& frame, unsigned long long value, size_t byteCount) {
+			for (size_t i = 0; i < byteCount; i++) {
+				frame += static_cast<char>((value >> (8 * i)) & 0xFF);
+			}
+		}
+
+		void writeString(std::string& frame, const std::string& value) {
+			writeNumber(frame, value.size(), 4);
+			frame += value;
+		}
+
+		/** Reads the fields of a frame in order. All read methods return false if the frame ends prematurely. */
+		class FrameReader {
+		public:
+			FrameReader(const unsigned char* data, size_t size) : data(data), size(size) {}
+
+			bool readNumber(unsigned long long& value, size_t byteCount) {
+				if (size - position < byteCount) {
+					return false;
+				}
+				value = 0;
+				for (size_t i = 0; i < byteCount; i++) {
+					value |= static_cast<unsigned long long>(data[position + i]) << (8 * i);
+				}
+				position += byteCount;
+				return true;
+			}
+
+			bool readString(std::string& value) {
+				unsigned long long length = 0;
+				if (!readNumber(length, 4) || size - position < length) {
+					return false;
+				}
+				value.assign(reinterpret_cast<const char*>(data + position), static_cast<size_t>(length));
+				position += static_cast<size_t>(length);
+				return true;
+			}
+
+		private:
+			const unsigned char* data;
+			size_t size;
+			size_t position = 0;
+		};
+	}
+
+	std::string TestEvent::encode() const {
+		std::string frame;
+		frame.reserve(38 + testName.size() + result.size());
+		writeNumber(frame, FORMAT_VERSION, 1);
+		writeNumber(frame, static_cast<unsigned char>(type), 1);
+		writeNumber(frame, sequenceNumber, 8);
+		writeNumber(frame, static_cast<unsigned long long>(timestamp), 8);
+		writeNumber(frame, static_cast<unsigned long long>(durationMilliseconds), 8);
+		writeNumber(frame, contextId, 4);
+		writeString(frame, testName);
+		writeString(frame, result);
+		return frame;
+	}
+
+	bool TestEvent::decode(const void* data, size_t size, TestEvent& event) {
+		FrameReader reader(static_cast<const unsigned char*>(data), size);
+		unsigned long long version = 0;
+		unsigned long long type = 0;
+		unsigned long long timestamp = 0;
+		unsigned long long duration = 0;
+		unsigned long long contextId = 0;
+		TestEvent decoded;
+		if (!reader.readNumber(version, 1) || version != FORMAT_VERSION || !reader.readNumber(type, 1)
+			|| type > static_cast<unsigned char>(Type::END) || !reader.readNumber(decoded.sequenceNumber, 8)
+			|| !reader.readNumber(timestamp, 8) || !reader.readNumber(duration, 8) || !reader.readNumber(contextId, 4)
+			|| !reader.readString(decoded.testName) || !reader.readString(decoded.result)) {
+			return false;
+		}
+		decoded.type = static_cast<Type>(type);
+		decoded.timestamp = static_cast<long long>(timestamp);
+		decoded.durationMilliseconds = static_cast<long long>(duration);
+		decoded.contextId = static_cast<unsigned int>(contextId);
+		event = decoded;
+		return true;
+	}
+}
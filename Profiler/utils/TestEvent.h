@@ -0,0 +1,48 @@
+#pragma once
+#include <string>
+#include "Testing.h"
+
+namespace Profiler {
+	/**
+	 * A test event that the test runner publishes to subscribed profilers, encoded as a binary frame:
+	 *
+	 *   version (1 byte), type (1 byte), sequence number (8 bytes), timestamp (8 bytes), duration (8 bytes),
+	 *   test context (4 bytes), test name length (4 bytes) and UTF-8 bytes, result length (4 bytes) and UTF-8 bytes
+	 *
+	 * All numbers are little-endian. Must match TestEvent.cs.
+	 */
+	struct TestEvent {
+		enum class Type : unsigned char {
+			/** Not an actual event, only carries the sequence number, e.g. in the reply to a resync request if nothing happened yet. */
+			NONE = 0,
+			START = 1,
+			END = 2,
+		};
+
+		Type type = Type::NONE;
+
+		/** Increases by one with every published event, so lost events can be detected. */
+		unsigned long long sequenceNumber = 0;
+
+		/** When the test runner published the event, in milliseconds since the Unix epoch. */
+		long long timestamp = 0;
+
+		/** The name of the started test. Empty for other events. */
+		std::string testName;
+
+		/** The result of the ended test, e.g. PASSED. Empty for other events. */
+		std::string result;
+
+		/** The duration of the ended test in milliseconds. */
+		long long durationMilliseconds = 0;
+
+		/** The test context the test runs in or 0 for the process-wide test. */
+		unsigned int contextId = 0;
+
+		/** Encodes this event as a binary frame. */
+		std::string EXPOSE_TO_CPP_TESTS encode() const;
+
+		/** Decodes the given binary frame. Returns false if it is malformed or has an unsupported version. */
+		static EXPOSE_TO_CPP_TESTS bool decode(const void* data, size_t size, TestEvent& event);
+	};
+}
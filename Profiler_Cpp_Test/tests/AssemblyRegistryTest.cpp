@@ -0,0 +1,110 @@
+#include "CppUnitTest.h"
+#include <atomic>
+#include <chrono>
+#include <cor.h>
+#include <corprof.h>
+#include <map>
+#include <string>
+#include <thread>
+#include "utils/AssemblyRegistry.h"
+
+using namespace Profiler;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+TEST_CLASS(AssemblyRegistryTest)
+{
+public:
+
+	TEST_METHOD(NumbersAssembliesInRegistrationOrder)
+	{
+		AssemblyRegistry registry;
+		Assert::AreEqual(1, registry.registerAssembly(0x1000));
+		Assert::AreEqual(2, registry.registerAssembly(0x2000));
+
+		Assert::AreEqual(1, registry.getAssemblyNumber(0x1000));
+		Assert::AreEqual(2, registry.getAssemblyNumber(0x2000));
+		Assert::AreEqual(0, registry.getAssemblyNumber(0x3000), L"unknown assemblies must not be registered by a lookup");
+		Assert::AreEqual(0, registry.getAssemblyNumber(0x3000));
+		Assert::IsTrue(registry.getAssembly(3) == nullptr, L"no assembly 3");
+	}
+
+	TEST_METHOD(CachesModuleAttributes)
+	{
+		AssemblyRegistry registry;
+		int number = registry.registerAssembly(0x1000);
+		Assert::AreEqual(0, registry.getAssemblyNumberOfModule(0x5000), L"module must be unknown before it is registered");
+		Assert::IsTrue(registry.isInterestingModule(0x5000), L"unknown modules are interesting");
+
+		registry.registerModule(number, 0x5000, L"Uninteresting.Assembly", false);
+
+		Assert::AreEqual(number, registry.getAssemblyNumberOfModule(0x5000));
+		Assert::IsFalse(registry.isInterestingModule(0x5000));
+		const AssemblyRegistry::Assembly* assembly = registry.getAssembly(number);
+		Assert::AreEqual(std::wstring(L"Uninteresting.Assembly"), assembly->name);
+		Assert::IsTrue(assembly->manifestModuleId == 0x5000, L"manifest module");
+		Assert::IsTrue(assembly->assemblyId == 0x1000, L"assembly ID");
+	}
+
+	TEST_METHOD(LookupsWhileRegistering)
+	{
+		const int assemblyCount = 20'000;
+		AssemblyRegistry registry;
+		std::atomic<bool> isRegistering(true);
+		std::atomic<bool> foundWrongNumber(false);
+
+		// IDs are multiples of 16 like real pointers
+		std::thread reader([&registry, &isRegistering, &foundWrongNumber]() {
+			while (isRegistering) {
+				for (int i = 1; i <= assemblyCount; i += 97) {
+					int number = registry.getAssemblyNumberOfModule(static_cast<ModuleID>(i) * 16 + 0x100000);
+					if (number != 0 && number != i) {
+						foundWrongNumber = true;
+					}
+				}
+			}
+		});
+		for (int i = 1; i <= assemblyCount; i++) {
+			int number = registry.registerAssembly(static_cast<AssemblyID>(i) * 16);
+			registry.registerModule(number, static_cast<ModuleID>(i) * 16 + 0x100000, L"Assembly", true);
+		}
+		isRegistering = false;
+		reader.join();
+
+		Assert::IsFalse(foundWrongNumber.load(), L"readers must never see a wrong number");
+		for (int i = 1; i <= assemblyCount; i++) {
+			Assert::AreEqual(i, registry.getAssemblyNumber(static_cast<AssemblyID>(i) * 16), L"assembly number after growing");
+		}
+	}
+
+	TEST_METHOD(LookupPerformanceTest)
+	{
+		const int assemblyCount = 300;
+		const int lookups = 10'000'000;
+		AssemblyRegistry registry;
+		std::map<AssemblyID, int> assemblyMap;
+		for (int i = 1; i <= assemblyCount; i++) {
+			registry.registerAssembly(static_cast<AssemblyID>(i) * 4096);
+			assemblyMap[static_cast<AssemblyID>(i) * 4096] = i;
+		}
+
+		long long sum = 0;
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		for (int i = 0; i < lookups; i++) {
+			sum += assemblyMap[static_cast<AssemblyID>(i % assemblyCount + 1) * 4096];
+		}
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+		std::chrono::steady_clock::time_point begin2 = std::chrono::steady_clock::now();
+		for (int i = 0; i < lookups; i++) {
+			sum += registry.getAssemblyNumber(static_cast<AssemblyID>(i % assemblyCount + 1) * 4096);
+		}
+		std::chrono::steady_clock::time_point end2 = std::chrono::steady_clock::now();
+
+		std::string message = "Time Difference Map = " + std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count()) + " [mikrosekunden]\n";
+		std::string message2 = "Time Difference Registry = " + std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(end2 - begin2).count()) + " [mikrosekunden]\n";
+		std::string message3 = "Sum: " + std::to_string(sum) + "\n";
+		Logger::WriteMessage(message.c_str());
+		Logger::WriteMessage(message2.c_str());
+		Logger::WriteMessage(message3.c_str());
+	}
+};
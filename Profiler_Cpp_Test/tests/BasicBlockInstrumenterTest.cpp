@@ -0,0 +1,157 @@
+#include "CppUnitTest.h"
+#include <chrono>
+#include <cor.h>
+#include <corprof.h>
+#include <string>
+#include <vector>
+#include "instrumentation/BasicBlockInstrumenter.h"
+#include "utils/FunctionIdSet/FunctionIdSet.h"
+
+using namespace Profiler;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+TEST_CLASS(BasicBlockInstrumenterTest)
+{
+public:
+
+	TEST_METHOD(TinyMethodWithBranch)
+	{
+		// ldarg.0; brfalse.s L; ldc.i4.1; ret; L: ldc.i4.0; ret
+		std::vector<BYTE> body = { 0x1E, 0x02, 0x2C, 0x02, 0x17, 0x2A, 0x16, 0x2A };
+		BasicBlockInstrumenter instrumenter;
+		Assert::IsTrue(instrumenter.parse(body.data(), static_cast<ULONG>(body.size())), L"parse");
+		assertBlocks({ 0, 3, 5 }, instrumenter.getBlockOffsets());
+
+		BYTE hitFlags[3] = {};
+		std::vector<BYTE> instrumented = instrumenter.instrument(hitFlags);
+		Assert::AreEqual(0x3, instrumented[0] & 0x3, L"must always use a fat header");
+
+		// The short branch must have been widened to brfalse and point to the probe of the third block
+		size_t branchOffset = HEADER_SIZE + PROBE_SIZE + 1;
+		Assert::AreEqual(0x39, static_cast<int>(instrumented[branchOffset]), L"widened branch opcode");
+		ULONG thirdBlockOffset = 2 * PROBE_SIZE + 1 + 5 + 2;
+		ULONG afterBranch = PROBE_SIZE + 1 + 5;
+		Assert::AreEqual(thirdBlockOffset - afterBranch, readULong(instrumented, branchOffset + 1), L"branch distance");
+
+		BasicBlockInstrumenter reparsed;
+		Assert::IsTrue(reparsed.parse(instrumented.data(), static_cast<ULONG>(instrumented.size())), L"instrumented code must be valid");
+		assertBlocks({ 0, afterBranch, thirdBlockOffset }, reparsed.getBlockOffsets());
+	}
+
+	TEST_METHOD(ProbesStoreToHitFlags)
+	{
+		// nop; ret
+		std::vector<BYTE> body = { 0x0A, 0x00, 0x2A };
+		BasicBlockInstrumenter instrumenter;
+		Assert::IsTrue(instrumenter.parse(body.data(), static_cast<ULONG>(body.size())), L"parse");
+
+		BYTE hitFlags[1] = {};
+		std::vector<BYTE> instrumented = instrumenter.instrument(hitFlags);
+		UINT_PTR encodedAddress = 0;
+		for (size_t i = 0; i < sizeof(void*); i++) {
+			encodedAddress |= static_cast<UINT_PTR>(instrumented[HEADER_SIZE + 1 + i]) << (8 * i);
+		}
+		Assert::IsTrue(reinterpret_cast<UINT_PTR>(hitFlags) == encodedAddress, L"probe must store to the hit flag");
+		Assert::AreEqual(static_cast<size_t>(HEADER_SIZE + PROBE_SIZE + 2), instrumented.size(), L"instrumented size");
+	}
+
+	TEST_METHOD(ExceptionClausesAreRemapped)
+	{
+		// .try { nop; leave.s L } finally { endfinally } L: ret
+		std::vector<BYTE> body = {
+			0x0B, 0x30, 0x08, 0x00, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+			0x00, 0xDE, 0x01, 0xDC, 0x2A, 0x00, 0x00, 0x00,
+			0x01, 0x10, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x03, 0x03, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00,
+		};
+		BasicBlockInstrumenter instrumenter;
+		Assert::IsTrue(instrumenter.parse(body.data(), static_cast<ULONG>(body.size())), L"parse");
+		assertBlocks({ 0, 3, 4 }, instrumenter.getBlockOffsets());
+
+		BYTE hitFlags[3] = {};
+		std::vector<BYTE> instrumented = instrumenter.instrument(hitFlags);
+		BasicBlockInstrumenter reparsed;
+		Assert::IsTrue(reparsed.parse(instrumented.data(), static_cast<ULONG>(instrumented.size())), L"instrumented code must be valid");
+
+		ULONG handlerStart = PROBE_SIZE + 1 + 5;
+		ULONG afterHandler = handlerStart + PROBE_SIZE + 1;
+		assertBlocks({ 0, handlerStart, afterHandler }, reparsed.getBlockOffsets());
+	}
+
+	TEST_METHOD(CodeSize)
+	{
+		std::vector<BYTE> tiny = { 0x0A, 0x00, 0x2A };
+		Assert::AreEqual(2UL, BasicBlockInstrumenter::getCodeSize(tiny.data(), static_cast<ULONG>(tiny.size())), L"tiny header");
+
+		std::vector<BYTE> fat = { 0x03, 0x30, 0x08, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x2A };
+		Assert::AreEqual(2UL, BasicBlockInstrumenter::getCodeSize(fat.data(), static_cast<ULONG>(fat.size())), L"fat header");
+
+		std::vector<BYTE> truncated = { 0x03, 0x30, 0x08 };
+		Assert::AreEqual(0UL, BasicBlockInstrumenter::getCodeSize(truncated.data(), static_cast<ULONG>(truncated.size())), L"malformed header");
+	}
+
+	TEST_METHOD(RejectsInvalidBranchTargets)
+	{
+		// br.s into the middle of the ldc.i4 operand
+		std::vector<BYTE> body = { 0x22, 0x2B, 0x01, 0x20, 0x00, 0x00, 0x00, 0x00, 0x2A };
+		BasicBlockInstrumenter instrumenter;
+		Assert::IsFalse(instrumenter.parse(body.data(), static_cast<ULONG>(body.size())), L"parse");
+	}
+
+	TEST_METHOD(RejectsProbeBetweenPrefixAndInstruction)
+	{
+		// br.s L; tail.; L: call 0x06000001; ret
+		std::vector<BYTE> body = { 0x2E, 0x2B, 0x02, 0xFE, 0x14, 0x28, 0x01, 0x00, 0x00, 0x06, 0x2A };
+		BasicBlockInstrumenter instrumenter;
+		Assert::IsFalse(instrumenter.parse(body.data(), static_cast<ULONG>(body.size())), L"parse");
+	}
+
+	TEST_METHOD(ProbeOverheadComparedToMethodRecording)
+	{
+		const int iterations = 100'000'000;
+		const int blocksPerMethod = 8;
+
+		// What the JIT generates for a block probe: a single store of a constant to a fixed address
+		volatile BYTE hitFlags[blocksPerMethod] = {};
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		for (int i = 0; i < iterations; i++) {
+			hitFlags[i % blocksPerMethod] = 1;
+		}
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+		std::string message = "Block probes = " + std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count()) + " [mikrosekunden]\n";
+		Logger::WriteMessage(message.c_str());
+
+		// What the method enter hook does for a method that was already recorded
+		CRITICAL_SECTION synchronization;
+		InitializeCriticalSection(&synchronization);
+		FunctionIdSet calledFunctions;
+		calledFunctions.insert(42);
+		int matches = 0;
+		std::chrono::steady_clock::time_point begin2 = std::chrono::steady_clock::now();
+		for (int i = 0; i < iterations / blocksPerMethod; i++) {
+			EnterCriticalSection(&synchronization);
+			matches += calledFunctions.contains(42);
+			LeaveCriticalSection(&synchronization);
+		}
+		std::chrono::steady_clock::time_point end2 = std::chrono::steady_clock::now();
+		DeleteCriticalSection(&synchronization);
+		std::string message2 = "Method recording = " + std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(end2 - begin2).count()) + " [mikrosekunden]\n";
+		std::string message3 = "Matches: " + std::to_string(matches) + "\n";
+		Logger::WriteMessage(message2.c_str());
+		Logger::WriteMessage(message3.c_str());
+	}
+
+private:
+	const size_t HEADER_SIZE = 12;
+	const ULONG PROBE_SIZE = 1 + sizeof(void*) + 3;
+
+	void assertBlocks(std::vector<ULONG> expected, const std::vector<ULONG>& actual) {
+		Assert::AreEqual(expected.size(), actual.size(), L"number of blocks");
+		for (size_t i = 0; i < expected.size(); i++) {
+			Assert::AreEqual(expected[i], actual[i], L"block offset");
+		}
+	}
+
+	ULONG readULong(const std::vector<BYTE>& data, size_t offset) {
+		return data[offset] | (data[offset + 1] << 8) | (data[offset + 2] << 16) | (data[offset + 3] << 24);
+	}
+};
@@ -0,0 +1,164 @@
+#include "CppUnitTest.h"
+#include <array>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "utils/CallbackRecorder.h"
+#include "utils/CallbackReplay.h"
+#include "utils/MethodEnter.h"
+
+using namespace Profiler;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+TEST_CLASS(CallbackRecorderTest)
+{
+public:
+
+	TEST_METHOD_INITIALIZE(SetRecordingFile)
+	{
+		std::array<char, MAX_PATH> tempDirectory;
+		GetTempPathA(static_cast<DWORD>(tempDirectory.size()), tempDirectory.data());
+		recordingFile = std::string(tempDirectory.data()) + "CallbackRecorderTest.bin";
+	}
+
+	TEST_METHOD_CLEANUP(DeleteRecordingFile)
+	{
+		DeleteFileA(recordingFile.c_str());
+	}
+
+	TEST_METHOD(RoundTrip)
+	{
+		std::vector<RecordedCallback> callbacks = {
+			callback(RecordedCallback::Type::ASSEMBLY_LOAD_FINISHED, 0, 0x7FFE12345678ULL),
+			callback(RecordedCallback::Type::JIT_COMPILATION_FINISHED, 1, 0x7FFE00001000ULL),
+			callback(RecordedCallback::Type::TEST_START, 0, 3, "MyTest:with:colons"),
+			callback(RecordedCallback::Type::ENTER, 2, 0x7FFE00001000ULL),
+			callback(RecordedCallback::Type::ENTER, 1, 0xFFFFFFFFFFFFFFFFULL),
+			callback(RecordedCallback::Type::JIT_INLINING, 1, 0),
+			callback(RecordedCallback::Type::TEST_END, 0, 3, "PASSED:42"),
+		};
+
+		std::vector<RecordedCallback> decoded;
+		Assert::IsTrue(CallbackRecorder::decode(CallbackRecorder::encode(callbacks), decoded));
+		Assert::IsTrue(callbacks.size() == decoded.size(), L"number of callbacks");
+		for (size_t i = 0; i < callbacks.size(); i++) {
+			Assert::IsTrue(callbacks[i].type == decoded[i].type, L"type");
+			Assert::AreEqual(callbacks[i].thread, decoded[i].thread, L"thread");
+			Assert::IsTrue(callbacks[i].id == decoded[i].id, L"id");
+			Assert::AreEqual(callbacks[i].text, decoded[i].text, L"text");
+		}
+
+		std::string truncated = CallbackRecorder::encode(callbacks);
+		truncated.pop_back();
+		Assert::IsFalse(CallbackRecorder::decode(truncated, decoded), L"truncated recording");
+		Assert::IsFalse(CallbackRecorder::decode("TIACB\x02", decoded), L"unknown version");
+	}
+
+	TEST_METHOD(RecordsCallbacksOfEachThread)
+	{
+		CallbackRecorder recorder;
+		Assert::IsTrue(recorder.open(recordingFile));
+		recorder.record(RecordedCallback::Type::TEST_START, 0, "Test");
+		std::thread([&recorder]() {
+			recorder.record(RecordedCallback::Type::ENTER, 4711);
+		}).join();
+		recorder.record(RecordedCallback::Type::ENTER, 42);
+		recorder.close();
+		recorder.record(RecordedCallback::Type::ENTER, 43);
+
+		std::vector<RecordedCallback> callbacks;
+		Assert::IsTrue(CallbackRecorder::readFile(recordingFile, callbacks));
+		Assert::IsTrue(callbacks.size() == 3, L"callbacks after closing are ignored");
+		Assert::AreEqual(std::string("Test"), callbacks[0].text);
+		Assert::AreEqual(callbacks[0].thread, callbacks[2].thread, L"same thread");
+		Assert::AreNotEqual(callbacks[0].thread, callbacks[1].thread, L"other thread");
+		Assert::IsTrue(callbacks[1].id == 4711, L"id of other thread");
+	}
+
+	TEST_METHOD(NumbersThreadsPerRecording)
+	{
+		// On a new thread, so that it gets its first number in the previous recording, where it is the second thread
+		std::string path = recordingFile;
+		std::thread([&path]() {
+			CallbackRecorder previousRecorder;
+			previousRecorder.open(path);
+			std::thread([&previousRecorder]() {
+				previousRecorder.record(RecordedCallback::Type::ENTER, 4711);
+			}).join();
+			previousRecorder.record(RecordedCallback::Type::ENTER, 42);
+			previousRecorder.close();
+
+			CallbackRecorder recorder;
+			recorder.open(path);
+			recorder.record(RecordedCallback::Type::ENTER, 42);
+			recorder.close();
+		}).join();
+
+		std::vector<RecordedCallback> callbacks;
+		Assert::IsTrue(CallbackRecorder::readFile(recordingFile, callbacks));
+		Assert::IsTrue(callbacks.size() == 1, L"number of callbacks");
+		Assert::AreEqual(0U, callbacks[0].thread, L"first thread of the new recording");
+	}
+
+	TEST_METHOD(ReplayReproducesInterleaving)
+	{
+		std::vector<RecordedCallback> callbacks;
+		for (unsigned long long i = 0; i < 1000; i++) {
+			callbacks.push_back(callback(RecordedCallback::Type::ENTER, static_cast<unsigned int>(i % 7 % 3), i));
+		}
+
+		std::vector<unsigned long long> replayed;
+		CallbackReplay::replay(callbacks, [&replayed](const RecordedCallback& callback) {
+			replayed.push_back(callback.id);
+		});
+
+		Assert::IsTrue(callbacks.size() == replayed.size(), L"number of replayed callbacks");
+		for (size_t i = 0; i < replayed.size(); i++) {
+			Assert::IsTrue(replayed[i] == i, L"replayed in recorded order");
+		}
+	}
+
+	TEST_METHOD(ReplayIntoEnterHook)
+	{
+		std::vector<RecordedCallback> callbacks;
+		for (unsigned long long i = 0; i < 1'000'000; i++) {
+			callbacks.push_back(callback(RecordedCallback::Type::ENTER, static_cast<unsigned int>(i % 4), 0x10000 + 8 * (i % 5000)));
+		}
+
+		FunctionIdSet calledFunctions;
+		Lock lock;
+		setLock(&lock);
+		setCalledMethodsSet(&calledFunctions);
+		setTestCaseRecording(true);
+
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		CallbackReplay::replay(callbacks, [](const RecordedCallback& callback) {
+			FunctionIDOrClientID functionId;
+			functionId.functionID = static_cast<FunctionID>(callback.id);
+			EnterCpp(functionId);
+		}, false);
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+		setTestCaseRecording(false);
+		setCalledMethodsSet(nullptr);
+		setLock(nullptr);
+
+		std::string message = "Replay of 1M calls on 4 threads = " + std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count()) + " [mikrosekunden]\n";
+		Logger::WriteMessage(message.c_str());
+		for (FunctionID id = 0x10000; id < 0x10000 + 8 * 5000; id += 8) {
+			Assert::IsTrue(calledFunctions.contains(id), L"all called functions recorded");
+		}
+	}
+
+private:
+	std::string recordingFile;
+
+	static RecordedCallback callback(RecordedCallback::Type type, unsigned int thread, unsigned long long id, const std::string& text = "") {
+		RecordedCallback callback;
+		callback.type = type;
+		callback.thread = thread;
+		callback.id = id;
+		callback.text = text;
+		return callback;
+	}
+};
@@ -0,0 +1,98 @@
+#include "CppUnitTest.h"
+#include <atomic>
+#include <chrono>
+#include <cor.h>
+#include <corprof.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include "utils/FunctionIdSet/ConcurrentFunctionIdSet.h"
+
+using namespace Profiler;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+TEST_CLASS(ConcurrentFunctionIdSetTest)
+{
+public:
+
+	TEST_METHOD(InsertAndContains)
+	{
+		ConcurrentFunctionIdSet set;
+		Assert::IsFalse(set.contains(42));
+		Assert::IsTrue(set.insert(42), L"first insert");
+		Assert::IsFalse(set.insert(42), L"second insert");
+		Assert::IsTrue(set.contains(42));
+		Assert::IsFalse(set.contains(43));
+	}
+
+	/**
+	 * Reproduces the access pattern of JITInlining: many threads check for and insert the same functions
+	 * while the set grows. With the FunctionIdSet, the lock-free contains() read the array while another
+	 * thread replaced and freed it, and unsynchronized inserts lost elements.
+	 */
+	TEST_METHOD(ConcurrentInsertsWhileGrowing)
+	{
+		const FunctionID functionCount = 500'000;
+		const int threadCount = 8;
+		ConcurrentFunctionIdSet set;
+		std::atomic<int> successfulInserts(0);
+		std::atomic<bool> wasInvisible(false);
+
+		std::vector<std::thread> threads;
+		for (int t = 0; t < threadCount; t++) {
+			threads.emplace_back([&set, &successfulInserts, &wasInvisible, t, functionCount]() {
+				// Every thread visits all functions, starting at a different offset
+				for (FunctionID i = 0; i < functionCount; i++) {
+					FunctionID f = (i + t * functionCount / threadCount) % functionCount + 1;
+					if (!set.contains(f) && set.insert(f)) {
+						successfulInserts++;
+					}
+					if (!set.contains(f)) {
+						wasInvisible = true;
+					}
+				}
+			});
+		}
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+
+		Assert::AreEqual(static_cast<int>(functionCount), successfulInserts.load(), L"every function must be inserted exactly once");
+		Assert::IsFalse(wasInvisible.load(), L"a function must be visible right after insert() returned");
+		for (FunctionID f = 1; f <= functionCount; f++) {
+			Assert::IsTrue(set.contains(f), L"no function may be lost");
+		}
+	}
+
+	TEST_METHOD(ConcurrentLookupPerformanceTest)
+	{
+		const int threadCount = 8;
+		const int lookupsPerThread = 10'000'000;
+		ConcurrentFunctionIdSet set;
+		for (FunctionID f = 1; f <= 50'000; f++) {
+			set.insert(f);
+		}
+
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		std::vector<std::thread> threads;
+		std::atomic<int> matches(0);
+		for (int t = 0; t < threadCount; t++) {
+			threads.emplace_back([&set, &matches, lookupsPerThread]() {
+				int localMatches = 0;
+				for (int i = 0; i < lookupsPerThread; i++) {
+					localMatches += set.contains((i % 100'000) + 1);
+				}
+				matches += localMatches;
+			});
+		}
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+		std::string message = "Time Difference Concurrent Lookups = " + std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count()) + " [mikrosekunden]\n";
+		std::string message2 = "Matches: " + std::to_string(matches.load()) + "\n";
+		Logger::WriteMessage(message.c_str());
+		Logger::WriteMessage(message2.c_str());
+	}
+};
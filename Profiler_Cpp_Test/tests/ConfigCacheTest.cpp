@@ -0,0 +1,149 @@
+#include "CppUnitTest.h"
+#include <array>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include "config/Config.h"
+#include "config/ConfigCache.h"
+
+using namespace Profiler;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+TEST_CLASS(ConfigCacheTest)
+{
+public:
+
+	TEST_METHOD_INITIALIZE(CreateFiles)
+	{
+		std::array<char, MAX_PATH> tempDirectory;
+		GetTempPathA(static_cast<DWORD>(tempDirectory.size()), tempDirectory.data());
+		configFile = std::string(tempDirectory.data()) + "ConfigCacheTest.yml";
+		cacheFile = configFile + ".cache";
+		DeleteFileA(cacheFile.c_str());
+		writeConfig(CONFIG);
+	}
+
+	TEST_METHOD_CLEANUP(DeleteFiles)
+	{
+		DeleteFileA(cacheFile.c_str());
+		DeleteFileA(configFile.c_str());
+	}
+
+	TEST_METHOD(CachedSectionsAndOptionsSurviveRoundTrip)
+	{
+		ConfigCache cache(cacheFile, fingerprint(CONFIG));
+		Assert::IsFalse(cache.load(), L"there is no cache file yet");
+
+		std::istringstream stream(CONFIG);
+		cache.setConfigFile(ConfigParser::parse(stream));
+		CaseInsensitiveStringMap options;
+		options["tia"] = "true";
+		cache.addResolvedOptions("c:\\company\\program.exe", options);
+		Assert::IsTrue(cache.save(), L"saving the cache");
+
+		ConfigCache loadedCache(cacheFile, fingerprint(CONFIG));
+		Assert::IsTrue(loadedCache.load(), L"loading the cache");
+		Assert::IsTrue(loadedCache.hasSections(), L"cached sections");
+
+		ConfigFile cachedConfig = loadedCache.getConfigFile();
+		Assert::AreEqual(size_t(2), cachedConfig.sections.size(), L"number of sections");
+		Assert::AreEqual(std::string(".*program.exe"), cachedConfig.sections[1].executablePathPattern);
+		Assert::IsTrue(std::regex_match("C:\\COMPANY\\PROGRAM.EXE", ConfigParser::compileExecutablePathRegex(cachedConfig.sections[1].executablePathPattern)), L"regex must be case-insensitive");
+		Assert::AreEqual(std::string("true"), cachedConfig.sections[1].profilerOptions["tia"]);
+
+		CaseInsensitiveStringMap loadedOptions;
+		Assert::IsTrue(loadedCache.findResolvedOptions("C:\\Company\\Program.exe", loadedOptions), L"cached process");
+		Assert::AreEqual(std::string("true"), loadedOptions["TIA"]);
+		Assert::IsFalse(loadedCache.findResolvedOptions("c:\\company\\other.exe", loadedOptions), L"uncached process");
+	}
+
+	TEST_METHOD(CacheOfOtherConfigVersionIsIgnored)
+	{
+		ConfigCache cache(cacheFile, fingerprint(CONFIG));
+		cache.setConfigFile(ConfigFile());
+		Assert::IsTrue(cache.save(), L"saving the cache");
+
+		writeConfig(CONFIG + "\n");
+		ConfigCache otherCache(cacheFile, fingerprint(CONFIG + "\n"));
+		Assert::IsFalse(otherCache.load(), L"changed config file");
+		Assert::IsFalse(otherCache.hasSections(), L"no sections after failed load");
+	}
+
+	TEST_METHOD(CorruptCacheIsIgnored)
+	{
+		ConfigCache cache(cacheFile, fingerprint(CONFIG));
+		std::istringstream stream(CONFIG);
+		cache.setConfigFile(ConfigParser::parse(stream));
+		Assert::IsTrue(cache.save(), L"saving the cache");
+
+		std::string contents;
+		{
+			std::ifstream file(cacheFile, std::ios::binary);
+			contents.assign((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		}
+		std::ofstream(cacheFile, std::ios::binary | std::ios::trunc) << contents.substr(0, contents.size() - 3);
+
+		Assert::IsFalse(ConfigCache(cacheFile, fingerprint(CONFIG)).load(), L"truncated cache");
+	}
+
+	TEST_METHOD(ConfigFromCacheEqualsParsedConfig)
+	{
+		for (int i = 0; i < 3; i++) {
+			Config config(emptyEnvironment);
+			config.load(configFile, "c:\\company\\program.exe", true);
+
+			Assert::AreEqual(size_t(0), config.getProblems().size(), L"number of problems");
+			Assert::AreEqual(true, config.isTiaEnabled(), L"the later section wins");
+			Assert::AreEqual(true, config.shouldIgnoreExceptions(), L"options of all matching sections are applied");
+			Assert::AreEqual(size_t(1), config.getWarnings().size(), L"unknown options are still reported");
+		}
+
+		Config otherConfig(emptyEnvironment);
+		otherConfig.load(configFile, "c:\\company\\other.exe", true);
+		Assert::AreEqual(false, otherConfig.isTiaEnabled(), L"other process from cached sections");
+	}
+
+	TEST_METHOD(ChangedConfigIsParsedAgain)
+	{
+		Config config(emptyEnvironment);
+		config.load(configFile, "c:\\company\\program.exe", true);
+		Assert::AreEqual(true, config.isTiaEnabled(), L"original config");
+
+		writeConfig(R"(
+match:
+  - profiler:
+      tia: false
+)");
+		Config changedConfig(emptyEnvironment);
+		changedConfig.load(configFile, "c:\\company\\program.exe", true);
+		Assert::AreEqual(false, changedConfig.isTiaEnabled(), L"changed config");
+	}
+
+private:
+	const std::string CONFIG = R"(
+match:
+  - profiler:
+      ignore_exceptions: true
+      tia: false
+      unknwon_option: 1
+  - executablePathRegex: ".*program.exe"
+    profiler:
+      tia: true
+)";
+
+	std::string configFile;
+	std::string cacheFile;
+
+	void writeConfig(const std::string& contents) {
+		std::ofstream(configFile, std::ios::trunc) << contents;
+	}
+
+	ConfigFileFingerprint fingerprint(const std::string& contents) {
+		return ConfigCache::computeFingerprint(configFile, contents);
+	}
+
+	static std::string emptyEnvironment(std::string suffix) {
+		return "";
+	};
+};
@@ -44,7 +44,7 @@ match:
       enabled: "0"
 )");
 		Assert::AreEqual(1, (int)file.sections.size(), L"number of sections");
-		Assert::IsTrue(std::regex_match("foobar", file.sections[0].executablePathRegex), L"expecting regex to match");
+		Assert::IsTrue(std::regex_match("foobar", ConfigParser::compileExecutablePathRegex(file.sections[0].executablePathPattern)), L"expecting regex to match");
 		Assert::AreEqual("0", file.sections[0].profilerOptions["enabled"].c_str(), L"enabled option");
 	}
 
@@ -58,6 +58,7 @@ match:
 )");
 		Assert::AreEqual(1, (int)file.sections.size(), L"number of sections");
 		Assert::AreEqual("1", file.sections[0].profilerOptions["enabled"].c_str(), L"enabled option");
+		Assert::AreEqual("enabled", file.sections[0].profilerOptions.begin()->first.c_str(), L"option names are normalized");
 	}
 
 	TEST_METHOD(TypeConversion)
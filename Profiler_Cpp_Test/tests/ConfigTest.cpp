@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <chrono>
 #include <sstream>
 #include <vector>
 #include "CppUnitTest.h"
@@ -167,6 +169,18 @@ match:
 		Assert::AreEqual(size_t(1), config.getProblems().size(), L"number of problems");
 	}
 
+	TEST_METHOD(InvalidRegexOfCandidateSectionIsAProblem)
+	{
+		Config config = parse(R"(
+match:
+  - executablePathRegex: ".*(program"
+    profiler:
+      targetdir: "c:\test"
+)", emptyEnvironment);
+
+		Assert::AreEqual(size_t(1), config.getProblems().size(), L"number of problems");
+	}
+
 	TEST_METHOD(OldProcessSelectionMustMatchSuffixCaseInsensitively)
 	{
 		Config config = parse(R"(/$&)", [](std::string suffix) -> std::string {
@@ -298,16 +312,98 @@ match:
 		Assert::AreEqual(false, config.shouldUseLightMode(), L"the profiler section must still be applied");
 	}
 
+	TEST_METHOD(CallSamplingInterval)
+	{
+		Config defaultConfig = parse(R"()", emptyEnvironment);
+		Assert::AreEqual(0U, defaultConfig.getCallSamplingInterval(), L"default value should be to record all calls");
+
+		Config config = parse(R"(
+match:
+  - profiler:
+      call_sampling_interval: 100
+)", emptyEnvironment);
+		Assert::AreEqual(100U, config.getCallSamplingInterval(), L"configured interval");
+
+		Config invalidConfig = parse(R"(
+match:
+  - profiler:
+      call_sampling_interval: -5
+)", emptyEnvironment);
+		Assert::AreEqual(0U, invalidConfig.getCallSamplingInterval(), L"negative intervals must be ignored");
+		Assert::AreEqual(size_t(1), invalidConfig.getProblems().size(), L"negative intervals must be reported");
+	}
+
+	TEST_METHOD(DetachAfterIdleMinutes)
+	{
+		Config defaultConfig = parse(R"()", emptyEnvironment);
+		Assert::AreEqual(0U, defaultConfig.getDetachAfterIdleMinutes(), L"default value should be to stay attached");
+
+		Config config = parse(R"(
+match:
+  - profiler:
+      detach_after_idle_minutes: 120
+)", emptyEnvironment);
+		Assert::AreEqual(120U, config.getDetachAfterIdleMinutes(), L"configured minutes");
+
+		Config invalidConfig = parse(R"(
+match:
+  - profiler:
+      detach_after_idle_minutes: soon
+)", emptyEnvironment);
+		Assert::AreEqual(0U, invalidConfig.getDetachAfterIdleMinutes(), L"invalid values must be ignored");
+		Assert::AreEqual(size_t(1), invalidConfig.getProblems().size(), L"invalid values must be reported");
+	}
+
+	TEST_METHOD(AssemblyAndNamespacePatterns)
+	{
+		Config defaultConfig = parse(R"()", emptyEnvironment);
+		Assert::IsTrue(defaultConfig.getAssemblyPatterns().isEmpty(), L"default should be to not filter assemblies");
+		Assert::IsTrue(defaultConfig.getNamespacePatterns().isEmpty(), L"default should be to not filter namespaces");
+
+		Config config = parse(R"(
+match:
+  - profiler:
+      assembly_include: "MyProduct*;MyCompany.*"
+      assembly_exclude: "*Tests"
+      namespace_exclude: "MyCompany.Generated*"
+)", emptyEnvironment);
+		Assert::IsTrue(config.getAssemblyPatterns().matches(L"MyCompany.Core"), L"included assembly");
+		Assert::IsFalse(config.getAssemblyPatterns().matches(L"MyCompany.Core.Tests"), L"excluded assembly");
+		Assert::IsFalse(config.getAssemblyPatterns().matches(L"System.Private.CoreLib"), L"assembly that is not included");
+		Assert::IsTrue(config.getNamespacePatterns().matches(L"MyCompany.Core"), L"namespace that is not excluded");
+		Assert::IsFalse(config.getNamespacePatterns().matches(L"MyCompany.Generated.Proxies"), L"excluded namespace");
+	}
+
+	TEST_METHOD(TrivialMethodPolicy)
+	{
+		Config defaultConfig = parse(R"()", emptyEnvironment);
+		Assert::AreEqual(0U, defaultConfig.getMinimumIlSize(), L"default should be to hook methods of all sizes");
+		Assert::AreEqual(size_t(0), defaultConfig.getExcludedAttributes().size(), L"default should be to not exclude attributes");
+
+		Config config = parse(R"(
+match:
+  - profiler:
+      min_il_size: 8
+      excluded_attributes: "System.Runtime.CompilerServices.CompilerGeneratedAttribute;System.Diagnostics.DebuggerHiddenAttribute"
+)", emptyEnvironment);
+		Assert::AreEqual(8U, config.getMinimumIlSize(), L"configured minimum IL size");
+		Assert::AreEqual(size_t(2), config.getExcludedAttributes().size(), L"number of excluded attributes");
+		Assert::IsTrue(config.getExcludedAttributes()[1] == L"System.Diagnostics.DebuggerHiddenAttribute", L"second excluded attribute");
+	}
+
 	TEST_METHOD(AllSupportedOptionsMustBeRecognized)
 	{
 		// This list documents all options the profiler supports. It is deliberately duplicated here and
 		// not in the profiler itself: the profiler derives the supported options from the ones it queries,
 		// so it can never go stale. This test detects when an option is no longer queried unconditionally
-		// from Config::setOptions, which would make the profiler warn about a perfectly valid option.
+		// from Config::setOptions, which would make the profiler warn about a perfectly valid option,
+		// and when a new option is added without adding it here.
 		const std::vector<std::string> supportedOptions = {
 			"targetdir", "enabled", "light_mode", "assembly_file_version", "assembly_paths",
 			"dump_environment", "ignore_exceptions", "upload_daemon", "tga", "tia",
-			"tia_request_socket", "eagerness"
+			"tia_request_socket", "tia_subscribe_socket", "tia_stream_coverage", "eagerness", "block_coverage", "call_counts", "call_sampling_interval",
+			"assembly_include", "assembly_exclude", "namespace_include", "namespace_exclude",
+			"min_il_size", "excluded_attributes", "log_excluded_methods", "record_callbacks", "detach_after_idle_minutes"
 		};
 
 		std::stringstream yaml;
@@ -319,6 +415,61 @@ match:
 		Config config = parse(yaml.str(), emptyEnvironment);
 
 		Assert::AreEqual(size_t(0), config.getWarnings().size(), describe(config.getWarnings()).c_str());
+		for (const std::string& option : config.getSupportedOptionNames()) {
+			bool isListed = std::find(supportedOptions.begin(), supportedOptions.end(), option) != supportedOptions.end();
+			Assert::IsTrue(isListed, describe({ "Option missing from this test: " + option }).c_str());
+		}
+	}
+
+	TEST_METHOD(LargeConfigPerformanceTest)
+	{
+		std::stringstream yaml;
+		yaml << "match:\n";
+		for (int i = 0; i < 200; i++) {
+			yaml << "  - executableName: \"program" << i << ".exe\"\n    profiler:\n";
+			for (int j = 0; j < 20; j++) {
+				yaml << "      Custom_Option_" << j << ": \"" << i << "\"\n";
+			}
+			yaml << "      TargetDir: \"c:\\\\traces" << i << "\"\n";
+		}
+
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		for (int i = 0; i < 10; i++) {
+			Config config(emptyEnvironment);
+			std::stringstream stream(yaml.str());
+			config.load(stream, "c:\\company\\program" + std::to_string(i) + ".exe");
+			Assert::AreEqual("c:\\traces" + std::to_string(i), config.getTargetDir(), L"target directory");
+		}
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+		std::string message = "Time Difference Load = " + std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count()) + " [mikrosekunden]\n";
+		Logger::WriteMessage(message.c_str());
+	}
+
+	TEST_METHOD(LargeSectionSetOptionsPerformanceTest)
+	{
+		std::stringstream yaml;
+		yaml << "match:\n  - executableName: \"program.exe\"\n    profiler:\n";
+		for (int i = 0; i < 2000; i++) {
+			yaml << "      Custom_Option_" << i << ": \"" << i << "\"\n";
+		}
+		yaml << "      TargetDir: \"c:\\\\traces\"\n      Light_Mode: false\n      IGNORE_EXCEPTIONS: true\n";
+		ConfigFile configFile = ConfigParser::parse(yaml);
+
+		// The file is parsed only once so this measures applying the section and looking up the options via setOptions/getOption
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		for (int i = 0; i < 100; i++) {
+			Config config(emptyEnvironment);
+			config.load(configFile, "c:\\company\\program.exe");
+			Assert::AreEqual(std::string("c:\\traces"), config.getTargetDir(), L"target directory");
+			Assert::AreEqual(false, config.shouldUseLightMode(), L"light mode");
+			Assert::AreEqual(true, config.shouldIgnoreExceptions(), L"ignore exceptions");
+			Assert::AreEqual(size_t(2000), config.getWarnings().size(), L"number of unknown options");
+		}
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+		std::string message = "Time Difference Set Options = " + std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count()) + " [mikrosekunden]\n";
+		Logger::WriteMessage(message.c_str());
 	}
 
 private:
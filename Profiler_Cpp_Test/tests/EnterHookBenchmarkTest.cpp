@@ -0,0 +1,153 @@
+#include "CppUnitTest.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "utils/MethodEnter.h"
+
+using namespace Profiler;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+/**
+ * Measures how the enter hook scales with the number of threads that call it concurrently, for different workloads.
+ * Reports the throughput and the 99th percentile of the average latency per call in small batches of calls for 1 to N threads, N being the number of cores.
+ */
+TEST_CLASS(EnterHookBenchmarkTest)
+{
+public:
+
+	TEST_METHOD(HotSharedCore)
+	{
+		// All threads call the same few methods, e.g. framework code used by every test
+		runForAllThreadCounts("Hot shared core", [](unsigned int, unsigned long long call) {
+			return FIRST_FUNCTION_ID + 8 * (call % 200);
+		}, false);
+	}
+
+	TEST_METHOD(PrivateWorkingSets)
+	{
+		// Each thread calls its own methods, e.g. tests of different components running in parallel
+		runForAllThreadCounts("Private working sets", [](unsigned int thread, unsigned long long call) {
+			return FIRST_FUNCTION_ID + thread * FUNCTION_IDS_PER_THREAD + 8 * (call % 2000);
+		}, false);
+	}
+
+	TEST_METHOD(WarmUp)
+	{
+		// Every call is the first one of its method, so each one inserts into the set
+		runForAllThreadCounts("Warm-up", [](unsigned int thread, unsigned long long call) {
+			return FIRST_FUNCTION_ID + thread * FUNCTION_IDS_PER_THREAD + 8 * call;
+		}, false);
+	}
+
+	TEST_METHOD(TestBoundaries)
+	{
+		// Like the private working sets, but tests end every millisecond, so the recorded methods are collected and
+		// cleared like at the end of a test and all methods are called for the first time again afterwards
+		runForAllThreadCounts("Test boundaries", [](unsigned int thread, unsigned long long call) {
+			return FIRST_FUNCTION_ID + thread * FUNCTION_IDS_PER_THREAD + 8 * (call % 2000);
+		}, true);
+	}
+
+private:
+	static const unsigned long long CALLS_PER_THREAD = 200'000;
+	static const FunctionID FIRST_FUNCTION_ID = 0x10000;
+	static const FunctionID FUNCTION_IDS_PER_THREAD = 8 * CALLS_PER_THREAD;
+
+	/** The latency is measured for batches of calls, as reading the clock takes longer than a single call. */
+	static const unsigned int CALLS_PER_BATCH = 64;
+
+	void runForAllThreadCounts(const std::string& workload, const std::function<FunctionID(unsigned int, unsigned long long)>& functionIdOfCall, bool hasTestBoundaries) {
+		unsigned int maxThreads = std::max(1U, std::thread::hardware_concurrency());
+		for (unsigned int threads = 1; threads <= maxThreads; threads = threads * 2 > maxThreads && threads < maxThreads ? maxThreads : threads * 2) {
+			run(workload, threads, functionIdOfCall, hasTestBoundaries);
+		}
+	}
+
+	void run(const std::string& workload, unsigned int threadCount, const std::function<FunctionID(unsigned int, unsigned long long)>& functionIdOfCall, bool hasTestBoundaries) {
+		FunctionIdSet calledFunctions;
+		Lock lock;
+		setLock(&lock);
+		setCalledMethodsSet(&calledFunctions);
+		setTestCaseRecording(true);
+
+		std::atomic<unsigned int> preparedThreads(0);
+		std::atomic<bool> isStarted(false);
+		std::atomic<unsigned int> runningThreads(threadCount);
+		std::vector<std::vector<long long>> batchNanoseconds(threadCount);
+		std::vector<std::thread> threads;
+		for (unsigned int thread = 0; thread < threadCount; thread++) {
+			threads.emplace_back([&, thread]() {
+				std::vector<FunctionIDOrClientID> calls(CALLS_PER_THREAD);
+				for (unsigned long long call = 0; call < CALLS_PER_THREAD; call++) {
+					calls[call].functionID = functionIdOfCall(thread, call);
+				}
+				std::vector<long long>& batches = batchNanoseconds[thread];
+				batches.reserve(CALLS_PER_THREAD / CALLS_PER_BATCH);
+				preparedThreads++;
+				while (!isStarted) {
+					std::this_thread::yield();
+				}
+
+				for (unsigned long long batch = 0; batch + CALLS_PER_BATCH <= CALLS_PER_THREAD; batch += CALLS_PER_BATCH) {
+					std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+					for (unsigned long long call = batch; call < batch + CALLS_PER_BATCH; call++) {
+						EnterCpp(calls[call]);
+					}
+					std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+					batches.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count());
+				}
+				runningThreads--;
+			});
+		}
+
+		while (preparedThreads < threadCount) {
+			std::this_thread::yield();
+		}
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		isStarted = true;
+		unsigned int testCount = 0;
+		if (hasTestBoundaries) {
+			while (runningThreads > 0) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				// The profiler's own flush path, which copies and clears the set while the threads keep looking it up
+				std::vector<FunctionID> calledFunctionIds;
+				drainCalledMethods(calledFunctions, calledFunctionIds);
+				testCount++;
+			}
+		}
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+		setTestCaseRecording(false);
+		setCalledMethodsSet(nullptr);
+		setLock(nullptr);
+
+		std::vector<long long> allBatches;
+		for (const std::vector<long long>& batches : batchNanoseconds) {
+			allBatches.insert(allBatches.end(), batches.begin(), batches.end());
+		}
+		std::sort(allBatches.begin(), allBatches.end());
+		long long p99BatchNanoseconds = allBatches[allBatches.size() * 99 / 100] / CALLS_PER_BATCH;
+		double seconds = std::chrono::duration_cast<std::chrono::duration<double>>(end - begin).count();
+		double millionCallsPerSecond = threadCount * CALLS_PER_THREAD / seconds / 1e6;
+
+		std::string message = workload + ": " + std::to_string(threadCount) + " threads = "
+			+ std::to_string(millionCallsPerSecond) + " [M calls/s], p99 of " + std::to_string(CALLS_PER_BATCH) + "-call batches "
+			+ std::to_string(p99BatchNanoseconds) + " [ns/call averaged over the batch]";
+		if (hasTestBoundaries) {
+			message += ", " + std::to_string(testCount) + " tests";
+		}
+		Logger::WriteMessage((message + "\n").c_str());
+
+		if (!hasTestBoundaries) {
+			for (unsigned int thread = 0; thread < threadCount; thread++) {
+				Assert::IsTrue(calledFunctions.contains(functionIdOfCall(thread, CALLS_PER_THREAD - 1)), L"last call of each thread recorded");
+			}
+		}
+	}
+};
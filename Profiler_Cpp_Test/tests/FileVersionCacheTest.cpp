@@ -0,0 +1,109 @@
+#include "CppUnitTest.h"
+#include <array>
+#include <fstream>
+#include <string>
+#include "utils/FileVersionCache.h"
+#include "utils/BackgroundWorker.h"
+
+using namespace Profiler;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+TEST_CLASS(FileVersionCacheTest)
+{
+public:
+
+	TEST_METHOD_INITIALIZE(CreateFiles)
+	{
+		std::array<wchar_t, MAX_PATH> tempDirectory;
+		GetTempPathW(static_cast<DWORD>(tempDirectory.size()), tempDirectory.data());
+		cacheFile = std::wstring(tempDirectory.data()) + L"FileVersionCacheTest.cache";
+		assemblyFile = std::wstring(tempDirectory.data()) + L"FileVersionCacheTest.dll";
+		DeleteFileW(cacheFile.c_str());
+		writeAssembly("content");
+	}
+
+	TEST_METHOD_CLEANUP(DeleteFiles)
+	{
+		DeleteFileW(cacheFile.c_str());
+		DeleteFileW(assemblyFile.c_str());
+	}
+
+	TEST_METHOD(ReadsVersionsOnlyOnce)
+	{
+		int reads = 0;
+		FileVersionCache cache(cacheFile, countingReader(reads));
+		Assert::AreEqual(std::wstring(VERSION_INFO), cache.getVersionInfo(assemblyFile));
+		Assert::AreEqual(std::wstring(VERSION_INFO), cache.getVersionInfo(assemblyFile));
+		Assert::AreEqual(1, reads, L"number of reads");
+	}
+
+	TEST_METHOD(SharesVersionsBetweenProcesses)
+	{
+		int reads = 0;
+		FileVersionCache(cacheFile, countingReader(reads)).getVersionInfo(assemblyFile);
+
+		FileVersionCache otherProcessCache(cacheFile, countingReader(reads));
+		Assert::AreEqual(std::wstring(VERSION_INFO), otherProcessCache.getVersionInfo(assemblyFile));
+		Assert::AreEqual(1, reads, L"the second cache must use the persisted entry");
+	}
+
+	TEST_METHOD(ReadsChangedAssembliesAgain)
+	{
+		int reads = 0;
+		FileVersionCache(cacheFile, countingReader(reads)).getVersionInfo(assemblyFile);
+		writeAssembly("changed content");
+
+		FileVersionCache(cacheFile, countingReader(reads)).getVersionInfo(assemblyFile);
+		Assert::AreEqual(2, reads, L"number of reads");
+	}
+
+	TEST_METHOD(IgnoresIncompleteEntries)
+	{
+		std::ofstream(cacheFile, std::ios::binary) << "C:\\incomplete\t12\t34\t FileVersion:1";
+
+		int reads = 0;
+		FileVersionCache cache(cacheFile, countingReader(reads));
+		Assert::AreEqual(std::wstring(VERSION_INFO), cache.getVersionInfo(assemblyFile));
+		Assert::AreEqual(1, reads, L"number of reads");
+	}
+
+	TEST_METHOD(ReadsVersionResources)
+	{
+		std::array<wchar_t, MAX_PATH> testHost;
+		GetModuleFileNameW(nullptr, testHost.data(), static_cast<DWORD>(testHost.size()));
+		std::wstring versionInfo = FileVersionCache::readVersionInfo(testHost.data());
+		Assert::IsTrue(versionInfo.find(L" FileVersion:") == 0, versionInfo.c_str());
+		Assert::IsTrue(versionInfo.find(L" ProductVersion:") != std::wstring::npos, versionInfo.c_str());
+		Assert::AreEqual(std::wstring(), FileVersionCache::readVersionInfo(assemblyFile), L"file without version resources");
+	}
+
+	TEST_METHOD(WorkerRunsAllTasksBeforeStopping)
+	{
+		int runs = 0;
+		BackgroundWorker worker;
+		for (int i = 0; i < 100; i++) {
+			worker.post([&runs]() { runs++; });
+		}
+		worker.stop();
+		worker.post([&runs]() { runs++; });
+		Assert::AreEqual(100, runs, L"number of tasks run");
+	}
+
+private:
+	const wchar_t* VERSION_INFO = L" FileVersion:1.2.3.4 ProductVersion:1.2.0.0";
+
+	std::wstring cacheFile;
+	std::wstring assemblyFile;
+
+	void writeAssembly(const std::string& content) {
+		std::ofstream(assemblyFile, std::ios::binary) << content;
+	}
+
+	FileVersionCache::VersionReader countingReader(int& reads) {
+		const wchar_t* versionInfo = VERSION_INFO;
+		return [&reads, versionInfo](const std::wstring&) {
+			reads++;
+			return std::wstring(versionInfo);
+		};
+	}
+};
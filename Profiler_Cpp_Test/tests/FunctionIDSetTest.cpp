@@ -13,6 +13,29 @@ using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 TEST_CLASS(FunctionIDSetTest)
 {
 public:
+	TEST_METHOD(ClearResetsTheSizeAfterGrowing)
+	{
+		FunctionIdSet testSet;
+		unsigned int defaultSize = testSet.size();
+		for (FunctionID f = 1; f <= 200'000; f++) {
+			testSet.insert(f);
+		}
+		Assert::IsTrue(testSet.size() > defaultSize, L"must grow");
+
+		testSet.clear();
+		Assert::AreEqual(defaultSize, testSet.size(), L"size after clear");
+		Assert::IsFalse(testSet.contains(1), L"must be empty after clear");
+
+		// Would write past the end of the array if the clear kept the mask of the grown array
+		for (FunctionID f = 1; f <= 200'000; f++) {
+			testSet.insert(f * 8);
+		}
+		for (FunctionID f = 1; f <= 200'000; f++) {
+			Assert::IsTrue(testSet.contains(f * 8), L"must contain all inserted functions");
+		}
+		Assert::IsFalse(testSet.contains(4), L"must not contain functions that were never inserted");
+	}
+
 	TEST_METHOD(SetPerformanceTest)
 	{
 		std::vector<int> vec;
@@ -0,0 +1,117 @@
+#include "CppUnitTest.h"
+#include <atomic>
+#include <chrono>
+#include <cor.h>
+#include <corprof.h>
+#include <string>
+#include <vector>
+#include "utils/FunctionIdSet/FunctionIdCounter.h"
+#include "utils/FunctionIdSet/FunctionIdSet.h"
+
+using namespace Profiler;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+TEST_CLASS(FunctionIdCounterTest)
+{
+public:
+
+	TEST_METHOD(CountsCalls)
+	{
+		FunctionIdCounter counter;
+		Assert::IsTrue(counter.find(42) == nullptr, L"must not contain functions that were never added");
+
+		counter.add(42);
+		counter.add(42);
+		FunctionIdCounter::increment(counter.find(42));
+		counter.add(4711);
+
+		Assert::AreEqual(3L, static_cast<long>(*counter.find(42)), L"calls of 42");
+		Assert::AreEqual(1L, static_cast<long>(*counter.find(4711)), L"calls of 4711");
+	}
+
+	TEST_METHOD(KeepsCountsWhenGrowing)
+	{
+		FunctionIdCounter counter;
+		for (FunctionID i = 1; i <= 200'000; i++) {
+			counter.add(i);
+			counter.add(i);
+		}
+
+		unsigned int elements = 0;
+		for (unsigned int i = 0; i < counter.size(); i++) {
+			if (counter.at(i) != 0) {
+				elements++;
+				Assert::AreEqual(2UL, counter.countAt(i), L"count after resize");
+			}
+		}
+		Assert::AreEqual(200'000U, elements, L"number of functions");
+
+		counter.clear();
+		Assert::IsTrue(counter.find(1) == nullptr, L"must be empty after clear");
+	}
+
+	TEST_METHOD(ClearDoesNotAffectCountersOfReaders)
+	{
+		FunctionIdCounter counter;
+		counter.add(42);
+		// What a thread in the enter hook may hold while another thread clears the counter
+		std::atomic<LONG>* count = counter.find(42);
+
+		counter.clear();
+		FunctionIdCounter::increment(count);
+		Assert::AreEqual(2L, static_cast<long>(*count), L"counter of a reader must stay valid after the clear");
+		Assert::IsTrue(counter.find(42) == nullptr, L"a late increment must not be credited after the clear");
+
+		counter.add(42);
+		Assert::AreEqual(1L, static_cast<long>(*counter.find(42)), L"calls after the clear");
+	}
+
+	TEST_METHOD(CountersSaturate)
+	{
+		FunctionIdCounter counter;
+		counter.add(42);
+		std::atomic<LONG>* count = counter.find(42);
+		*count = FunctionIdCounter::SATURATION - 1;
+
+		FunctionIdCounter::increment(count);
+		FunctionIdCounter::increment(count);
+
+		Assert::AreEqual(static_cast<long>(FunctionIdCounter::SATURATION), static_cast<long>(*count), L"saturated count");
+	}
+
+	TEST_METHOD(CountingPerformanceTest)
+	{
+		std::vector<FunctionID> calls;
+		for (int i = 0; i < 10'000'000; i++) {
+			calls.push_back((std::rand() % 20'000) + 1);
+		}
+
+		// What the enter hook does when only recording whether a method was called
+		FunctionIdSet set;
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		for (FunctionID f : calls) {
+			if (!set.contains(f)) {
+				set.insert(f);
+			}
+		}
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+		std::string message = "Time Difference Set = " + std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count()) + " [mikrosekunden]\n";
+		Logger::WriteMessage(message.c_str());
+
+		// What the enter hook does when counting calls
+		FunctionIdCounter counter;
+		std::chrono::steady_clock::time_point begin2 = std::chrono::steady_clock::now();
+		for (FunctionID f : calls) {
+			std::atomic<LONG>* count = counter.find(f);
+			if (count != nullptr) {
+				FunctionIdCounter::increment(count);
+			}
+			else {
+				counter.add(f);
+			}
+		}
+		std::chrono::steady_clock::time_point end2 = std::chrono::steady_clock::now();
+		std::string message2 = "Time Difference Counter = " + std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(end2 - begin2).count()) + " [mikrosekunden]\n";
+		Logger::WriteMessage(message2.c_str());
+	}
+};
@@ -0,0 +1,61 @@
+#include "CppUnitTest.h"
+#include "utils/GlobPatternList.h"
+
+using namespace Profiler;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+TEST_CLASS(GlobPatternListTest)
+{
+public:
+
+	TEST_METHOD(EmptyListMatchesEverything)
+	{
+		GlobPatternList patterns("", "");
+		Assert::IsTrue(patterns.isEmpty());
+		Assert::IsTrue(patterns.matches(L"MyProduct"));
+		Assert::IsTrue(patterns.matches(L""));
+	}
+
+	TEST_METHOD(PatternsMustMatchEntireText)
+	{
+		GlobPatternList patterns("MyProduct", "");
+		Assert::IsTrue(patterns.matches(L"MyProduct"));
+		Assert::IsFalse(patterns.matches(L"MyProduct.Core"));
+		Assert::IsFalse(patterns.matches(L"TheMyProduct"));
+	}
+
+	TEST_METHOD(Wildcards)
+	{
+		GlobPatternList patterns("MyProduct*;MyCompany.?x*", "");
+		Assert::IsTrue(patterns.matches(L"MyProduct"));
+		Assert::IsTrue(patterns.matches(L"MyProduct.Core"));
+		Assert::IsTrue(patterns.matches(L"MyCompany.Ax"));
+		Assert::IsTrue(patterns.matches(L"MyCompany.Axxx"));
+		Assert::IsFalse(patterns.matches(L"MyCompany.x"));
+		Assert::IsFalse(patterns.matches(L"System.Core"));
+	}
+
+	TEST_METHOD(StarsBacktrack)
+	{
+		GlobPatternList patterns("*.Core.*Tests", "");
+		Assert::IsTrue(patterns.matches(L"A.Core.B.Core.UnitTests"));
+		Assert::IsFalse(patterns.matches(L"A.Core.Tests.Helper"));
+	}
+
+	TEST_METHOD(MatchingIsCaseInsensitive)
+	{
+		GlobPatternList patterns("myproduct*", "");
+		Assert::IsTrue(patterns.matches(L"MyProduct.Core"));
+	}
+
+	TEST_METHOD(ExcludesWinOverIncludes)
+	{
+		GlobPatternList patterns("MyProduct*", "*Tests");
+		Assert::IsTrue(patterns.matches(L"MyProduct.Core"));
+		Assert::IsFalse(patterns.matches(L"MyProduct.Core.Tests"));
+
+		GlobPatternList excludesOnly("", "System*;Microsoft*");
+		Assert::IsTrue(excludesOnly.matches(L"MyProduct"));
+		Assert::IsFalse(excludesOnly.matches(L"System.Private.CoreLib"));
+	}
+};
@@ -0,0 +1,47 @@
+#include "CppUnitTest.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "utils/IdleTimer.h"
+
+using namespace Profiler;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+TEST_CLASS(IdleTimerTest)
+{
+public:
+
+	TEST_METHOD(CallsCallbackOnceWhenIdle)
+	{
+		std::atomic<int> calls(0);
+		IdleTimer timer(std::chrono::milliseconds(20), [&calls]() { calls++; });
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+		Assert::AreEqual(1, calls.load(), L"called exactly once");
+	}
+
+	TEST_METHOD(ActivityPostponesCallback)
+	{
+		std::atomic<int> calls(0);
+		IdleTimer timer(std::chrono::milliseconds(100), [&calls]() { calls++; });
+
+		for (int i = 0; i < 20; i++) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			timer.reportActivity();
+		}
+		Assert::AreEqual(0, calls.load(), L"not idle while there is activity");
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(500));
+		Assert::AreEqual(1, calls.load(), L"called once idle");
+	}
+
+	TEST_METHOD(StopPreventsCallback)
+	{
+		std::atomic<int> calls(0);
+		IdleTimer timer(std::chrono::milliseconds(50), [&calls]() { calls++; });
+		timer.stop();
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(150));
+		Assert::AreEqual(0, calls.load(), L"not called after stop");
+	}
+};
@@ -0,0 +1,117 @@
+#include "CppUnitTest.h"
+#include <thread>
+#include "utils/MethodEnter.h"
+
+using namespace Profiler;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+TEST_CLASS(MethodEnterTest)
+{
+public:
+
+	TEST_METHOD_INITIALIZE(SetUpRecording)
+	{
+		setLock(&lock);
+		setCalledMethodsSet(&processCalledFunctions);
+		setCalledMethodsCounter(nullptr);
+		setTestCaseRecording(false);
+	}
+
+	TEST_METHOD_CLEANUP(StopRecording)
+	{
+		setTestContextRecording(CONTEXT_ID, nullptr, nullptr);
+		SetTestContext(0);
+		setTestCaseRecording(false);
+		setSamplingInterval(0);
+		setCalledMethodsCounter(nullptr);
+		setCalledMethodsSet(nullptr);
+		setLock(nullptr);
+	}
+
+	TEST_METHOD(CallsOfBoundThreadsAreRecordedForTheTestOfTheContext)
+	{
+		FunctionIdSet contextCalledFunctions;
+		SetTestContext(CONTEXT_ID);
+		setTestContextRecording(CONTEXT_ID, &contextCalledFunctions, nullptr);
+
+		enter(0x1000);
+
+		Assert::IsTrue(contextCalledFunctions.contains(0x1000), L"call recorded for the context");
+		Assert::IsFalse(processCalledFunctions.contains(0x1000), L"call not recorded for the process-wide test case");
+	}
+
+	TEST_METHOD(NextTestInTheSameContextOnlyRecordsItsOwnCalls)
+	{
+		FunctionIdSet contextCalledFunctions;
+		SetTestContext(CONTEXT_ID);
+		setTestContextRecording(CONTEXT_ID, &contextCalledFunctions, nullptr);
+		enter(0x1000);
+		setTestContextRecording(CONTEXT_ID, nullptr, nullptr);
+		lock.enter();
+		contextCalledFunctions.clear();
+		lock.leave();
+
+		enter(0x2000);
+		setTestContextRecording(CONTEXT_ID, &contextCalledFunctions, nullptr);
+		enter(0x3000);
+
+		Assert::IsFalse(contextCalledFunctions.contains(0x1000), L"call of the previous test");
+		Assert::IsFalse(contextCalledFunctions.contains(0x2000), L"call between the tests");
+		Assert::IsTrue(contextCalledFunctions.contains(0x3000), L"call of the next test");
+	}
+
+	TEST_METHOD(SamplingRecordsOneInIntervalCallsOnAverage)
+	{
+		FunctionIdCounter counter;
+		setCalledMethodsCounter(&counter);
+		setSamplingInterval(10);
+		setTestCaseRecording(true);
+
+		// A new thread, so that the sampling state of other tests on this thread doesn't matter
+		std::thread([]() {
+			for (int i = 0; i < 100'000; i++) {
+				enter(0x1000);
+			}
+		}).join();
+
+		LONG count = *counter.find(0x1000);
+		Assert::IsTrue(count >= 9'000 && count <= 11'000, (L"recorded calls: " + std::to_wstring(count)).c_str());
+	}
+
+	TEST_METHOD(SamplingRecordsTheFirstCallOfAThread)
+	{
+		setSamplingInterval(1000);
+		setTestCaseRecording(true);
+
+		std::thread([]() {
+			enter(0x1000);
+		}).join();
+
+		Assert::IsTrue(processCalledFunctions.contains(0x1000), L"first call recorded");
+	}
+
+	TEST_METHOD(SamplingDoesNotRecordOutsideOfTests)
+	{
+		setSamplingInterval(10);
+
+		std::thread([]() {
+			for (int i = 0; i < 100; i++) {
+				enter(0x1000);
+			}
+		}).join();
+
+		Assert::IsFalse(processCalledFunctions.contains(0x1000), L"calls outside of tests");
+	}
+
+private:
+	static const unsigned int CONTEXT_ID = 1;
+
+	Lock lock;
+	FunctionIdSet processCalledFunctions;
+
+	static void enter(FunctionID id) {
+		FunctionIDOrClientID functionId;
+		functionId.functionID = id;
+		EnterCpp(functionId);
+	}
+};
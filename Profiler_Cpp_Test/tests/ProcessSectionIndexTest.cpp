@@ -0,0 +1,107 @@
+#include "CppUnitTest.h"
+#include <chrono>
+#include <string>
+#include <vector>
+#include "config/ProcessSectionIndex.h"
+
+using namespace Profiler;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+TEST_CLASS(ProcessSectionIndexTest)
+{
+public:
+
+	TEST_METHOD(RequiredLiterals)
+	{
+		Assert::AreEqual(std::string(""), ProcessSectionIndex::getRequiredLiteral(".*"));
+		Assert::AreEqual(std::string("\\PROGRAM.EXE"), ProcessSectionIndex::getRequiredLiteral(".*\\\\program\\.exe"));
+		Assert::AreEqual(std::string("\\BIN\\"), ProcessSectionIndex::getRequiredLiteral("c:\\\\x?\\\\bin\\\\[a-z]+\\.exe"));
+		Assert::AreEqual(std::string("PROGRA"), ProcessSectionIndex::getRequiredLiteral("program?\\d{2,3}\\.exe"));
+		Assert::AreEqual(std::string("PROG"), ProcessSectionIndex::getRequiredLiteral(".*(foo)?prog(x|y)"));
+		Assert::AreEqual(std::string(""), ProcessSectionIndex::getRequiredLiteral(".*foo\\.exe|.*bar\\.exe"));
+		Assert::AreEqual(std::string("ABC"), ProcessSectionIndex::getRequiredLiteral("[|.*]abc+"));
+		Assert::AreEqual(std::string("EXE"), ProcessSectionIndex::getRequiredLiteral("a\\x2eexe"));
+		Assert::AreEqual(std::string("PP.EXE"), ProcessSectionIndex::getRequiredLiteral("\\u0041pp\\.exe"));
+		Assert::AreEqual(std::string("ABC"), ProcessSectionIndex::getRequiredLiteral("\\cJabc"));
+		Assert::AreEqual(std::string("AB"), ProcessSectionIndex::getRequiredLiteral("(a)\\1234ab"));
+	}
+
+	TEST_METHOD(MatchesLikeTheRegexesInConfigFileOrder)
+	{
+		ConfigFile configFile;
+		addSection(configFile, ".*", "");
+		addSection(configFile, ".*\\\\program\\.exe", "");
+		addSection(configFile, ".*", "PROGRAM.exe");
+		addSection(configFile, "c:\\\\company\\\\.*", "");
+		addSection(configFile, ".*", "other.exe");
+		addSection(configFile, ".*\\\\other\\\\.*", "program.exe");
+		addSection(configFile, ".*(foo|prog)ram\\.exe", "");
+		addSection(configFile, ".*\\x5cprogram\\x2eexe", "");
+		addSection(configFile, ".*\\u005cOther\\u005c.*", "");
+		ProcessSectionIndex index(configFile);
+
+		std::vector<std::string> paths = { "c:\\company\\program.exe", "C:\\Company\\Other\\Program.exe", "c:\\other.exe", "d:\\foo.exe", "program.exe" };
+		for (const std::string& path : paths) {
+			std::vector<size_t> expected;
+			for (size_t i = 0; i < configFile.sections.size(); i++) {
+				if (matchesWithoutIndex(configFile.sections[i], path)) {
+					expected.push_back(i);
+				}
+			}
+			Assert::IsTrue(expected == index.findMatchingSections(path), std::wstring(path.begin(), path.end()).c_str());
+		}
+	}
+
+	TEST_METHOD(MatchingPerformanceTest)
+	{
+		ConfigFile configFile;
+		for (int i = 0; i < 500; i++) {
+			if (i % 2 == 0) {
+				addSection(configFile, ".*\\\\application" + std::to_string(i) + "\\\\.*\\.exe", "");
+			}
+			else {
+				addSection(configFile, ".*", "service" + std::to_string(i) + ".exe");
+			}
+		}
+		std::string path = "c:\\program files\\company\\application250\\bin\\service251.exe";
+		const int lookups = 100;
+
+		size_t matches = 0;
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		for (int i = 0; i < lookups; i++) {
+			for (const ProcessSection& section : configFile.sections) {
+				matches += matchesWithoutIndex(section, path);
+			}
+		}
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+		std::chrono::steady_clock::time_point begin2 = std::chrono::steady_clock::now();
+		for (int i = 0; i < lookups; i++) {
+			matches += ProcessSectionIndex(configFile).findMatchingSections(path).size();
+		}
+		std::chrono::steady_clock::time_point end2 = std::chrono::steady_clock::now();
+
+		std::string message = "Time Difference Linear = " + std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count()) + " [mikrosekunden]\n";
+		std::string message2 = "Time Difference Index = " + std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(end2 - begin2).count()) + " [mikrosekunden]\n";
+		Logger::WriteMessage(message.c_str());
+		Logger::WriteMessage(message2.c_str());
+		Assert::AreEqual(size_t(4 * lookups), matches, L"number of matches");
+	}
+
+private:
+	void addSection(ConfigFile& configFile, const std::string& pattern, const std::string& executableName) {
+		ProcessSection section;
+		section.executablePathPattern = pattern;
+		section.caseInsensitiveExecutableName = executableName;
+		configFile.sections.push_back(section);
+	}
+
+	/** How sections were matched before they were indexed. */
+	static bool matchesWithoutIndex(const ProcessSection& section, const std::string& path) {
+		if (!std::regex_match(path, ConfigParser::compileExecutablePathRegex(section.executablePathPattern))) {
+			return false;
+		}
+		return section.caseInsensitiveExecutableName.empty()
+			|| StringUtils::equalsIgnoreCase(section.caseInsensitiveExecutableName, StringUtils::getLastPartOfPath(path));
+	}
+};
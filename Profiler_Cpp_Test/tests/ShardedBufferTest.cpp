@@ -0,0 +1,162 @@
+#include "CppUnitTest.h"
+#include <chrono>
+#include <cor.h>
+#include <corprof.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include "utils/ShardedBuffer.h"
+#include "utils/FunctionIdSet/ConcurrentFunctionIdSet.h"
+
+using namespace Profiler;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+TEST_CLASS(ShardedBufferTest)
+{
+public:
+
+	TEST_METHOD(DrainsAllElements)
+	{
+		const int threadCount = 8;
+		const int elementsPerThread = 100'000;
+		ShardedBuffer<FunctionID> buffer;
+
+		std::vector<std::thread> threads;
+		for (int t = 0; t < threadCount; t++) {
+			threads.emplace_back([&buffer, t, elementsPerThread]() {
+				for (int i = 0; i < elementsPerThread; i++) {
+					buffer.push(t * elementsPerThread + i + 1);
+				}
+			});
+		}
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+		Assert::AreEqual(static_cast<LONG>(threadCount * elementsPerThread), buffer.size(), L"size before drain");
+
+		std::vector<FunctionID> drained;
+		buffer.drainTo(drained);
+		Assert::AreEqual(static_cast<size_t>(threadCount * elementsPerThread), drained.size(), L"drained elements");
+		Assert::AreEqual(0L, static_cast<long>(buffer.size()), L"size after drain");
+
+		std::vector<bool> seen(threadCount * elementsPerThread + 1);
+		for (FunctionID f : drained) {
+			Assert::IsFalse(seen[f], L"no element may be drained twice");
+			seen[f] = true;
+		}
+	}
+
+	TEST_METHOD(DrainWhilePushing)
+	{
+		const int threadCount = 8;
+		const int elementsPerThread = 100'000;
+		ShardedBuffer<FunctionID> buffer;
+		std::vector<FunctionID> drained;
+
+		std::vector<std::thread> threads;
+		for (int t = 0; t < threadCount; t++) {
+			threads.emplace_back([&buffer, elementsPerThread]() {
+				for (int i = 0; i < elementsPerThread; i++) {
+					buffer.push(i + 1);
+				}
+			});
+		}
+		for (int i = 0; i < 100; i++) {
+			buffer.drainTo(drained);
+		}
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+		buffer.drainTo(drained);
+
+		Assert::AreEqual(static_cast<size_t>(threadCount * elementsPerThread), drained.size(), L"no element may be lost");
+	}
+
+	/**
+	 * Replays the callbacks of a multi-threaded JIT workload, i.e. a mix of compilations and inlinings of
+	 * overlapping functions with eager writing, once with the nested global locks that every callback used to
+	 * take and once with the sharded buffers and a single writer that the profiler uses now.
+	 */
+	TEST_METHOD(ReplayedCallbackContentionTest)
+	{
+		const int threadCount = 8;
+		const int callbacksPerThread = 1'000'000;
+		const LONG eagerness = 1000;
+
+		// Every fourth callback is a compilation, the others inline one of a smaller set of callees
+		std::vector<std::vector<FunctionID>> workload(threadCount);
+		for (int t = 0; t < threadCount; t++) {
+			for (int i = 0; i < callbacksPerThread; i++) {
+				workload[t].push_back(i % 4 == 0 ? t * callbacksPerThread + i + 1 : (std::rand() % 50'000) + 1);
+			}
+		}
+
+		CRITICAL_SECTION callbackSynchronization;
+		CRITICAL_SECTION methodSetSynchronization;
+		InitializeCriticalSection(&callbackSynchronization);
+		InitializeCriticalSection(&methodSetSynchronization);
+		std::vector<FunctionID> recordedFunctions;
+		size_t writtenFunctions = 0;
+		long long nestedLocking = replay(workload, [&](FunctionID f, bool isCompilation, ConcurrentFunctionIdSet& inlinedIds) {
+			if (isCompilation || (!inlinedIds.contains(f) && inlinedIds.insert(f))) {
+				EnterCriticalSection(&callbackSynchronization);
+				EnterCriticalSection(&methodSetSynchronization);
+				recordedFunctions.push_back(f);
+				if (static_cast<LONG>(recordedFunctions.size()) >= eagerness) {
+					writtenFunctions += recordedFunctions.size();
+					recordedFunctions.clear();
+				}
+				LeaveCriticalSection(&methodSetSynchronization);
+				LeaveCriticalSection(&callbackSynchronization);
+			}
+		});
+		DeleteCriticalSection(&callbackSynchronization);
+		DeleteCriticalSection(&methodSetSynchronization);
+
+		CRITICAL_SECTION writerSynchronization;
+		InitializeCriticalSection(&writerSynchronization);
+		ShardedBuffer<FunctionID> buffer;
+		std::vector<FunctionID> drainedFunctions;
+		size_t shardedWrittenFunctions = 0;
+		long long sharded = replay(workload, [&](FunctionID f, bool isCompilation, ConcurrentFunctionIdSet& inlinedIds) {
+			if (isCompilation || (!inlinedIds.contains(f) && inlinedIds.insert(f))) {
+				if (buffer.push(f) >= eagerness && TryEnterCriticalSection(&writerSynchronization)) {
+					buffer.drainTo(drainedFunctions);
+					shardedWrittenFunctions += drainedFunctions.size();
+					drainedFunctions.clear();
+					LeaveCriticalSection(&writerSynchronization);
+				}
+			}
+		});
+		DeleteCriticalSection(&writerSynchronization);
+		shardedWrittenFunctions += buffer.size();
+		Assert::AreEqual(writtenFunctions + recordedFunctions.size(), shardedWrittenFunctions, L"both variants must record the same functions");
+
+		std::string message = "Nested locks = " + std::to_string(nestedLocking) + " [mikrosekunden]\n";
+		std::string message2 = "Sharded buffers = " + std::to_string(sharded) + " [mikrosekunden]\n";
+		Logger::WriteMessage(message.c_str());
+		Logger::WriteMessage(message2.c_str());
+	}
+
+private:
+
+	/** Replays the workload with one thread per entry and returns the elapsed microseconds. */
+	template<typename Callback>
+	long long replay(const std::vector<std::vector<FunctionID>>& workload, Callback callback) {
+		ConcurrentFunctionIdSet inlinedIds;
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		std::vector<std::thread> threads;
+		for (const std::vector<FunctionID>& callbacks : workload) {
+			threads.emplace_back([&callbacks, &callback, &inlinedIds]() {
+				for (size_t i = 0; i < callbacks.size(); i++) {
+					callback(callbacks[i], i % 4 == 0, inlinedIds);
+				}
+			});
+		}
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+		return std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count();
+	}
+};
@@ -1,4 +1,6 @@
+#include <chrono>
 #include <sstream>
+#include <unordered_set>
 #include "CppUnitTest.h"
 #include "utils/StringUtils.h"
 
@@ -36,6 +38,61 @@ public:
 		Assert::IsFalse(StringUtils::equalsIgnoreCase("foo", "bar"));
 	}
 
+	TEST_METHOD(CaseInsensitiveContainers)
+	{
+		CaseInsensitiveStringMap map;
+		map["Light_Mode"] = "true";
+		Assert::IsTrue(map.find("light_mode") != map.end(), L"lookup with a literal");
+		Assert::IsTrue(map.find(std::string("LIGHT_MODE")) != map.end(), L"lookup with a string");
+		Assert::IsTrue(map.find("light_mod") == map.end(), L"prefix");
+		Assert::IsTrue(map.find("light_modes") == map.end(), L"extension");
+
+		std::unordered_set<std::string, StringUtils::CaseInsensitiveHash, StringUtils::CaseInsensitiveEquality> set;
+		set.insert("Program.exe");
+		Assert::IsTrue(set.find("PROGRAM.EXE") != set.end(), L"hash must ignore casing");
+		Assert::IsTrue(set.find("program.ex") == set.end(), L"prefix");
+
+		CaseInsensitiveLiteralSet literals;
+		literals.insert("light_mode");
+		literals.insert("LIGHT_MODE");
+		Assert::IsTrue(literals.size() == 1, L"literals that only differ in casing");
+		Assert::IsTrue(literals.find(std::string("Light_Mode")) != literals.end(), L"lookup of a literal with a string");
+	}
+
+	TEST_METHOD(CaseInsensitiveLookupPerformanceTest)
+	{
+		std::map<std::string, std::string, AllocatingComparator> allocatingMap;
+		CaseInsensitiveStringMap map;
+		for (int i = 0; i < 200; i++) {
+			allocatingMap["Profiler_Option_" + std::to_string(i)] = "value";
+			map["Profiler_Option_" + std::to_string(i)] = "value";
+		}
+		std::vector<std::string> keys;
+		for (int i = 0; i < 400; i++) {
+			keys.push_back("profiler_option_" + std::to_string(i));
+		}
+		const int lookups = 100000;
+
+		size_t found = 0;
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		for (int i = 0; i < lookups; i++) {
+			found += allocatingMap.count(keys[i % keys.size()]);
+		}
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+		std::chrono::steady_clock::time_point begin2 = std::chrono::steady_clock::now();
+		for (int i = 0; i < lookups; i++) {
+			found += map.count(keys[i % keys.size()]);
+		}
+		std::chrono::steady_clock::time_point end2 = std::chrono::steady_clock::now();
+
+		std::string message = "Time Difference Allocating = " + std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count()) + " [mikrosekunden]\n";
+		std::string message2 = "Time Difference In Place = " + std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(end2 - begin2).count()) + " [mikrosekunden]\n";
+		Logger::WriteMessage(message.c_str());
+		Logger::WriteMessage(message2.c_str());
+		Assert::AreEqual(size_t(lookups), found, L"number of found options");
+	}
+
 	TEST_METHOD(LastPartOfPath)
 	{
 		Assert::AreEqual(std::string("test.exe"), StringUtils::getLastPartOfPath("C:\\foo\\bar\\test.exe"));
@@ -47,4 +104,25 @@ public:
 		Assert::AreEqual(std::string("C:\\foo\\bar"), StringUtils::removeLastPartOfPath("C:\\foo\\bar\\test.exe"));
 		Assert::AreEqual(std::string("C:\\foo"), StringUtils::removeLastPartOfPath("C:\\foo\\bar"));
 	}
+
+	TEST_METHOD(Split)
+	{
+		std::vector<std::string> parts = StringUtils::split("a;;bc;", ';');
+		Assert::AreEqual(size_t(2), parts.size());
+		Assert::AreEqual(std::string("a"), parts[0]);
+		Assert::AreEqual(std::string("bc"), parts[1]);
+		Assert::AreEqual(size_t(0), StringUtils::split("", ';').size());
+	}
+
+private:
+	/** How CaseInsensitiveComparator used to compare, copying both strings. */
+	struct AllocatingComparator {
+		bool operator() (const std::string& s1, const std::string& s2) const {
+			std::string str1(s1.length(), ' ');
+			std::string str2(s2.length(), ' ');
+			std::transform(s1.begin(), s1.end(), str1.begin(), ::tolower);
+			std::transform(s2.begin(), s2.end(), str2.begin(), ::tolower);
+			return str1 < str2;
+		}
+	};
 };
\ No newline at end of file
@@ -0,0 +1,46 @@
+#include "CppUnitTest.h"
+#include <string>
+#include <vector>
+#include "utils/TestCoverage.h"
+
+using namespace Profiler;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+TEST_CLASS(TestCoverageTest)
+{
+public:
+
+	TEST_METHOD(GroupsSortedMethodsByAssembly)
+	{
+		std::vector<FunctionInfo> methods = { { 2, 0x06000010 }, { 1, 0x06000003 }, { 2, 0x06000001 }, { 1, 0x06000003 }, { 0, 0x06000005 } };
+
+		std::string frame = TestCoverage::encode("T", methods, [](int assemblyNumber) {
+			return assemblyNumber == 1 ? std::string("A") : std::string("Bc");
+			});
+
+		std::string expected("\x01" "\x01\0\0\0" "T" "\x02\0\0\0"
+			"\x01\0\0\0" "A" "\x01\0\0\0" "\x83\x80\x80\x30"
+			"\x02\0\0\0" "Bc" "\x02\0\0\0" "\x81\x80\x80\x30" "\x0F", 38);
+		Assert::IsTrue(expected == frame);
+	}
+
+	TEST_METHOD(EmptyCoverage)
+	{
+		std::string frame = TestCoverage::encode("", {}, [](int) { return std::string(); });
+
+		Assert::IsTrue(std::string("\x01\0\0\0\0\0\0\0\0", 9) == frame);
+	}
+
+	TEST_METHOD(IsSmallerThanTraceFileLines)
+	{
+		std::vector<FunctionInfo> methods;
+		for (mdToken token = 0x06000001; token < 0x06000001 + 1000; token += 2) {
+			methods.push_back({ 1, token });
+		}
+
+		std::string frame = TestCoverage::encode("T", methods, [](int) { return std::string("Assembly"); });
+
+		// each further method costs a single byte, compared to e.g. "Called=1:100663297\r\n" in the trace file
+		Assert::AreEqual(size_t(1 + 5 + 4 + 12 + 4 + 4 + 499), frame.size());
+	}
+};
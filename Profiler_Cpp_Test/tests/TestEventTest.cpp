@@ -0,0 +1,77 @@
+#include "CppUnitTest.h"
+#include <string>
+#include "utils/TestEvent.h"
+
+using namespace Profiler;
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+TEST_CLASS(TestEventTest)
+{
+public:
+
+	TEST_METHOD(RoundTrip)
+	{
+		TestEvent event;
+		event.type = TestEvent::Type::END;
+		event.sequenceNumber = 0x0102030405060708ULL;
+		event.timestamp = 1700000000123LL;
+		event.testName = "";
+		event.result = "PASSED";
+		event.durationMilliseconds = -1;
+		event.contextId = 7;
+
+		TestEvent decoded;
+		std::string frame = event.encode();
+		Assert::IsTrue(TestEvent::decode(frame.data(), frame.size(), decoded));
+		Assert::IsTrue(TestEvent::Type::END == decoded.type);
+		Assert::IsTrue(event.sequenceNumber == decoded.sequenceNumber, L"sequence number");
+		Assert::AreEqual(event.timestamp, decoded.timestamp);
+		Assert::AreEqual(event.result, decoded.result);
+		Assert::AreEqual(event.durationMilliseconds, decoded.durationMilliseconds);
+		Assert::AreEqual(event.contextId, decoded.contextId);
+	}
+
+	TEST_METHOD(EncodesLittleEndian)
+	{
+		TestEvent event;
+		event.type = TestEvent::Type::START;
+		event.sequenceNumber = 258;
+		event.testName = "a";
+
+		std::string expected("\x01\x01\x02\x01\0\0\0\0\0\0" "\0\0\0\0\0\0\0\0" "\0\0\0\0\0\0\0\0" "\0\0\0\0" "\x01\0\0\0" "a" "\0\0\0\0", 39);
+		Assert::IsTrue(expected == event.encode());
+	}
+
+	TEST_METHOD(PreservesLongTestNames)
+	{
+		TestEvent event;
+		event.type = TestEvent::Type::START;
+		event.testName = std::string(10000, 'x') + ":with:colons";
+
+		TestEvent decoded;
+		std::string frame = event.encode();
+		Assert::IsTrue(TestEvent::decode(frame.data(), frame.size(), decoded));
+		Assert::AreEqual(event.testName, decoded.testName);
+	}
+
+	TEST_METHOD(RejectsMalformedFrames)
+	{
+		TestEvent event;
+		event.type = TestEvent::Type::START;
+		event.testName = "test";
+		std::string frame = event.encode();
+
+		TestEvent decoded;
+		for (size_t size = 0; size < frame.size(); size++) {
+			Assert::IsFalse(TestEvent::decode(frame.data(), size, decoded), L"truncated frame");
+		}
+
+		std::string otherVersion = frame;
+		otherVersion[0] = 2;
+		Assert::IsFalse(TestEvent::decode(otherVersion.data(), otherVersion.size(), decoded), L"unknown version");
+
+		std::string unknownType = frame;
+		unknownType[1] = 3;
+		Assert::IsFalse(TestEvent::decode(unknownType.data(), unknownType.size(), decoded), L"unknown type");
+	}
+};
@@ -2,8 +2,11 @@
 using Cqse.Teamscale.Profiler.Dotnet.Proxies;
 using Cqse.Teamscale.Profiler.Dotnet.Tia;
 using NUnit.Framework;
+using System;
+using System.Diagnostics;
 using System.IO;
 using System.Linq;
+using System.Threading;
 
 namespace Cqse.Teamscale.Profiler.Dotnet
 {
@@ -291,6 +294,86 @@ match:
             AssertNormalizedTraceFileEqualsReference(profiler.GetSingleTrace(), expectedAssemblyIds);
         }
 
+        /// <summary>
+        /// Makes sure that a disabled profiler detaches from the process, which keeps running without it.
+        /// </summary>
+        [Test]
+        public void TestDetachesWhenDisabled()
+        {
+            var configFile = Path.Combine(TestTempDirectory, "profilerconfig.yml");
+            File.WriteAllText(configFile, @"
+match:
+  - profiler:
+      enabled: false
+");
+            profiler.ConfigFilePath = configFile;
+
+            TesteeProcess process = StartInteractive();
+            AssertProfilerDetaches(process, TimeSpan.FromSeconds(30));
+            RunInteractive(process, "A");
+            StopInteractive(process);
+
+            Assert.That(profiler.GetTraceFiles(), Is.Empty);
+        }
+
+        /// <summary>
+        /// Makes sure that the profiler writes the recorded methods and detaches once no new methods were jitted for the configured time.
+        /// </summary>
+        [Test]
+        public void TestDetachesWhenIdle()
+        {
+            var configFile = Path.Combine(TestTempDirectory, "profilerconfig.yml");
+            File.WriteAllText(configFile, @"
+match:
+  - profiler:
+      detach_after_idle_minutes: 1
+");
+            profiler.ConfigFilePath = configFile;
+
+            TesteeProcess process = StartInteractive();
+            RunInteractive(process, "A");
+            AssertProfilerDetaches(process, TimeSpan.FromMinutes(3));
+            RunInteractive(process, "B");
+            StopInteractive(process);
+
+            string[] lines = profiler.GetSingleTrace();
+            Assert.That(lines, Has.Some.StartsWith("Info=No new methods for 1 minutes. Detaching"));
+            Assert.That(lines, Has.Some.StartsWith(LABEL_JITTED));
+            Assert.That(lines.Last(), Does.StartWith("Stopped="));
+            Assert.That(profiler.GetAttachLog()[1], Does.StartWith("Detach"));
+        }
+
+        private TesteeProcess StartInteractive()
+        {
+            TesteeProcess process = new Testee(GetTestProgram("ProfilerTestee.exe")).Start(profiler, arguments: "interactive");
+            Assert.That(process.Output.ReadLine(), Is.EqualTo("interactive"));
+            return process;
+        }
+
+        private static void RunInteractive(TesteeProcess process, string method)
+        {
+            process.Input.WriteLine(method);
+            Assert.That(process.Output.ReadLine(), Is.EqualTo(method));
+        }
+
+        private static void StopInteractive(TesteeProcess process)
+        {
+            // process terminates on "empty" input
+            process.Input.WriteLine();
+            process.WaitForExit();
+        }
+
+        private void AssertProfilerDetaches(TesteeProcess process, TimeSpan timeout)
+        {
+            string profilerDll = Path.GetFileName(profiler.Profiler64Dll);
+            Stopwatch stopwatch = Stopwatch.StartNew();
+            while (process.HasLoadedModule(profilerDll))
+            {
+                Assert.That(stopwatch.Elapsed, Is.LessThan(timeout), "The profiler did not detach");
+                Thread.Sleep(TimeSpan.FromMilliseconds(500));
+            }
+        }
+
         [Test]
         public void TestAttachLog()
         {
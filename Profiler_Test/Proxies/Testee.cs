@@ -1,7 +1,9 @@
 ﻿using Cqse.Teamscale.Profiler.Dotnet.Proxies;
 using NUnit.Framework;
+using System;
 using System.Diagnostics;
 using System.IO;
+using System.Linq;
 
 namespace Cqse.Teamscale.Profiler.Dotnet.Proxies
 {
@@ -61,6 +63,15 @@ namespace Cqse.Teamscale.Profiler.Dotnet.Proxies
 
         public bool HasExited => process.HasExited;
 
+        /// <summary>
+        /// Whether the process currently has a module with the given file name loaded, e.g. the profiler DLL.
+        /// </summary>
+        public bool HasLoadedModule(string fileName)
+        {
+            process.Refresh();
+            return process.Modules.Cast<ProcessModule>().Any(module => string.Equals(module.ModuleName, fileName, StringComparison.OrdinalIgnoreCase));
+        }
+
         public TesteeProcess(Process process)
         {
             this.process = process;
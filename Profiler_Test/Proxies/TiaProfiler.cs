@@ -15,6 +15,11 @@ namespace Cqse.Teamscale.Profiler.Dotnet.Proxies
     {
         private readonly IpcConfig ipcConfig;
 
+        /// <summary>
+        /// Whether the profiler sends the coverage of each test to the IPC server.
+        /// </summary>
+        public bool StreamTestCoverage { get; set; } = false;
+
         public TiaProfiler(DirectoryInfo basePath, DirectoryInfo targetDir, IpcConfig ipcConfig) : base(basePath, targetDir)
         {
             this.ipcConfig = ipcConfig;
@@ -27,6 +32,10 @@ namespace Cqse.Teamscale.Profiler.Dotnet.Proxies
             
             processInfo.Environment["COR_PROFILER_TIA"] = "true";
             processInfo.Environment["COR_PROFILER_TIA_REQUEST_SOCKET"] = ipcConfig.PublishSocket;
+            if (StreamTestCoverage)
+            {
+                processInfo.Environment["COR_PROFILER_TIA_STREAM_COVERAGE"] = "true";
+            }
         }
 
         /// <summary>
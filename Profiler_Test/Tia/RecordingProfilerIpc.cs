@@ -12,6 +12,10 @@ namespace Cqse.Teamscale.Profiler.Dotnet.Tia
 
         public IEnumerable<string> ReceivedRequests => receivedRequests;
 
+        private readonly ConcurrentQueue<TestCoverage> receivedTestCoverage = new ConcurrentQueue<TestCoverage>();
+
+        public IEnumerable<TestCoverage> ReceivedTestCoverage => receivedTestCoverage;
+
         public RecordingProfilerIpc(IpcConfig config = null) : base(config ?? CreateIpcConfigWithRandomPorts())
         {
             // empty, just delegate
@@ -23,6 +27,12 @@ namespace Cqse.Teamscale.Profiler.Dotnet.Tia
             return base.HandleRequest(message);
         }
 
+        protected override void HandleTestCoverage(TestCoverage testCoverage)
+        {
+            receivedTestCoverage.Enqueue(testCoverage);
+            base.HandleTestCoverage(testCoverage);
+        }
+
         private static IpcConfig CreateIpcConfigWithRandomPorts()
             => new IpcConfig("tcp://127.0.0.1:" + GetAvailablePort(), "tcp://127.0.0.1:" + GetAvailablePort());
 
@@ -3,6 +3,7 @@ using Cqse.Teamscale.Profiler.Dotnet.Proxies;
 using NUnit.Framework;
 using System;
 using System.Collections.Generic;
+using System.Linq;
 using System.Threading;
 using static Cqse.Teamscale.Profiler.Dotnet.Proxies.TiaProfiler;
 
@@ -119,6 +120,22 @@ namespace Cqse.Teamscale.Profiler.Dotnet.Tia
             Assert.That(testResult["A"][2].TraceLines, Has.None.StartsWith("Jitted=2").And.One.StartsWith("Called=2"));
         }
 
+        [Test]
+        public void StreamsTestCoverage()
+        {
+            profilerUnderTest.StreamTestCoverage = true;
+            TesteeProcess testeeProcess = Start(testee, profilerUnderTest);
+            RunTestCase("A", testeeProcess, profilerIpc);
+            Stop(testeeProcess);
+
+            TiaTestResult testResult = profilerUnderTest.Result;
+            IEnumerable<uint> calledTokens = testResult["A"][0].TraceLines.Where(line => line.StartsWith("Called="))
+                .Select(line => uint.Parse(line.Split(':')[1]));
+            TestCoverage testCoverage = profilerIpc.ReceivedTestCoverage.Single();
+            Assert.That(testCoverage.TestName, Is.EqualTo("A"));
+            Assert.That(testCoverage.MethodTokensByAssembly.Values.SelectMany(tokens => tokens), Is.EquivalentTo(calledTokens));
+        }
+
         [Test]
         public void NoIpcRunning()
         {
@@ -59,7 +59,7 @@ namespace UploadDaemon.Scanning
         /// </summary>
         public bool IsEmpty()
         {
-            return !Lines.Any(line => line.StartsWith("Jitted=") || line.StartsWith("Inlined=") || line.StartsWith("Called="));
+            return !Lines.Any(line => line.StartsWith("Jitted=") || line.StartsWith("Inlined=") || line.StartsWith("Called=") || line.StartsWith("Block="));
         }
     }
 }
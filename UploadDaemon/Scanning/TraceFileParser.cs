@@ -38,6 +38,14 @@ namespace UploadDaemon.Scanning
         private long TestDuration = 0;
         private string CurrentTestResult;
 
+        /// <summary>
+        /// The test that ran concurrently with others in a test context. The profiler writes such a test as one block
+        /// when it ended, which may be in the middle of the current test. Null outside of such a block.
+        /// </summary>
+        private Trace ContextTestTrace = null;
+        private string ContextTestName;
+        private DateTime ContextTestStart;
+
         public TraceFileParser(TraceFile traceFile, Dictionary<uint, (string name, string path)> assemblies, ILineCoverageSynthesizer lineCoverageSynthesizer, bool partial = false)
         {
             FilePath = traceFile.FilePath;
@@ -69,10 +77,14 @@ namespace UploadDaemon.Scanning
                     case "Test":
                         HandleTestEvent(value);
                         break;
+                    case "ContextTest":
+                        HandleContextTestEvent(value);
+                        break;
 
                     case "Inlined":
                     case "Jitted":
                     case "Called":
+                    case "Block":
                         HandleCoverageLine(value);
                         break;
                     case "Info":
@@ -150,9 +162,40 @@ namespace UploadDaemon.Scanning
             }
         }
 
+        private void HandleContextTestEvent(string testMessage)
+        {
+            if (testMessage.StartsWith("Start"))
+            {
+                Match testCaseMatch = TestCaseStartRegex.Match(testMessage);
+                ContextTestName = testCaseMatch.Groups["testname"].Value;
+                ContextTestStart = ParseProfilerDateTimeString(testCaseMatch.Groups["date"].Value);
+                ContextTestTrace = new Trace() { OriginTraceFilePath = FilePath };
+            }
+            else
+            {
+                Match testCaseMatch = TestCaseEndRegex.Match(testMessage);
+                if (ContextTestTrace == null)
+                {
+                    throw new InvalidTraceFileException($"encountered end of test that did not start: {testMessage}");
+                }
+                long.TryParse(testCaseMatch.Groups["duration"].Value, out long duration);
+                Tests.Add(new Test(ContextTestName, LineCoverageSynthesizer.ConvertToLineCoverage(ContextTestTrace))
+                {
+                    Start = ContextTestStart,
+                    End = ParseProfilerDateTimeString(testCaseMatch.Groups["date"].Value),
+                    DurationMillis = duration,
+                    Result = testCaseMatch.Groups["testresult"].Value
+                });
+                ContextTestTrace = null;
+            }
+        }
+
         private void HandleCoverageLine(string coverage)
         {
-            string[] coverageMatch = coverage.Split(new[] {':'}, count: 2);
+            // Called lines may carry a third field with the number of calls and Block lines always carry the IL offset
+            // of the executed block. We do not need either here: line coverage is synthesized per method, so an executed
+            // block only means that its method is covered
+            string[] coverageMatch = coverage.Split(':');
             uint assemblyId = Convert.ToUInt32(coverageMatch[0]);
             if (!Assemblies.TryGetValue(assemblyId, out (string, string) entry))
             {
@@ -160,7 +203,7 @@ namespace UploadDaemon.Scanning
                     " Please report it to CQSE. Coverage for this assembly will be ignored.", FilePath, assemblyId);
                 return;
             }
-            CurrentTestTrace.CoveredMethods.Add((entry.Item1, Convert.ToUInt32(coverageMatch[1])));
+            (ContextTestTrace ?? CurrentTestTrace).CoveredMethods.Add((entry.Item1, Convert.ToUInt32(coverageMatch[1])));
         }
 
         private DateTime ParseProfilerDateTimeString(string dateTimeString)
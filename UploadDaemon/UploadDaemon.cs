@@ -6,6 +6,8 @@ using System.IO.Abstractions;
 using System.IO.Pipes;
 using System.Linq;
 using System.Reflection;
+using System.Threading;
+using System.Threading.Tasks;
 using System.Timers;
 using UploadDaemon.Archiving;
 using UploadDaemon.Upload;
@@ -27,6 +29,21 @@ namespace UploadDaemon
 
         private const string DaemonControlCommandRunNow = "run";
 
+        /// <summary>
+        /// Separates the command from its argument, e.g. the path of the finished trace file sent by the profiler.
+        /// </summary>
+        private const char DaemonControlArgumentSeparator = '\t';
+
+        /// <summary>
+        /// Large enough for any command, so that profilers can send theirs without waiting for us to read it.
+        /// </summary>
+        private const int DaemonControlPipeBufferSize = 4096;
+
+        /// <summary>
+        /// 1 if a run has been requested via the control pipe that has not started yet, 0 otherwise.
+        /// </summary>
+        private int isRunRequested = 0;
+
         /// <summary>
         /// Lock used to ensure that no two uploads happen in parallel.
         /// </summary>
@@ -146,31 +163,73 @@ namespace UploadDaemon
         /// </summary>
         private void ScheduleRegularRuns(TimeSpan runInterval)
         {
-            Timer timer = new Timer();
+            System.Timers.Timer timer = new System.Timers.Timer();
             timer.Elapsed += (sender, args) => RunOnce();
             timer.Interval = runInterval.TotalMilliseconds;
             timer.Enabled = true;
         }
 
         /// <summary>
-        /// Waits for notifications from subsequent executions of the Daemon.
+        /// Waits for notifications from profilers whose trace file is complete and from subsequent executions of the Daemon.
+        /// Each connection is handled in the background, so the next client can connect right away.
         /// </summary>
         private void WaitForNotifications()
         {
             while (true) // wait for indefinitely many commands
             {
-                using (var pipeServerStream = new NamedPipeServerStream(DaemonControlPipeName, PipeDirection.In, 1, PipeTransmissionMode.Byte, PipeOptions.Asynchronous))
+                var pipeServerStream = new NamedPipeServerStream(DaemonControlPipeName, PipeDirection.In,
+                    NamedPipeServerStream.MaxAllowedServerInstances, PipeTransmissionMode.Byte, PipeOptions.Asynchronous,
+                    DaemonControlPipeBufferSize, DaemonControlPipeBufferSize);
+                pipeServerStream.WaitForConnection();
+                Task.Run(() => HandleNotification(pipeServerStream));
+            }
+        }
+
+        /// <summary>
+        /// Reads the command from the given connection and triggers an upload.
+        /// </summary>
+        private void HandleNotification(NamedPipeServerStream pipeServerStream)
+        {
+            try
+            {
+                using (var pipeStream = new StreamReader(pipeServerStream))
                 {
-                    pipeServerStream.WaitForConnection();
-                    using (var pipeStream = new StreamReader(pipeServerStream))
+                    // There is currently only one command (DaemonControlCommandRunNow), hence,
+                    // we trigger an upload without checking what we received.
+                    string command = pipeStream.ReadLine();
+                    if (command != null && command.IndexOf(DaemonControlArgumentSeparator) >= 0)
                     {
-                        // There is currently only one command (DaemonControlCommandUpload), hence,
-                        // we immediately trigger an upload without checking what we received.
-                        pipeStream.ReadLine();
-                        RunOnce();
+                        logger.Debug("Trace file {traceFile} is complete", command.Substring(command.IndexOf(DaemonControlArgumentSeparator) + 1));
                     }
                 }
             }
+            catch (IOException e)
+            {
+                logger.Debug(e, "Failed to read notification");
+            }
+            RequestRun();
+        }
+
+        /// <summary>
+        /// Runs the daemon tasks in the background. Processes that exit at the same time are handled by a single run,
+        /// as a run that has not started yet will pick up their trace files as well.
+        /// </summary>
+        private void RequestRun()
+        {
+            if (Interlocked.Exchange(ref isRunRequested, 1) == 1)
+            {
+                return;
+            }
+
+            Task.Run(() =>
+            {
+                // Requests that arrive while we wait for the current run to finish are handled by this run
+                lock (SequentialUploadsLock)
+                {
+                    Interlocked.Exchange(ref isRunRequested, 0);
+                    RunOnce();
+                }
+            });
         }
 
         /// <summary>
@@ -30,6 +30,17 @@ namespace UploadDaemon.Scanning
             Assert.That(traceFile.IsEmpty, Is.False);
         }
 
+        [Test]
+        public void DetectsFileWithOnlyBlocksAsNonEmpty()
+        {
+            TraceFile traceFile = new TraceFile("coverage_12345_1234.txt", new string[] {
+                "Assembly=ProfilerGUI:2 Version:1.0.0.0",
+                "Block=2:12345:0",
+            });
+
+            Assert.That(traceFile.IsEmpty, Is.False);
+        }
+
         [Test]
         public void SupportsNewStyleMethodReferences()
         {
@@ -71,6 +82,45 @@ namespace UploadDaemon.Scanning
             Assert.That(trace.CoveredMethods.Select(m => m.Item2), Is.EquivalentTo(new[] { 123, 456, 789 }));
         }
 
+        [Test]
+        public void SupportsCalledEventsWithCallCounts()
+        {
+            TraceFile traceFile = new TraceFile(":path:", new string[] {
+                "Assembly=ProfilerGUI:2 Version:1.0.0.0",
+                "Called=2:123:17",
+                "Called=2:456:1",
+            });
+
+            AssemblyExtractor extractor = new AssemblyExtractor();
+            extractor.ExtractAssemblies(traceFile.Lines);
+
+            TraceCollectingLineCoverageSynthesizer traceCollector = new TraceCollectingLineCoverageSynthesizer();
+            new TraceFileParser(traceFile, extractor.Assemblies, traceCollector).ParseTraceFile();
+            Trace trace = traceCollector.LastTrace;
+
+            Assert.That(trace.CoveredMethods.Select(m => m.Item2), Is.EquivalentTo(new[] { 123, 456 }));
+        }
+
+        [Test]
+        public void SupportsBlockEvents()
+        {
+            TraceFile traceFile = new TraceFile(":path:", new string[] {
+                "Assembly=ProfilerGUI:2 Version:1.0.0.0",
+                "Block=2:123:0",
+                "Block=2:123:17",
+                "Block=2:456:0",
+            });
+
+            AssemblyExtractor extractor = new AssemblyExtractor();
+            extractor.ExtractAssemblies(traceFile.Lines);
+
+            TraceCollectingLineCoverageSynthesizer traceCollector = new TraceCollectingLineCoverageSynthesizer();
+            new TraceFileParser(traceFile, extractor.Assemblies, traceCollector).ParseTraceFile();
+            Trace trace = traceCollector.LastTrace;
+
+            Assert.That(trace.CoveredMethods.Select(m => m.Item2).Distinct(), Is.EquivalentTo(new[] { 123, 456 }));
+        }
+
         [Test]
         public void IgnoresMethodReferenceFromUnknownAssembly()
         {
@@ -196,5 +246,37 @@ namespace UploadDaemon.Scanning
             Assert.That(trace.CoveredMethods, Contains.Item(("A", 456)));
             Assert.That(trace.CoveredMethods, Contains.Item(("A", 789)));
         }
+
+        [Test]
+        public void SupportsTestsFromTestContextsWithinOtherTests()
+        {
+            TraceFile traceFile = new TraceFile(":path:", new string[]
+            {
+                "Started=20200131_1109400000",
+                "Info=TIA enabled. SUB: tcp://127.0.0.1:7145 REQ: tcp://127.0.0.1:7146",
+                "Assembly=A:2 Version:1.0.0.0",
+                "Test=Start:20200131_1109420000:TestCase1",
+                "Called=2:123",
+                "ContextTest=Start:20200131_1109410000:TestCase2",
+                "Called=2:456",
+                "ContextTest=End:20200131_1109430000:FAILURE:2000",
+                "Called=2:789",
+                "Test=End:20200131_1109440000:PASSED",
+                "Stopped=20200131_1109460000"
+            });
+            AssemblyExtractor extractor = new AssemblyExtractor();
+            extractor.ExtractAssemblies(traceFile.Lines);
+
+            TraceCollectingLineCoverageSynthesizer traceCollector = new TraceCollectingLineCoverageSynthesizer();
+            ICoverageReport report = new TraceFileParser(traceFile, extractor.Assemblies, traceCollector).ParseTraceFile();
+            Trace trace = traceCollector.LastTrace;
+
+            TestwiseCoverageReport testwiseReport = (TestwiseCoverageReport)report;
+            Assert.That(testwiseReport.Tests.Select(test => test.UniformPath), Is.EqualTo(new[] { "TestCase2", "TestCase1" }));
+            Assert.That(testwiseReport.Tests[0].Result, Is.EqualTo("FAILURE"));
+            Assert.That(testwiseReport.Tests[0].Duration, Is.EqualTo(2));
+            Assert.That(testwiseReport.Tests[1].Result, Is.EqualTo("PASSED"));
+            Assert.That(trace.CoveredMethods, Is.EquivalentTo(new[] { ("A", 123u), ("A", 789u) }));
+        }
     }
 }